@@ -28,6 +28,7 @@
 #include "exception.h"
 #include "command.h"
 #include "gdb_packet.h"
+#include "gdb_main.h"
 #include "target.h"
 #include "target_internal.h"
 #include "morse.h"
@@ -35,6 +36,7 @@
 #include "serialno.h"
 #include "jtagtap.h"
 #include "jtag_scan.h"
+#include "adiv5.h"
 
 #ifdef ENABLE_RTT
 #include "rtt.h"
@@ -60,9 +62,13 @@ static bool cmd_frequency(target_s *t, int argc, const char **argv);
 static bool cmd_targets(target_s *t, int argc, const char **argv);
 static bool cmd_morse(target_s *t, int argc, const char **argv);
 static bool cmd_halt_timeout(target_s *t, int argc, const char **argv);
+static bool cmd_poll_stats(target_s *t, int argc, const char **argv);
+static bool cmd_transfer_policy(target_s *t, int argc, const char **argv);
 static bool cmd_connect_reset(target_s *t, int argc, const char **argv);
 static bool cmd_reset(target_s *t, int argc, const char **argv);
 static bool cmd_tdi_low_reset(target_s *t, int argc, const char **argv);
+static bool cmd_flash_diff(target_s *t, int argc, const char **argv);
+static bool cmd_mem_cache(target_s *t, int argc, const char **argv);
 #ifdef PLATFORM_HAS_POWER_SWITCH
 static bool cmd_target_power(target_s *t, int argc, const char **argv);
 #endif
@@ -90,10 +96,16 @@ const command_s cmd_list[] = {
 	{"targets", cmd_targets, "Display list of available targets"},
 	{"morse", cmd_morse, "Display morse error message"},
 	{"halt_timeout", cmd_halt_timeout, "Timeout (ms) to wait until Cortex-M is halted: (Default 2000)"},
+	{"poll_stats", cmd_poll_stats,
+		"Halt polling statistics, or set the longest interval (ms) between polls: (reset|max interval)"},
+	{"transfer_policy", cmd_transfer_policy,
+		"DP transfer policy for the next scan: (idle cycles after write|default) (WAIT retries, 0 for default)"},
 	{"connect_rst", cmd_connect_reset, "Configure connect under reset: (enable|disable)"},
 	{"reset", cmd_reset, "Pulse the nRST line - disconnects target"},
 	{"tdi_low_reset", cmd_tdi_low_reset,
 		"Pulse nRST with TDI set low to attempt to wake certain targets up (eg LPC82x)"},
+	{"flash_diff", cmd_flash_diff, "Only erase and write Flash blocks whose contents change: (enable|disable)"},
+	{"mem_cache", cmd_mem_cache, "Cache GDB's RAM and Flash reads until the target next runs: (enable|disable)"},
 #ifdef PLATFORM_HAS_POWER_SWITCH
 	{"tpwr", cmd_target_power, "Supplies power to the target: (enable|disable)"},
 #endif
@@ -142,6 +154,9 @@ int command_process(target_s *t, char *cmd)
 	for (const char *part = strtok(cmd, " \t"); part; part = strtok(NULL, " \t"))
 		argv[argc++] = part;
 
+	/* Monitor commands can do anything to the target, so don't trust anything read before */
+	target_mem_cache_invalidate(t);
+
 	/* Look for match and call handler */
 	for (const command_s *cmd = cmd_list; cmd->cmd; ++cmd) {
 		/* Accept a partial match as GDB does.
@@ -442,6 +457,45 @@ static bool cmd_connect_reset(target_s *t, int argc, const char **argv)
 	return true;
 }
 
+static bool cmd_flash_diff(target_s *t, int argc, const char **argv)
+{
+	bool print_status = false;
+	if (argc == 1)
+		print_status = true;
+	else if (argc == 2) {
+		if (parse_enable_or_disable(argv[1], &target_flash_diff))
+			print_status = true;
+	} else
+		gdb_out("Unrecognized command format\n");
+
+	if (print_status) {
+		gdb_outf("Flash diffing: %s\n", target_flash_diff ? "enabled" : "disabled");
+		if (t)
+			gdb_outf("Last Flash operation: %zu blocks skipped, %zu blocks written\n", t->flash_blocks_skipped,
+				t->flash_blocks_written);
+	}
+	return true;
+}
+
+static bool cmd_mem_cache(target_s *t, int argc, const char **argv)
+{
+	bool print_status = false;
+	if (argc == 1)
+		print_status = true;
+	else if (argc == 2) {
+		if (parse_enable_or_disable(argv[1], &target_mem_cache))
+			print_status = true;
+	} else
+		gdb_out("Unrecognized command format\n");
+
+	if (print_status) {
+		gdb_outf("Memory read cache: %s\n", target_mem_cache ? "enabled" : "disabled");
+		if (t)
+			gdb_outf("%zu hits, %zu misses\n", t->mem_cache_hits, t->mem_cache_misses);
+	}
+	return true;
+}
+
 static bool cmd_halt_timeout(target_s *t, int argc, const char **argv)
 {
 	(void)t;
@@ -451,6 +505,62 @@ static bool cmd_halt_timeout(target_s *t, int argc, const char **argv)
 	return true;
 }
 
+static bool cmd_poll_stats(target_s *t, int argc, const char **argv)
+{
+	(void)t;
+	gdb_poll_stats_s *const stats = &gdb_poll_stats;
+	if (argc > 1) {
+		if (!strcmp(argv[1], "reset"))
+			memset(stats, 0, sizeof(*stats));
+		else
+			gdb_poll_max_interval_ms = strtoul(argv[1], NULL, 0);
+	}
+
+	gdb_outf("Longest interval between halt polls: %" PRIu32 "ms\n", gdb_poll_max_interval_ms);
+	gdb_outf("%" PRIu32 " polls, %" PRIu32 " halts detected\n", stats->polls, stats->halts);
+	if (stats->halts)
+		gdb_outf("Halt detection latency: %" PRIu32 "ms average, %" PRIu32 "ms worst\n",
+			stats->latency_total_ms / stats->halts, stats->latency_max_ms);
+#if PC_HOSTED == 1
+	if (stats->running_ms)
+		gdb_outf("CPU use while the target ran: %" PRIu32 "%% of %" PRIu32 "ms\n",
+			(uint32_t)(((uint64_t)stats->cpu_ms * 100U) / stats->running_ms), stats->running_ms);
+#else
+	gdb_outf("Time the target ran for: %" PRIu32 "ms\n", stats->running_ms);
+#endif
+	return true;
+}
+
+static bool cmd_transfer_policy(target_s *t, int argc, const char **argv)
+{
+	(void)t;
+	adiv5_transfer_policy_s *const policy = &adiv5_transfer_policy;
+	if (argc > 1) {
+		if (!strcmp(argv[1], "default"))
+			policy->idle_cycles = ADIV5_IDLE_CYCLES_DEFAULT;
+		else {
+			const uint32_t idle_cycles = strtoul(argv[1], NULL, 0);
+			if (idle_cycles > ADIV5_IDLE_CYCLES_MAX) {
+				gdb_outf("Idle cycles must be between 0 and %u\n", ADIV5_IDLE_CYCLES_MAX);
+				return false;
+			}
+			policy->idle_cycles = idle_cycles;
+		}
+	}
+	if (argc > 2)
+		policy->wait_retries = MIN(strtoul(argv[2], NULL, 0), UINT16_MAX);
+
+	if (policy->idle_cycles == ADIV5_IDLE_CYCLES_DEFAULT)
+		gdb_out("Idle cycles after write: default\n");
+	else
+		gdb_outf("Idle cycles after write: %u\n", policy->idle_cycles);
+	if (policy->wait_retries)
+		gdb_outf("WAIT retries: %u\n", policy->wait_retries);
+	else
+		gdb_out("WAIT retries: default\n");
+	return true;
+}
+
 static bool cmd_reset(target_s *t, int argc, const char **argv)
 {
 	(void)t;
@@ -510,6 +620,7 @@ static bool cmd_rtt(target_s *t, int argc, const char **argv)
 		rtt_enabled = true;
 		rtt_found = false;
 		memset(rtt_channel, 0, sizeof(rtt_channel));
+		rtt_down_bytes = 0;
 	} else if (argc == 2 && strncmp(argv[1], "disabled", command_len) == 0) {
 		rtt_enabled = false;
 		rtt_found = false;
@@ -531,6 +642,7 @@ static bool cmd_rtt(target_s *t, int argc, const char **argv)
 			gdb_outf("ram: 0x%08" PRIx32 " 0x%08" PRIx32, rtt_ram_start, rtt_ram_end);
 		gdb_outf(
 			"\nmax poll ms: %u min poll ms: %u max errs: %u\n", rtt_max_poll_ms, rtt_min_poll_ms, rtt_max_poll_errs);
+		gdb_outf("down: %" PRIu32 " bytes %" PRIu32 " bytes/s\n", rtt_down_bytes, rtt_down_rate());
 	} else if (argc >= 2 && strncmp(argv[1], "channel", command_len) == 0) {
 		/* mon rtt channel switches to auto rtt channel selection
 		   mon rtt channel number... selects channels given */
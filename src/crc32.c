@@ -20,6 +20,8 @@
 
 #include "general.h"
 #include "target.h"
+#include "target_internal.h"
+#include "crc32.h"
 #include "gdb_if.h"
 
 #if !defined(STM32F0) && !defined(STM32F1) && !defined(STM32F2) && !defined(STM32F3) && !defined(STM32F4) && \
@@ -100,7 +102,17 @@ static uint32_t crc32_calc(const uint32_t crc, const uint8_t data)
 	return (crc << 8U) ^ crc32_table[((crc >> 24U) ^ data) & 0xffU];
 }
 
-bool generic_crc32(target_s *const t, uint32_t *const crc_res, uint32_t base, size_t len)
+#if PC_HOSTED == 1
+uint32_t crc32_buffer(uint32_t crc, const void *const data, const size_t len)
+{
+	const uint8_t *const bytes = (const uint8_t *)data;
+	for (size_t i = 0; i < len; ++i)
+		crc = crc32_calc(crc, bytes[i]);
+	return crc;
+}
+#endif
+
+static bool probe_crc32(target_s *const t, uint32_t *const crc_res, uint32_t base, size_t len)
 {
 	uint32_t crc = 0xffffffffU;
 #if PC_HOSTED == 1
@@ -142,7 +154,7 @@ bool generic_crc32(target_s *const t, uint32_t *const crc_res, uint32_t base, si
 #else
 #include <libopencm3/stm32/crc.h>
 
-bool generic_crc32(target_s *const t, uint32_t *const crc_res, uint32_t base, size_t len)
+static bool probe_crc32(target_s *const t, uint32_t *const crc_res, uint32_t base, size_t len)
 {
 	uint8_t bytes[128];
 
@@ -188,3 +200,11 @@ bool generic_crc32(target_s *const t, uint32_t *const crc_res, uint32_t base, si
 	return true;
 }
 #endif
+
+bool generic_crc32(target_s *const t, uint32_t *const crc_res, const uint32_t base, const size_t len)
+{
+	/* If the target can calculate the CRC itself, only the result has to be sent back over the wire */
+	if (t->crc32 && t->crc32(t, crc_res, base, len))
+		return true;
+	return probe_crc32(t, crc_res, base, len);
+}
@@ -46,6 +46,9 @@
 #include <alloca.h>
 #endif
 #include <stdlib.h>
+#if PC_HOSTED == 1
+#include <time.h>
+#endif
 
 typedef enum gdb_signal {
 	GDB_SIGINT = 2,
@@ -54,7 +57,7 @@ typedef enum gdb_signal {
 	GDB_SIGLOST = 29,
 } gdb_signal_e;
 
-#define GDB_MAX_PACKET_SIZE 1024U
+#define GDB_MAX_PACKET_SIZE GDB_PACKET_BUFFER_SIZE
 
 #define ERROR_IF_NO_TARGET()   \
 	if (!cur_target) {         \
@@ -72,6 +75,17 @@ target_s *last_target;
 bool gdb_target_running = false;
 static bool gdb_needs_detach_notify = false;
 
+uint32_t gdb_poll_max_interval_ms = GDB_POLL_MAX_INTERVAL_MS;
+gdb_poll_stats_s gdb_poll_stats;
+/* Current distance between halt polls, when the next is due, and when the target was last seen running */
+static uint32_t gdb_poll_interval_ms;
+static uint32_t gdb_poll_next_ms;
+static uint32_t gdb_poll_last_ms;
+static uint32_t gdb_poll_start_ms;
+#if PC_HOSTED == 1
+static clock_t gdb_poll_start_cpu;
+#endif
+
 static void handle_q_packet(char *packet, size_t len);
 static void handle_v_packet(char *packet, size_t len);
 static void handle_z_packet(char *packet, size_t len);
@@ -146,12 +160,31 @@ int gdb_main_loop(target_controller_s *tc, char *pbuf, size_t pbuf_size, size_t
 		}
 		DEBUG_GDB("m packet: addr = %" PRIx32 ", len = %" PRIx32 "\n", addr, len);
 		uint8_t mem[len];
-		if (target_mem_read(cur_target, mem, addr, len))
+		if (target_mem_read_cached(cur_target, mem, addr, len))
 			gdb_putpacketz("E01");
 		else
 			gdb_putpacket(hexify(pbuf, mem, len), len * 2U);
 		break;
 	}
+	case 'x': { /* 'x addr,len': Read len bytes from addr, replying in binary */
+		uint32_t addr, len;
+		ERROR_IF_NO_TARGET();
+		sscanf(pbuf, "x%" SCNx32 ",%" SCNx32, &addr, &len);
+		/*
+		 * The request has been fully parsed, so read straight into the packet buffer.
+		 * gdb_putpacket2() takes care of escaping the data as it goes out.
+		 */
+		if (len > pbuf_size) {
+			gdb_putpacketz("E02");
+			break;
+		}
+		DEBUG_GDB("x packet: addr = %" PRIx32 ", len = %" PRIx32 "\n", addr, len);
+		if (target_mem_read_cached(cur_target, pbuf, addr, len))
+			gdb_putpacketz("E01");
+		else
+			gdb_putpacket2("b", 1U, pbuf, len);
+		break;
+	}
 	case 'G': { /* 'G XX': Write general registers */
 		ERROR_IF_NO_TARGET();
 		const size_t reg_size = target_regs_size(cur_target);
@@ -226,6 +259,7 @@ int gdb_main_loop(target_controller_s *tc, char *pbuf, size_t pbuf_size, size_t
 		 * is not NULL and `gdb_target_running` is true.
 		 */
 		gdb_target_running = true;
+		gdb_poll_restart();
 		break;
 	}
 
@@ -418,7 +452,8 @@ static void exec_q_supported(const char *packet, const size_t length)
 {
 	(void)packet;
 	(void)length;
-	gdb_putpacket_f("PacketSize=%X;qXfer:memory-map:read+;qXfer:features:read+", GDB_MAX_PACKET_SIZE);
+	gdb_putpacket_f(
+		"PacketSize=%X;qXfer:memory-map:read+;qXfer:features:read+;binary-upload+", GDB_MAX_PACKET_SIZE);
 }
 
 static void exec_q_memory_map(const char *packet, const size_t length)
@@ -700,8 +735,40 @@ void gdb_halt_target(void)
 		gdb_putpacketz("W00");
 }
 
-/* poll running target */
-void gdb_poll_target(void)
+/* Poll for a halt straight away, and quickly for a while after - for when the target's just been resumed or halted */
+void gdb_poll_restart(void)
+{
+	gdb_poll_interval_ms = 0U;
+	gdb_poll_next_ms = platform_time_ms();
+	gdb_poll_last_ms = gdb_poll_next_ms;
+	gdb_poll_start_ms = gdb_poll_next_ms;
+#if PC_HOSTED == 1
+	gdb_poll_start_cpu = clock();
+#endif
+}
+
+/* How long until the next halt poll is due, which is how long the caller can wait for GDB */
+uint32_t gdb_poll_wait_ms(void)
+{
+	const int32_t remaining = (int32_t)(gdb_poll_next_ms - platform_time_ms());
+	return remaining > 0 ? (uint32_t)remaining : 0U;
+}
+
+static void gdb_poll_account_halt(const uint32_t now)
+{
+	const uint32_t latency = now - gdb_poll_last_ms;
+	++gdb_poll_stats.halts;
+	gdb_poll_stats.latency_total_ms += latency;
+	if (latency > gdb_poll_stats.latency_max_ms)
+		gdb_poll_stats.latency_max_ms = latency;
+	gdb_poll_stats.running_ms += now - gdb_poll_start_ms;
+#if PC_HOSTED == 1
+	gdb_poll_stats.cpu_ms += (uint32_t)(((uint64_t)(clock() - gdb_poll_start_cpu) * 1000U) / CLOCKS_PER_SEC);
+#endif
+}
+
+/* Poll the running target if a poll is due (or forced), backing off the next poll if it's still running */
+void gdb_poll_target(const bool force)
 {
 	if (!cur_target) {
 		/* Report "target exited" if no target */
@@ -709,15 +776,26 @@ void gdb_poll_target(void)
 		return;
 	}
 
+	const uint32_t now = platform_time_ms();
+	if (!force && (int32_t)(gdb_poll_next_ms - now) > 0)
+		return;
+
 	/* poll target */
+	++gdb_poll_stats.polls;
 	target_addr_t watch;
 	target_halt_reason_e reason = target_halt_poll(cur_target, &watch);
-	if (!reason)
+	if (!reason) {
+		/* Still running, so wait twice as long as last time before polling again */
+		gdb_poll_interval_ms = MIN(MAX(gdb_poll_interval_ms * 2U, 1U), gdb_poll_max_interval_ms);
+		gdb_poll_next_ms = now + gdb_poll_interval_ms;
+		gdb_poll_last_ms = now;
 		return;
+	}
 
 	/* switch polling off */
 	gdb_target_running = false;
 	SET_RUN_STATE(0);
+	gdb_poll_account_halt(now);
 
 	/* Translate reason to GDB signal */
 	switch (reason) {
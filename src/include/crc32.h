@@ -21,6 +21,10 @@
 #ifndef INCLUDE_CRC32_H
 #define INCLUDE_CRC32_H
 
-bool generic_crc32(target_s *t, uint32_t *crc, uint32_t base, int len);
+bool generic_crc32(target_s *t, uint32_t *crc, uint32_t base, size_t len);
+#if PC_HOSTED == 1
+/* Continue a CRC32 calculation over a buffer in host memory, as generic_crc32() does for the target */
+uint32_t crc32_buffer(uint32_t crc, const void *data, size_t len);
+#endif
 
 #endif /* INCLUDE_CRC32_H */
@@ -23,12 +23,46 @@
 
 #include "target.h"
 
+/*
+ * BMDA has memory to spare, so negotiate much larger packets there to cut
+ * down on the number of round trips large memory reads and writes take
+ */
+#if PC_HOSTED == 1
+#define GDB_PACKET_BUFFER_SIZE 0x4000U
+#else
 #define GDB_PACKET_BUFFER_SIZE 1024U
+#endif
 
 extern bool gdb_target_running;
 extern target_s *cur_target;
 
-void gdb_poll_target(void);
+/*
+ * While the target runs it's polled for halts straight away, then exponentially less often up to
+ * this many milliseconds apart. 0 polls continuously.
+ */
+#if PC_HOSTED == 1
+#define GDB_POLL_MAX_INTERVAL_MS 32U
+#else
+#define GDB_POLL_MAX_INTERVAL_MS 8U
+#endif
+
+typedef struct gdb_poll_stats {
+	uint32_t polls;
+	uint32_t halts;
+	/* How long each halt could have gone unnoticed for - the time since the poll before the one that saw it */
+	uint32_t latency_total_ms;
+	uint32_t latency_max_ms;
+	/* Time spent with the target running, and on BMDA, the host CPU time used meanwhile */
+	uint32_t running_ms;
+	uint32_t cpu_ms;
+} gdb_poll_stats_s;
+
+extern uint32_t gdb_poll_max_interval_ms;
+extern gdb_poll_stats_s gdb_poll_stats;
+
+void gdb_poll_restart(void);
+uint32_t gdb_poll_wait_ms(void);
+void gdb_poll_target(bool force);
 void gdb_main(char *pbuf, size_t pbuf_size, size_t size);
 int gdb_main_loop(target_controller_s *tc, char *pbuf, size_t pbuf_size, size_t size, bool in_syscall);
 char *gdb_packet_buffer();
@@ -73,6 +73,9 @@ extern jtag_proc_s jtag_proc;
 /* Goto Run-test/Idle: 1, 1, 0 */
 #define jtagtap_return_idle(cycles) jtag_proc.jtagtap_tms_seq(0x01, (cycles) + 1U)
 
+/* Goto Update-DR/IR from Exit1-DR/IR: 1 */
+#define jtagtap_return_update() jtag_proc.jtagtap_tms_seq(0x01U, 1U)
+
 #if PC_HOSTED == 1
 bool platform_jtagtap_init(void);
 #else
@@ -28,13 +28,8 @@
 
 #if PC_HOSTED == 1
 void platform_init(int argc, char **argv);
-void platform_pace_poll(void);
 #else
 void platform_init(void);
-
-inline void platform_pace_poll(void)
-{
-}
 #endif
 
 typedef struct platform_timeout platform_timeout_s;
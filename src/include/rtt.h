@@ -47,6 +47,7 @@ extern bool rtt_auto_channel;                  // manual or auto channel selecti
 extern bool rtt_flag_skip;                     // skip if host-to-target fifo full
 extern bool rtt_flag_block;                    // block if host-to-target fifo full
 extern bool rtt_channel_enabled[MAX_RTT_CHAN]; // true if user wants to see channel
+extern uint32_t rtt_down_bytes;                // number of bytes sent from host to target
 
 typedef struct rtt_channel {
 	uint32_t name_addr;
@@ -60,5 +61,7 @@ typedef struct rtt_channel {
 extern rtt_channel_s rtt_channel[MAX_RTT_CHAN];
 
 void poll_rtt(target_s *cur_target);
+uint32_t rtt_poll_wait_ms(void);
+uint32_t rtt_down_rate(void);
 
 #endif /* INCLUDE_RTT_H */
@@ -35,6 +35,12 @@ typedef struct swd_proc {
 	void (*seq_out)(uint32_t tms_states, size_t clock_cycles);
 	/* Perform a clock_cycles write + parity with the provided data */
 	void (*seq_out_parity)(uint32_t tms_states, size_t clock_cycles);
+	/*
+	 * Perform a whole transfer in one go: the request, its ACK and, only if the ACK is OK, the data phase
+	 * with parity, plus idle_cycles idle cycles after a write. Returns the ACK. For reads, the data read is
+	 * stored in *data and *parity_error set accordingly. May be NULL, in which case the sequences above are used.
+	 */
+	uint8_t (*transfer)(uint8_t request, uint32_t *data, bool *parity_error, uint8_t idle_cycles);
 } swd_proc_s;
 
 extern swd_proc_s swd_proc;
@@ -58,11 +58,17 @@ unsigned int target_part_id(target_s *t);
 bool target_mem_map(target_s *t, char *buf, size_t len);
 int target_mem_read(target_s *t, void *dest, target_addr_t src, size_t len);
 int target_mem_write(target_s *t, target_addr_t dest, const void *src, size_t len);
+int target_mem_read_cached(target_s *t, void *dest, target_addr_t src, size_t len);
+void target_mem_cache_invalidate(target_s *t);
 bool target_mem_access_needs_halt(target_s *t);
+/* When set, reads from the debugger are cached in blocks until the target next runs or is written to */
+extern bool target_mem_cache;
 /* Flash memory access functions */
 bool target_flash_erase(target_s *t, target_addr_t addr, size_t len);
 bool target_flash_write(target_s *t, target_addr_t dest, const void *src, size_t len);
 bool target_flash_complete(target_s *t);
+/* When set, erases are deferred and only erase blocks whose contents differ get erased and written */
+extern bool target_flash_diff;
 
 /* Register access functions */
 size_t target_regs_size(target_s *t);
@@ -0,0 +1 @@
+#define FIRMWARE_VERSION "4636987"
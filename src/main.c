@@ -44,23 +44,40 @@ static void bmp_poll_loop(void)
 {
 	SET_IDLE_STATE(false);
 	while (gdb_target_running && cur_target) {
-		gdb_poll_target();
+#ifdef ENABLE_RTT
+		/* When RTT is due a poll, check for a halt too so the two share one wake-up of the link */
+		const bool rtt_due = rtt_enabled && !rtt_poll_wait_ms();
+#else
+		const bool rtt_due = false;
+#endif
+		gdb_poll_target(rtt_due);
 
 		// Check again, as `gdb_poll_target()` may
 		// alter these variables.
 		if (!gdb_target_running || !cur_target)
 			break;
-		char c = gdb_if_getchar_to(0);
-		if (c == '\x03' || c == '\x04')
-			target_halt_request(cur_target);
-		platform_pace_poll();
 #ifdef ENABLE_RTT
-		if (rtt_enabled)
+		if (rtt_due)
 			poll_rtt(cur_target);
 #endif
+		/* Wait on GDB until something's next due, so a ^C is still acted on straight away */
+		uint32_t wait_ms = gdb_poll_wait_ms();
+#ifdef ENABLE_RTT
+		if (rtt_enabled)
+			wait_ms = MIN(wait_ms, rtt_poll_wait_ms());
+#endif
+		char c = gdb_if_getchar_to(wait_ms);
+		if (c == '\x03' || c == '\x04') {
+			target_halt_request(cur_target);
+			gdb_poll_restart();
+		}
 	}
 
 	SET_IDLE_STATE(true);
+#if PC_HOSTED == 1
+	/* Make sure nothing is left buffered up for the target while we wait on GDB */
+	platform_buffer_flush();
+#endif
 	size_t size = gdb_getpacket(pbuf, GDB_PACKET_BUFFER_SIZE);
 	// If port closed and target detached, stay idle
 	if (pbuf[0] != '\x04' || cur_target)
@@ -131,6 +131,18 @@
 #define TRACE_IRQ          NVIC_TIM3_IRQ
 #define TRACE_ISR(x)       tim3_isr(x)
 
+/*
+ * Timer and DMA resources for the timer + DMA driven SWD implementation (build with SWD_DMA=1).
+ * TIM1's compare channels 1 and 2 request DMA2 streams 1 and 2 respectively on channel 6.
+ */
+#define SWD_DMA_TIM          TIM1
+#define SWD_DMA_TIM_CLK_EN() rcc_periph_clock_enable(RCC_TIM1)
+#define SWD_DMA_BUS          DMA2
+#define SWD_DMA_CLK          RCC_DMA2
+#define SWD_DMA_OUT_STREAM   DMA_STREAM1
+#define SWD_DMA_IN_STREAM    DMA_STREAM2
+#define SWD_DMA_TRG          DMA_SxCR_CHSEL_6
+
 #define SET_RUN_STATE(state)      \
 	{                             \
 		running_status = (state); \
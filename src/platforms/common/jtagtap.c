@@ -26,6 +26,9 @@
 
 #include "general.h"
 #include "jtagtap.h"
+#ifdef PLATFORM_HAS_SWD_DMA
+#include "swdptap_dma.h"
+#endif
 
 jtag_proc_s jtag_proc;
 
@@ -33,6 +36,10 @@ static void jtagtap_reset(void);
 static void jtagtap_tms_seq(uint32_t tms_states, size_t ticks);
 static void jtagtap_tdi_tdo_seq(uint8_t *data_out, bool final_tms, const uint8_t *data_in, size_t clock_cycles);
 static void jtagtap_tdi_seq(bool final_tms, const uint8_t *data_in, size_t clock_cycles);
+static void jtagtap_tdi_tdo_seq_no_delay(const uint8_t *data_in, uint8_t *data_out, bool final_tms, size_t clock_cycles)
+	__attribute__((optimize(3)));
+static void jtagtap_tdi_seq_no_delay(const uint8_t *data_in, bool final_tms, size_t clock_cycles)
+	__attribute__((optimize(3)));
 static bool jtagtap_next(bool tms, bool tdi);
 static void jtagtap_cycle(bool tms, bool tdi, size_t clock_cycles);
 
@@ -40,6 +47,10 @@ void jtagtap_init(void)
 {
 	platform_target_clk_output_enable(true);
 	TMS_SET_MODE();
+#ifdef PLATFORM_HAS_SWD_DMA
+	/* The timer and DMA only drive SWD, JTAG is bit-banged and clocked by swd_delay_cnt */
+	swdptap_dma_deinit();
+#endif
 
 	jtag_proc.jtagtap_reset = jtagtap_reset;
 	jtag_proc.jtagtap_next = jtagtap_next;
@@ -138,80 +149,105 @@ static void jtagtap_tms_seq(const uint32_t tms_states, const size_t ticks)
 		jtagtap_tms_seq_no_delay(tms_states, ticks);
 }
 
+/*
+ * The TDI/TDO sequences below work a word at a time: up to 32 bits of data_in are loaded and shifted out
+ * LSB first, and TDO is accumulated and only stored once the word's done. TMS is held low for all but the
+ * final cycle of a sequence, which is split off and done on its own with final_tms.
+ *
+ * The body cycles never drive TMS, so the *_swd_delay() and *_no_delay() sequence functions require TMS
+ * to already be low on entry. jtagtap_tdi_tdo_seq() and jtagtap_tdi_seq() clear it before calling them.
+ */
+static inline uint32_t jtagtap_word_load(const uint8_t *const data, const size_t clock_cycles)
+{
+	uint32_t word = 0;
+	for (size_t byte = 0; byte < (clock_cycles + 7U) >> 3U; ++byte)
+		word |= (uint32_t)data[byte] << (byte * 8U);
+	return word;
+}
+
+static inline void jtagtap_word_store(uint8_t *const data, const uint32_t word, const size_t clock_cycles)
+{
+	for (size_t byte = 0; byte < (clock_cycles + 7U) >> 3U; ++byte)
+		data[byte] = (uint8_t)(word >> (byte * 8U));
+}
+
+static inline bool jtagtap_tdi_tdo_cycle_swd_delay(const bool tdi)
+{
+	/* Set up the TDI pin and start the clock cycle */
+	gpio_set_val(TDI_PORT, TDI_PIN, tdi);
+	gpio_set(TCK_PORT, TCK_PIN);
+	for (volatile int32_t cnt = swd_delay_cnt - 2U; cnt > 0; cnt--)
+		continue;
+	const bool tdo = gpio_get(TDO_PORT, TDO_PIN);
+	/* Finish the clock cycle */
+	gpio_clear(TCK_PORT, TCK_PIN);
+	for (volatile int32_t cnt = swd_delay_cnt - 2U; cnt > 0; cnt--)
+		continue;
+	return tdo;
+}
+
 static void jtagtap_tdi_tdo_seq_swd_delay(
 	const uint8_t *const data_in, uint8_t *const data_out, const bool final_tms, const size_t clock_cycles)
 {
-	uint8_t value = 0;
-	for (size_t cycle = 0; cycle < clock_cycles; ++cycle) {
-		const size_t bit = cycle & 7U;
-		const size_t byte = cycle >> 3U;
+	for (size_t cycle = 0; cycle < clock_cycles; cycle += 32U) {
+		const size_t word_cycles = MIN(clock_cycles - cycle, 32U);
+		const bool final_word = cycle + word_cycles == clock_cycles;
+		const size_t body_cycles = final_word ? word_cycles - 1U : word_cycles;
+		const uint32_t data = jtagtap_word_load(data_in + (cycle >> 3U), word_cycles);
+		uint32_t value = 0;
+		size_t bit = 0;
+		for (; bit < body_cycles; ++bit)
+			value |= (uint32_t)jtagtap_tdi_tdo_cycle_swd_delay((data >> bit) & 1U) << bit;
 		/* On the last cycle, assert final_tms to TMS_PIN */
-		gpio_set_val(TMS_PORT, TMS_PIN, cycle + 1U >= clock_cycles && final_tms);
-		/* Set up the TDI pin and start the clock cycle */
-		gpio_set_val(TDI_PORT, TDI_PIN, data_in[byte] & (1U << bit));
-		gpio_set(TCK_PORT, TCK_PIN);
-		for (volatile int32_t cnt = swd_delay_cnt - 2U; cnt > 0; cnt--)
-			continue;
-		/* If TDO is high, store a 1 in the appropriate position in the value being accumulated */
-		if (gpio_get(TDO_PORT, TDO_PIN))
-			value |= 1U << bit;
-		if (bit == 7U) {
-			data_out[byte] = value;
-			value = 0;
+		if (final_word) {
+			gpio_set_val(TMS_PORT, TMS_PIN, final_tms);
+			value |= (uint32_t)jtagtap_tdi_tdo_cycle_swd_delay((data >> bit) & 1U) << bit;
 		}
-		/* Finish the clock cycle */
-		gpio_clear(TCK_PORT, TCK_PIN);
-		for (volatile int32_t cnt = swd_delay_cnt - 2U; cnt > 0; cnt--)
-			continue;
+		if (data_out)
+			jtagtap_word_store(data_out + (cycle >> 3U), value, word_cycles);
 	}
-	const size_t bit = (clock_cycles - 1U) & 7U;
-	const size_t byte = (clock_cycles - 1U) >> 3U;
-	if (bit)
-		data_out[byte] = value;
+}
+
+static inline bool jtagtap_tdi_tdo_cycle_no_delay(const bool tdi)
+{
+	gpio_clear(TCK_PORT, TCK_PIN);
+	/* Block the compiler from re-ordering the calculations to preserve timings */
+	__asm__ volatile("" ::: "memory");
+	/* Configure the bus for the next cycle */
+	gpio_set_val(TDI_PORT, TDI_PIN, tdi);
+	__asm__("nop");
+	__asm__("nop");
+	/* Block the compiler from re-ordering the calculations to preserve timings */
+	__asm__ volatile("nop" ::: "memory");
+	/* Start the clock cycle */
+	gpio_set(TCK_PORT, TCK_PIN);
+	return gpio_get(TDO_PORT, TDO_PIN);
 }
 
 static void jtagtap_tdi_tdo_seq_no_delay(
 	const uint8_t *const data_in, uint8_t *const data_out, const bool final_tms, const size_t clock_cycles)
 {
-	uint8_t value = 0;
-	for (size_t cycle = 0; cycle < clock_cycles;) {
-		/* Calculate the next bit and byte to consume data from */
-		const uint8_t bit = cycle & 7U;
-		const size_t byte = cycle >> 3U;
-		const bool tms = cycle + 1U >= clock_cycles && final_tms;
-		const bool tdi = data_in[byte] & (1U << bit);
-		/* Block the compiler from re-ordering the calculations to preserve timings */
-		__asm__ volatile("" ::: "memory");
-		gpio_clear(TCK_PORT, TCK_PIN);
-		/* Block the compiler from re-ordering the calculations to preserve timings */
-		__asm__ volatile("" ::: "memory");
-		/* Configure the bus for the next cycle */
-		gpio_set_val(TDI_PORT, TDI_PIN, tdi);
-		gpio_set_val(TMS_PORT, TMS_PIN, tms);
-		/* Block the compiler from re-ordering the calculations to preserve timings */
-		__asm__ volatile("" ::: "memory");
-		/* Increment the cycle counter */
-		++cycle;
-		__asm__("nop");
-		__asm__("nop");
-		/* Block the compiler from re-ordering the calculations to preserve timings */
-		__asm__ volatile("nop" ::: "memory");
-		/* Start the clock cycle */
-		gpio_set(TCK_PORT, TCK_PIN);
-		/* If TDO is high, store a 1 in the appropriate position in the value being accumulated */
-		if (gpio_get(TDO_PORT, TDO_PIN)) /* XXX: Try to remove the need for the if here */
-			value |= 1U << bit;
-		/* If we've got the next whole byte, store the accumulated value and reset state */
-		if (bit == 7U) {
-			data_out[byte] = value;
-			value = 0;
+	for (size_t cycle = 0; cycle < clock_cycles; cycle += 32U) {
+		const size_t word_cycles = MIN(clock_cycles - cycle, 32U);
+		const bool final_word = cycle + word_cycles == clock_cycles;
+		const size_t body_cycles = final_word ? word_cycles - 1U : word_cycles;
+		const uint32_t data = jtagtap_word_load(data_in + (cycle >> 3U), word_cycles);
+		uint32_t value = 0;
+		size_t bit = 0;
+		/* Go a byte at a time while we can, the fixed trip count of the inner loop lets it be unrolled */
+		for (; bit + 8U <= body_cycles; bit += 8U) {
+			for (size_t offset = 0; offset < 8U; ++offset)
+				value |= (uint32_t)jtagtap_tdi_tdo_cycle_no_delay((data >> (bit + offset)) & 1U) << (bit + offset);
 		}
-		/* Finish the clock cycle */
-	}
-	/* If clock_cycles is not divisable by 8, we have some extra data to write back here. */
-	if (clock_cycles & 7U) {
-		const size_t byte = (clock_cycles - 1U) >> 3U;
-		data_out[byte] = value;
+		for (; bit < body_cycles; ++bit)
+			value |= (uint32_t)jtagtap_tdi_tdo_cycle_no_delay((data >> bit) & 1U) << bit;
+		/* On the last cycle, assert final_tms to TMS_PIN */
+		if (final_word) {
+			gpio_set_val(TMS_PORT, TMS_PIN, final_tms);
+			value |= (uint32_t)jtagtap_tdi_tdo_cycle_no_delay((data >> bit) & 1U) << bit;
+		}
+		if (data_out)
+			jtagtap_word_store(data_out + (cycle >> 3U), value, word_cycles);
 	}
 	gpio_clear(TCK_PORT, TCK_PIN);
 }
@@ -227,50 +263,72 @@ static void jtagtap_tdi_tdo_seq(
 		jtagtap_tdi_tdo_seq_no_delay(data_in, data_out, final_tms, clock_cycles);
 }
 
+static inline void jtagtap_tdi_cycle_swd_delay(const bool tdi)
+{
+	/* Set up the TDI pin and start the clock cycle */
+	gpio_set_val(TDI_PORT, TDI_PIN, tdi);
+	gpio_set(TCK_PORT, TCK_PIN);
+	for (volatile int32_t cnt = swd_delay_cnt - 2; cnt > 0; cnt--)
+		continue;
+	/* Finish the clock cycle */
+	gpio_clear(TCK_PORT, TCK_PIN);
+	for (volatile int32_t cnt = swd_delay_cnt - 2; cnt > 0; cnt--)
+		continue;
+}
+
 static void jtagtap_tdi_seq_swd_delay(const uint8_t *const data_in, const bool final_tms, size_t clock_cycles)
 {
-	for (size_t cycle = 0; cycle < clock_cycles; ++cycle) {
-		const size_t bit = cycle & 7U;
-		const size_t byte = cycle >> 3U;
+	for (size_t cycle = 0; cycle < clock_cycles; cycle += 32U) {
+		const size_t word_cycles = MIN(clock_cycles - cycle, 32U);
+		const bool final_word = cycle + word_cycles == clock_cycles;
+		const size_t body_cycles = final_word ? word_cycles - 1U : word_cycles;
+		const uint32_t data = jtagtap_word_load(data_in + (cycle >> 3U), word_cycles);
+		size_t bit = 0;
+		for (; bit < body_cycles; ++bit)
+			jtagtap_tdi_cycle_swd_delay((data >> bit) & 1U);
 		/* On the last tick, assert final_tms to TMS_PIN */
-		gpio_set_val(TMS_PORT, TMS_PIN, cycle + 1U >= clock_cycles && final_tms);
-		/* Set up the TDI pin and start the clock cycle */
-		gpio_set_val(TDI_PORT, TDI_PIN, data_in[byte] & (1U << bit));
-		gpio_set(TCK_PORT, TCK_PIN);
-		for (volatile int32_t cnt = swd_delay_cnt - 2; cnt > 0; cnt--)
-			continue;
-		/* Finish the clock cycle */
-		gpio_clear(TCK_PORT, TCK_PIN);
-		for (volatile int32_t cnt = swd_delay_cnt - 2; cnt > 0; cnt--)
-			continue;
+		if (final_word) {
+			gpio_set_val(TMS_PORT, TMS_PIN, final_tms);
+			jtagtap_tdi_cycle_swd_delay((data >> bit) & 1U);
+		}
 	}
 }
 
+static inline void jtagtap_tdi_cycle_no_delay(const bool tdi)
+{
+	gpio_clear(TCK_PORT, TCK_PIN);
+	/* Set up the TDI pin and start the clock cycle */
+	gpio_set_val(TDI_PORT, TDI_PIN, tdi);
+	/* Block the compiler from re-ordering the calculations to preserve timings */
+	__asm__ volatile("" ::: "memory");
+	__asm__("nop");
+	__asm__("nop");
+	/* Block the compiler from re-ordering the calculations to preserve timings */
+	__asm__ volatile("nop" ::: "memory");
+	/* Start the clock cycle */
+	gpio_set(TCK_PORT, TCK_PIN);
+}
+
 static void jtagtap_tdi_seq_no_delay(const uint8_t *const data_in, const bool final_tms, size_t clock_cycles)
 {
-	for (size_t cycle = 0; cycle < clock_cycles;) {
-		const size_t bit = cycle & 7U;
-		const size_t byte = cycle >> 3U;
-		const bool tms = cycle + 1U >= clock_cycles && final_tms;
-		const bool tdi = data_in[byte] & (1U << bit);
-		/* Block the compiler from re-ordering the calculations to preserve timings */
-		__asm__ volatile("" ::: "memory");
-		gpio_clear(TCK_PORT, TCK_PIN);
+	for (size_t cycle = 0; cycle < clock_cycles; cycle += 32U) {
+		const size_t word_cycles = MIN(clock_cycles - cycle, 32U);
+		const bool final_word = cycle + word_cycles == clock_cycles;
+		const size_t body_cycles = final_word ? word_cycles - 1U : word_cycles;
+		const uint32_t data = jtagtap_word_load(data_in + (cycle >> 3U), word_cycles);
+		size_t bit = 0;
+		/* Go a byte at a time while we can, the fixed trip count of the inner loop lets it be unrolled */
+		for (; bit + 8U <= body_cycles; bit += 8U) {
+			for (size_t offset = 0; offset < 8U; ++offset)
+				jtagtap_tdi_cycle_no_delay((data >> (bit + offset)) & 1U);
+		}
+		for (; bit < body_cycles; ++bit)
+			jtagtap_tdi_cycle_no_delay((data >> bit) & 1U);
 		/* On the last tick, assert final_tms to TMS_PIN */
-		gpio_set_val(TMS_PORT, TMS_PIN, tms);
-		/* Set up the TDI pin and start the clock cycle */
-		gpio_set_val(TDI_PORT, TDI_PIN, tdi);
-		/* Block the compiler from re-ordering the calculations to preserve timings */
-		__asm__ volatile("" ::: "memory");
-		/* Increment the cycle counter */
-		++cycle;
-		__asm__("nop");
-		__asm__("nop");
-		/* Block the compiler from re-ordering the calculations to preserve timings */
-		__asm__ volatile("nop" ::: "memory");
-		/* Start the clock cycle */
-		gpio_set(TCK_PORT, TCK_PIN);
-		/* Finish the clock cycle */
+		if (final_word) {
+			gpio_set_val(TMS_PORT, TMS_PIN, final_tms);
+			jtagtap_tdi_cycle_no_delay((data >> bit) & 1U);
+		}
 	}
 	__asm__("nop");
 	__asm__("nop");
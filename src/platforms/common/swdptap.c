@@ -23,6 +23,10 @@
 #include "general.h"
 #include "timing.h"
 #include "swd.h"
+#include "adiv5.h"
+#ifdef PLATFORM_HAS_SWD_DMA
+#include "swdptap_dma.h"
+#endif
 
 #if !defined(SWDIO_IN_PORT)
 #define SWDIO_IN_PORT SWDIO_PORT
@@ -43,6 +47,8 @@ static uint32_t swdptap_seq_in(size_t clock_cycles) __attribute__((optimize(3)))
 static bool swdptap_seq_in_parity(uint32_t *ret, size_t clock_cycles) __attribute__((optimize(3)));
 static void swdptap_seq_out(uint32_t tms_states, size_t clock_cycles) __attribute__((optimize(3)));
 static void swdptap_seq_out_parity(uint32_t tms_states, size_t clock_cycles) __attribute__((optimize(3)));
+static uint8_t swdptap_transfer(uint8_t request, uint32_t *data, bool *parity_error, uint8_t idle_cycles)
+	__attribute__((optimize(3)));
 
 void swdptap_init(void)
 {
@@ -50,6 +56,11 @@ void swdptap_init(void)
 	swd_proc.seq_in_parity = swdptap_seq_in_parity;
 	swd_proc.seq_out = swdptap_seq_out;
 	swd_proc.seq_out_parity = swdptap_seq_out_parity;
+	swd_proc.transfer = swdptap_transfer;
+#ifdef PLATFORM_HAS_SWD_DMA
+	/* Hand SWD over to the timer and DMA driven implementation */
+	swdptap_dma_init();
+#endif
 }
 
 static void swdptap_turnaround(const swdio_status_t dir)
@@ -191,3 +202,22 @@ static void swdptap_seq_out_parity(const uint32_t tms_states, const size_t clock
 		continue;
 	gpio_clear(SWCLK_PORT, SWCLK_PIN);
 }
+
+static uint8_t swdptap_transfer(
+	const uint8_t request, uint32_t *const data, bool *const parity_error, const uint8_t idle_cycles)
+{
+	/* Calling the sequences directly rather than through swd_proc lets them be inlined into one routine */
+	swdptap_seq_out(request, 8U);
+	const uint8_t ack = swdptap_seq_in(3U);
+	if (ack != SWDP_ACK_OK)
+		return ack;
+	if (request & SWDP_REQUEST_RnW)
+		*parity_error = swdptap_seq_in_parity(data, 32U);
+	else {
+		swdptap_seq_out_parity(*data, 32U);
+		/* Clock the idle cycles the transfer policy asks for to complete the write */
+		if (idle_cycles)
+			swdptap_seq_out(0U, idle_cycles);
+	}
+	return ack;
+}
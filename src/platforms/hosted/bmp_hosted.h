@@ -68,6 +68,34 @@ typedef struct usb_link {
 	libusb_transfer_s *rep_trans;
 	void *priv;
 } usb_link_s;
+
+/* Maximum number of request/response transfer pairs a usb_queue_s can have in flight */
+#define USB_QUEUE_DEPTH_MAX 8U
+/* Buffer size and timeout used to read back stale responses when resynchronising a usb_queue_s */
+#define USB_QUEUE_STALE_BUFFER_SIZE 1024U
+#define USB_QUEUE_STALE_TIMEOUT_MS  50U
+
+typedef struct usb_queue_slot {
+	libusb_transfer_s *req_trans;
+	libusb_transfer_s *rep_trans;
+	transfer_ctx_s req_ctx;
+	transfer_ctx_s rep_ctx;
+} usb_queue_slot_s;
+
+/*
+ * Bulk request/response queue for probes that buffer several commands.
+ * Responses are reaped strictly in the order the requests were submitted.
+ */
+typedef struct usb_queue {
+	libusb_context *ctx;
+	libusb_device_handle *handle;
+	uint8_t ep_tx;
+	uint8_t ep_rx;
+	size_t depth;
+	size_t head;
+	size_t count;
+	usb_queue_slot_s slots[USB_QUEUE_DEPTH_MAX];
+} usb_queue_s;
 #endif
 
 typedef struct bmp_info {
@@ -101,6 +129,12 @@ void libusb_exit_function(bmp_info_s *info);
 bool device_is_bmp_gdb_port(const char *device);
 #else
 int send_recv(usb_link_s *link, uint8_t *txbuf, size_t txsize, uint8_t *rxbuf, size_t rxsize);
+bool usb_queue_init(usb_queue_s *queue, libusb_context *ctx, libusb_device_handle *handle, uint8_t ep_tx,
+	uint8_t ep_rx, size_t depth);
+void usb_queue_free(usb_queue_s *queue);
+bool usb_queue_submit(usb_queue_s *queue, uint8_t *txbuf, size_t txsize, uint8_t *rxbuf, size_t rxsize);
+int usb_queue_reap(usb_queue_s *queue);
+void usb_queue_drain(usb_queue_s *queue);
 #endif
 
 #endif /* PLATFORMS_HOSTED_BMP_HOSTED_H */
@@ -352,28 +352,15 @@ static void LIBUSB_CALL on_trans_done(libusb_transfer_s *const transfer)
 	ctx->flags |= TRANSFER_IS_DONE;
 }
 
-static int submit_wait(usb_link_s *link, libusb_transfer_s *transfer)
+static int transfer_wait(
+	libusb_context *const ctx, libusb_transfer_s *const transfer, transfer_ctx_s *const transfer_ctx)
 {
-	transfer_ctx_s transfer_ctx;
-
-	transfer_ctx.flags = 0;
-
-	/* brief intrusion inside the libusb interface */
-	transfer->callback = on_trans_done;
-	transfer->user_data = &transfer_ctx;
-
-	const libusb_error_e error = libusb_submit_transfer(transfer);
-	if (error) {
-		DEBUG_ERROR("libusb_submit_transfer(%d): %s\n", error, libusb_strerror(error));
-		exit(-1);
-	}
-
 	const uint32_t start_time = platform_time_ms();
-	while (transfer_ctx.flags == 0) {
+	while (transfer_ctx->flags == 0) {
 		timeval_s timeout;
 		timeout.tv_sec = 1;
 		timeout.tv_usec = 0;
-		if (libusb_handle_events_timeout(link->ul_libusb_ctx, &timeout)) {
+		if (libusb_handle_events_timeout(ctx, &timeout)) {
 			DEBUG_ERROR("libusb_handle_events()\n");
 			return -1;
 		}
@@ -384,7 +371,7 @@ static int submit_wait(usb_link_s *link, libusb_transfer_s *transfer)
 			return -1;
 		}
 	}
-	if (transfer_ctx.flags & TRANSFER_HAS_ERROR) {
+	if (transfer_ctx->flags & TRANSFER_HAS_ERROR) {
 		DEBUG_ERROR("libusb_handle_events() | has_error\n");
 		return -1;
 	}
@@ -392,6 +379,25 @@ static int submit_wait(usb_link_s *link, libusb_transfer_s *transfer)
 	return 0;
 }
 
+static int submit_wait(usb_link_s *link, libusb_transfer_s *transfer)
+{
+	transfer_ctx_s transfer_ctx;
+
+	transfer_ctx.flags = 0;
+
+	/* brief intrusion inside the libusb interface */
+	transfer->callback = on_trans_done;
+	transfer->user_data = &transfer_ctx;
+
+	const libusb_error_e error = libusb_submit_transfer(transfer);
+	if (error) {
+		DEBUG_ERROR("libusb_submit_transfer(%d): %s\n", error, libusb_strerror(error));
+		exit(-1);
+	}
+
+	return transfer_wait(link->ul_libusb_ctx, transfer, &transfer_ctx);
+}
+
 /* One USB transaction */
 int send_recv(usb_link_s *link, uint8_t *txbuf, size_t txsize, uint8_t *rxbuf, size_t rxsize)
 {
@@ -440,3 +446,144 @@ int send_recv(usb_link_s *link, uint8_t *txbuf, size_t txsize, uint8_t *rxbuf, s
 	DEBUG_WIRE("\n");
 	return res;
 }
+
+bool usb_queue_init(usb_queue_s *const queue, libusb_context *const ctx, libusb_device_handle *const handle,
+	const uint8_t ep_tx, const uint8_t ep_rx, const size_t depth)
+{
+	memset(queue, 0, sizeof(*queue));
+	queue->ctx = ctx;
+	queue->handle = handle;
+	queue->ep_tx = ep_tx;
+	queue->ep_rx = ep_rx;
+	queue->depth = MIN(depth, USB_QUEUE_DEPTH_MAX);
+	for (size_t i = 0; i < queue->depth; ++i) {
+		usb_queue_slot_s *const slot = &queue->slots[i];
+		slot->req_trans = libusb_alloc_transfer(0);
+		slot->rep_trans = libusb_alloc_transfer(0);
+		if (!slot->req_trans || !slot->rep_trans) {
+			DEBUG_ERROR("libusb_alloc_transfer() failed\n");
+			usb_queue_free(queue);
+			return false;
+		}
+	}
+	return true;
+}
+
+/*
+ * Get the queue back in step with the adaptor after a failure. Everything still in flight is cancelled
+ * and handed back to us, but any command the adaptor had already received will still be answered,
+ * and nothing would be there to read that answer. So once the endpoints are reset, read back and throw
+ * away responses until the adaptor goes quiet, so the next command gets its own response.
+ */
+static void usb_queue_resync(usb_queue_s *const queue)
+{
+	for (size_t i = 0; i < queue->count; ++i) {
+		usb_queue_slot_s *const slot = &queue->slots[(queue->head + i) % queue->depth];
+		if (!(slot->req_ctx.flags & TRANSFER_IS_DONE))
+			libusb_cancel_transfer(slot->req_trans);
+		if (!(slot->rep_ctx.flags & TRANSFER_IS_DONE))
+			libusb_cancel_transfer(slot->rep_trans);
+	}
+	for (size_t i = 0; i < queue->count; ++i) {
+		usb_queue_slot_s *const slot = &queue->slots[(queue->head + i) % queue->depth];
+		while (!(slot->req_ctx.flags & TRANSFER_IS_DONE) || !(slot->rep_ctx.flags & TRANSFER_IS_DONE)) {
+			timeval_s timeout = {.tv_sec = 1, .tv_usec = 0};
+			if (libusb_handle_events_timeout(queue->ctx, &timeout))
+				break;
+		}
+	}
+	/* There can be at most one stale response for each command that was in flight */
+	const size_t in_flight = queue->count;
+	queue->head = 0;
+	queue->count = 0;
+	libusb_clear_halt(queue->handle, queue->ep_tx);
+	libusb_clear_halt(queue->handle, queue->ep_rx);
+
+	uint8_t response[USB_QUEUE_STALE_BUFFER_SIZE];
+	for (size_t i = 0; i < in_flight; ++i) {
+		int length = 0;
+		if (libusb_bulk_transfer(queue->handle, queue->ep_rx | LIBUSB_ENDPOINT_IN, response, (int)sizeof(response),
+				&length, USB_QUEUE_STALE_TIMEOUT_MS) != LIBUSB_SUCCESS)
+			break;
+		DEBUG_WARN("Discarded a stale %d byte response\n", length);
+	}
+}
+
+void usb_queue_free(usb_queue_s *const queue)
+{
+	if (queue->count)
+		usb_queue_resync(queue);
+	for (size_t i = 0; i < queue->depth; ++i) {
+		libusb_free_transfer(queue->slots[i].req_trans);
+		libusb_free_transfer(queue->slots[i].rep_trans);
+	}
+	queue->depth = 0;
+}
+
+/*
+ * Submit a request and the transfer that will receive its response, without waiting for either.
+ * Both buffers must remain valid until the matching call to usb_queue_reap().
+ * Returns false if the queue is full or the submission failed.
+ */
+bool usb_queue_submit(
+	usb_queue_s *const queue, uint8_t *const txbuf, const size_t txsize, uint8_t *const rxbuf, const size_t rxsize)
+{
+	if (queue->count == queue->depth)
+		return false;
+	usb_queue_slot_s *const slot = &queue->slots[(queue->head + queue->count) % queue->depth];
+	slot->req_ctx.flags = 0;
+	slot->rep_ctx.flags = 0;
+	libusb_fill_bulk_transfer(slot->req_trans, queue->handle, queue->ep_tx | LIBUSB_ENDPOINT_OUT, txbuf, (int)txsize,
+		on_trans_done, &slot->req_ctx, 0);
+	libusb_fill_bulk_transfer(slot->rep_trans, queue->handle, queue->ep_rx | LIBUSB_ENDPOINT_IN, rxbuf, (int)rxsize,
+		on_trans_done, &slot->rep_ctx, 0);
+
+	libusb_error_e error = libusb_submit_transfer(slot->req_trans);
+	if (error) {
+		DEBUG_ERROR("libusb_submit_transfer(%d): %s\n", error, libusb_strerror(error));
+		return false;
+	}
+	/* Queue the response transfer straight away so the host controller keeps polling the IN endpoint */
+	error = libusb_submit_transfer(slot->rep_trans);
+	if (error) {
+		DEBUG_ERROR("libusb_submit_transfer(%d): %s\n", error, libusb_strerror(error));
+		slot->rep_ctx.flags = TRANSFER_IS_DONE;
+		++queue->count;
+		usb_queue_resync(queue);
+		return false;
+	}
+	++queue->count;
+	return true;
+}
+
+/*
+ * Wait for the oldest request in the queue to complete and return the length of its response.
+ * On failure the queue is resynchronised with the adaptor, dropping everything else in flight,
+ * as the ordering can no longer be trusted.
+ */
+int usb_queue_reap(usb_queue_s *const queue)
+{
+	if (!queue->count)
+		return -1;
+	usb_queue_slot_s *const slot = &queue->slots[queue->head];
+	if (transfer_wait(queue->ctx, slot->req_trans, &slot->req_ctx) ||
+		transfer_wait(queue->ctx, slot->rep_trans, &slot->rep_ctx)) {
+		usb_queue_resync(queue);
+		return -1;
+	}
+	queue->head = (queue->head + 1U) % queue->depth;
+	--queue->count;
+	return slot->rep_trans->actual_length;
+}
+
+/*
+ * Wait for every request still in the queue to complete, throwing their responses away.
+ * Used to get back in step with the adaptor when a response says a command failed.
+ */
+void usb_queue_drain(usb_queue_s *const queue)
+{
+	while (queue->count) {
+		if (usb_queue_reap(queue) < 0)
+			break;
+	}
+}
@@ -322,9 +322,188 @@ static void remote_adiv5_mem_write_bytes(adiv5_access_port_s *const target_ap, c
 	}
 }
 
-void remote_adiv5_dp_defaults(adiv5_debug_port_s *const target_dp)
+/*
+ * As the binary encoding can at worst double the size of a payload (every byte escaped),
+ * responses to binary reads need up to twice the block size plus the response code and
+ * the NUL terminator added by platform_buffer_read()
+ */
+#define REMOTE_BINARY_RESPONSE_SIZE ((REMOTE_ADIv5_MEM_MAX_LENGTH * 2U) + 2U)
+
+static void remote_adiv5_mem_read_bytes_binary(
+	adiv5_access_port_s *const target_ap, void *const dest, const uint32_t src, const size_t read_length)
+{
+	/* Check if we have anything to do */
+	if (!read_length)
+		return;
+	char *const data = (char *)dest;
+	DEBUG_PROBE("%s: @%08" PRIx32 "+%zx\n", __func__, src, read_length);
+	char buffer[REMOTE_BINARY_RESPONSE_SIZE];
+	/* For each transfer block size, ask the firmware to read that block of bytes */
+	for (size_t offset = 0; offset < read_length; offset += REMOTE_ADIv5_MEM_MAX_LENGTH) {
+		/* Pick the amount left to read or the block size, whichever is smaller */
+		const size_t amount = MIN(read_length - offset, REMOTE_ADIv5_MEM_MAX_LENGTH);
+		/* Create the request and send it to the remote */
+		int length = snprintf(buffer, REMOTE_MAX_MSG_SIZE, REMOTE_ADIv5_MEM_READ_BINARY_STR, target_ap->dp->dev_index,
+			target_ap->apsel, target_ap->csw, src + offset, amount);
+		platform_buffer_write(buffer, length);
+
+		/* Read back the answer and check for errors */
+		length = platform_buffer_read(buffer, REMOTE_BINARY_RESPONSE_SIZE);
+		if (!remote_adiv5_check_error(__func__, target_ap->dp, buffer, length)) {
+			DEBUG_ERROR("%s error around 0x%08zx\n", __func__, (size_t)src + offset);
+			return;
+		}
+		/* If the response indicates all's OK, decode the data read */
+		if (remote_binary_decode(data + offset, amount, buffer + 1, (size_t)length - 1U) != amount) {
+			DEBUG_ERROR("%s short response around 0x%08zx\n", __func__, (size_t)src + offset);
+			return;
+		}
+	}
+}
+
+static void remote_adiv5_mem_write_bytes_binary(adiv5_access_port_s *const target_ap, const uint32_t dest,
+	const void *const src, const size_t write_length, const align_e align)
+{
+	/* Check if we have anything to do */
+	if (!write_length)
+		return;
+	const uint8_t *const data = (const uint8_t *)src;
+	DEBUG_PROBE("%s: @%08" PRIx32 "+%zx alignment %u\n", __func__, dest, write_length, align);
+	/* + 1 for terminating NUL character */
+	char buffer[REMOTE_MAX_MSG_SIZE + 1U];
+	/* This is how much space we have for the escaped data after the request header and before the EOM marker */
+	const size_t payload_space = REMOTE_MAX_MSG_SIZE - REMOTE_ADIv5_MEM_WRITE_BINARY_LENGTH;
+	const size_t alignment_mask = (1U << align) - 1U;
+	char payload[REMOTE_MAX_MSG_SIZE - REMOTE_ADIv5_MEM_WRITE_BINARY_LENGTH];
+	for (size_t offset = 0; offset < write_length;) {
+		/* Escape as many bytes as will fit into the packet, stopping at the firmware's maximum request size */
+		size_t amount = 0U;
+		size_t payload_length = 0U;
+		size_t aligned_amount = 0U;
+		size_t aligned_payload_length = 0U;
+		while (offset + amount < write_length && amount < REMOTE_ADIv5_MEM_MAX_LENGTH) {
+			const uint8_t value = data[offset + amount];
+			const bool escape = remote_binary_needs_escape(value);
+			if (payload_length + (escape ? 2U : 1U) > payload_space)
+				break;
+			if (escape) {
+				payload[payload_length++] = REMOTE_ESCAPE;
+				payload[payload_length++] = (char)(value ^ 0x20U);
+			} else
+				payload[payload_length++] = (char)value;
+			++amount;
+			/* Keep track of the last point that respects the access alignment so each request stays aligned */
+			if (!(amount & alignment_mask)) {
+				aligned_amount = amount;
+				aligned_payload_length = payload_length;
+			}
+		}
+		/* If this is the tail of the data though, send everything that's left */
+		if (offset + amount == write_length) {
+			aligned_amount = amount;
+			aligned_payload_length = payload_length;
+		}
+		/* Create the request and validate it ends up the right length */
+		ssize_t length = snprintf(buffer, REMOTE_MAX_MSG_SIZE, REMOTE_ADIv5_MEM_WRITE_BINARY_STR,
+			target_ap->dp->dev_index, target_ap->apsel, target_ap->csw, align, dest + offset, aligned_amount);
+		assert(length == REMOTE_ADIv5_MEM_WRITE_BINARY_LENGTH - 1U);
+		/* Copy the escaped data in after the request block and append the packet termination marker */
+		memcpy(buffer + length, payload, aligned_payload_length);
+		length += (ssize_t)aligned_payload_length;
+		buffer[length++] = REMOTE_EOM;
+		buffer[length++] = '\0';
+		platform_buffer_write(buffer, length);
+
+		/* Read back the answer and check for errors */
+		length = platform_buffer_read(buffer, REMOTE_MAX_MSG_SIZE);
+		if (!remote_adiv5_check_error(__func__, target_ap->dp, buffer, length)) {
+			DEBUG_ERROR("%s error around 0x%08zx\n", __func__, (size_t)dest + offset);
+			return;
+		}
+		offset += aligned_amount;
+	}
+}
+
+static size_t remote_adiv5_batch_access(
+	adiv5_access_port_s *const target_ap, adiv5_batch_entry_s *const entries, const size_t count)
+{
+	/* + 1 for terminating NUL character */
+	char buffer[REMOTE_MAX_MSG_SIZE + 1U];
+	size_t completed = 0U;
+	/* Send the batch to the firmware in as few requests as it allows */
+	while (completed < count) {
+		const size_t amount = MIN(count - completed, REMOTE_ADIv5_BATCH_MAX_ENTRIES);
+		adiv5_batch_entry_s *const chunk = entries + completed;
+		/* Create the request header, then append each of the entries to it */
+		ssize_t length = snprintf(buffer, REMOTE_MAX_MSG_SIZE, REMOTE_ADIv5_BATCH_STR, target_ap->dp->dev_index,
+			target_ap->apsel, (uint8_t)amount);
+		assert(length == REMOTE_ADIv5_BATCH_LENGTH - 1U);
+		for (size_t idx = 0; idx < amount; ++idx) {
+			length += snprintf(buffer + length, REMOTE_MAX_MSG_SIZE - length, REMOTE_ADIv5_BATCH_ENTRY_STR,
+				chunk[idx].op, chunk[idx].addr, chunk[idx].value);
+		}
+		buffer[length++] = REMOTE_EOM;
+		buffer[length++] = '\0';
+		platform_buffer_write(buffer, length);
+
+		/* Read back the answer and check for errors */
+		length = platform_buffer_read(buffer, REMOTE_MAX_MSG_SIZE);
+		if (!remote_adiv5_check_error(__func__, target_ap->dp, buffer, length) || length < 5) {
+			DEBUG_ERROR("%s failed\n", __func__);
+			return completed;
+		}
+		/* Find out how many of the entries completed and what fault stopped the rest, if any */
+		uint8_t status[2];
+		unhexify(status, buffer + 1, sizeof(status));
+		const size_t done = MIN(status[0], amount);
+		/* Now distribute the results of the reads that completed */
+		const char *result = buffer + 5;
+		for (size_t idx = 0; idx < done; ++idx) {
+			if (chunk[idx].op == ADIV5_BATCH_AP_WRITE || chunk[idx].op == ADIV5_BATCH_LOW_WRITE)
+				continue;
+			uint32_t value = 0U;
+			if (result + 8 <= buffer + length) {
+				unhexify(&value, result, sizeof(value));
+				result += 8;
+			}
+			if (chunk[idx].result)
+				*chunk[idx].result = value;
+		}
+		DEBUG_PROBE("%s: %zu of %zu accesses completed\n", __func__, done, amount);
+		completed += done;
+		if (done != amount) {
+			target_ap->dp->fault = status[1];
+			break;
+		}
+	}
+	return completed;
+}
+
+static bool remote_adiv5_mem32_wait(adiv5_access_port_s *const target_ap, const uint32_t addr, const uint32_t mask,
+	const uint32_t match, const uint32_t timeout_ms, uint32_t *const value)
+{
+	char buffer[REMOTE_MAX_MSG_SIZE];
+	/* Create the request and send it to the remote */
+	ssize_t length = snprintf(buffer, REMOTE_MAX_MSG_SIZE, REMOTE_ADIv5_MEM32_WAIT_STR, target_ap->dp->dev_index,
+		target_ap->apsel, target_ap->csw, addr, mask, match, (uint16_t)MIN(timeout_ms, UINT16_MAX));
+	assert(length == REMOTE_ADIv5_MEM32_WAIT_LENGTH);
+	platform_buffer_write(buffer, length);
+	/* Read back the answer and check for errors */
+	length = platform_buffer_read(buffer, REMOTE_MAX_MSG_SIZE);
+	if (!remote_adiv5_check_error(__func__, target_ap->dp, buffer, length))
+		return false;
+	/* If the response indicates all's OK, decode the last value the probe read */
+	uint32_t result = 0U;
+	unhexify(&result, buffer + 1, 4);
+	DEBUG_PROBE("%s: @%08" PRIx32 " & %08" PRIx32 " -> %08" PRIx32 "\n", __func__, addr, mask, result);
+	if (value)
+		*value = result;
+	return (result & mask) == match;
+}
+
+/* Ask the remote for its protocol version, returning 0 if it's too old to know what one is */
+uint64_t remote_protocol_version(void)
 {
-	/* Ask the remote for its protocol version */
 	platform_buffer_write(REMOTE_HL_CHECK_STR, sizeof(REMOTE_HL_CHECK_STR));
 	char buffer[REMOTE_MAX_MSG_SIZE];
 	/* Read back the answer and check for errors */
@@ -332,12 +511,20 @@ void remote_adiv5_dp_defaults(adiv5_debug_port_s *const target_dp)
 	if (length < 1) {
 		DEBUG_ERROR("%s comms error: %zd\n", __func__, length);
 		exit(2);
-	} else if (buffer[0] != REMOTE_RESP_OK) {
+	}
+	if (buffer[0] != REMOTE_RESP_OK)
+		return 0;
+	/* If the probe's indicated that the request succeeded, convert the version number */
+	return remote_decode_response(buffer + 1, length - 1);
+}
+
+void remote_adiv5_dp_defaults(adiv5_debug_port_s *const target_dp)
+{
+	const uint64_t version = remote_protocol_version();
+	if (!version) {
 		DEBUG_INFO("Your probe firmware is too old, please update it to continue\n");
 		exit(1);
 	}
-	/* If the probe's indicated that the request succeeded, convert the version number */
-	const uint64_t version = remote_decode_response(buffer + 1, length - 1);
 	if (version < 2) {
 		DEBUG_WARN("Please update your probe's firmware for a substantial speed increase\n");
 		return;
@@ -351,8 +538,20 @@ void remote_adiv5_dp_defaults(adiv5_debug_port_s *const target_dp)
 	target_dp->dp_read = remote_adiv5_dp_read;
 	target_dp->ap_write = remote_adiv5_ap_write;
 	target_dp->ap_read = remote_adiv5_ap_read;
-	target_dp->mem_read = remote_adiv5_mem_read_bytes;
-	target_dp->mem_write = remote_adiv5_mem_write_bytes;
+	/* Version 6 and newer firmware can poll memory for a value on the probe */
+	if (version >= 6)
+		target_dp->mem32_wait = remote_adiv5_mem32_wait;
+	/* Version 5 and newer firmware can run batches of accesses in a single request */
+	if (version >= 5)
+		target_dp->batch_access = remote_adiv5_batch_access;
+	/* Version 4 and newer firmware can move memory contents as escaped binary rather than hex */
+	if (version >= 4) {
+		target_dp->mem_read = remote_adiv5_mem_read_bytes_binary;
+		target_dp->mem_write = remote_adiv5_mem_write_bytes_binary;
+	} else {
+		target_dp->mem_read = remote_adiv5_mem_read_bytes;
+		target_dp->mem_write = remote_adiv5_mem_write_bytes;
+	}
 }
 
 void remote_add_jtag_dev(uint32_t dev_indx, const jtag_dev_s *jtag_dev)
@@ -42,6 +42,7 @@ void remote_max_frequency_set(uint32_t freq);
 uint32_t remote_max_frequency_get(void);
 void remote_target_clk_output_enable(bool enable);
 
+uint64_t remote_protocol_version(void);
 void remote_adiv5_dp_defaults(adiv5_debug_port_s *dp);
 void remote_add_jtag_dev(uint32_t i, const jtag_dev_s *jtag_dev);
 
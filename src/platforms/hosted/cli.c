@@ -33,6 +33,7 @@
 #include "target_internal.h"
 #include "cortexm.h"
 #include "command.h"
+#include "crc32.h"
 
 #include "cli.h"
 #include "bmp_hosted.h"
@@ -131,7 +132,7 @@ static void cl_help(char **argv)
 	DEBUG_INFO("\n"
 			   "Usage: %s [-h | -l | [-v BITMASK] [-O] [-d PATH | -P NUMBER | -s SERIAL | -c TYPE]\n"
 			   "\t[-n NUMBER] [-j | -A] [-C] [-t | -T] [-e] [-p] [-R[h]] [-H] [-M STRING ...]\n"
-			   "\t[-f | -m] [-E | -w | -V | -r] [-a ADDR] [-S number] [file]]\n"
+			   "\t[-f | -m | -i | -b] [-E | -w | -V | -r] [-D] [-a ADDR] [-S number] [file]]\n"
 			   "\n"
 			   "The default is to start a debug server at localhost:2000\n\n"
 			   "Single-shot and verbosity options [-h | -l | -v BITMASK]:\n"
@@ -157,12 +158,14 @@ static void cl_help(char **argv)
 			   "\t-j, --jtag       Use JTAG instead of SWD\n"
 			   "\t-A, --auto-scan  Automatic scanning - try JTAG first, then SWD\n"
 			   "\t-C, --hw-reset   Connect to target under hardware reset\n"
-			   "\t-F, --fast-poll  Poll the target for execution status at maximum speed at\n"
-			   "\t                  the expense of increased CPU and USB resource utilisation.\n"
+			   "\t-F, --fast-poll  Poll the target for execution status at maximum speed, without\n"
+			   "\t                  backing off while it runs, at the expense of increased CPU and\n"
+			   "\t                  USB resource utilisation.\n"
 			   "\t-t, --list-chain Perform a chain scan and display information about the\n"
 			   "\t                   connected devices\n"
 			   "\t-T, --timing     Perform continues read- or write-back of a value to allow\n"
-			   "\t                   measurement of protocol timing. Aborted by ^C\n"
+			   "\t                   measurement of protocol timing, reporting the accesses\n"
+			   "\t                   per second achieved. Aborted by ^C\n"
 			   "\t-e, --ext-res    Assume external resistors for FTDI devices, that is having the\n"
 			   "\t                   FTDI chip connected through resistors to TMS, TDI and TDO\n"
 			   "\t-p, --power      Power the target from the probe (if possible)\n"
@@ -174,9 +177,13 @@ static void cl_help(char **argv)
 			   "\t                   If the command contains spaces, use quotes around the\n"
 			   "\t                   complete command\n"
 			   "\n"
-			   "SWD-specific configuration options [-f FREQUENCY | -m TARGET]:\n"
+			   "SWD-specific configuration options [-f FREQUENCY | -m TARGET | -i CYCLES | -b RETRIES]:\n"
 			   "\t-f, --freq       Set an operating frequency for SWD\n"
 			   "\t-m, --mult-drop  Use the given target ID for selection in SWD multi-drop\n"
+			   "\t-i, --idle       Number of idle cycles to clock after each write (0 to 32),\n"
+			   "\t                   0 runs transfers back to back\n"
+			   "\t-b, --wait-retry Number of times to retry an access the target answers\n"
+			   "\t                   WAIT to before giving up\n"
 			   "\n"
 			   "Flash operation selection options [-E | -w | -V | -r]:\n"
 			   "\t-E, --erase      Erase the target device Flash\n"
@@ -186,7 +193,9 @@ static void cl_help(char **argv)
 			   "\t                   binary file\n"
 			   "\t-r, --read       Read the target device Flash\n"
 			   "\n"
-			   "Flash operation modifiers options: [-a ADDR] [-S number] [FILE]\n"
+			   "Flash operation modifiers options: [-D] [-a ADDR] [-S number] [FILE]\n"
+			   "\t-D, --diff       Only erase and write the Flash blocks whose contents differ\n"
+			   "\t                   from the file being written\n"
 			   "\t-a, --addr       Start address for the given Flash operation (defaults to\n"
 			   "\t                   the start of Flash)\n"
 			   "\t-S, --byte-count Number of bytes to work on in the Flash operation (default\n"
@@ -219,10 +228,13 @@ static const getopt_option_s long_options[] = {
 	{"monitor", required_argument, NULL, 'M'},
 	{"freq", required_argument, NULL, 'f'},
 	{"multi-drop", required_argument, NULL, 'm'},
+	{"idle", required_argument, NULL, 'i'},
+	{"wait-retry", required_argument, NULL, 'b'},
 	{"erase", no_argument, NULL, 'E'},
 	{"write", no_argument, NULL, 'W'},
 	{"verify", no_argument, NULL, 'V'},
 	{"read", no_argument, NULL, 'r'},
+	{"diff", no_argument, NULL, 'D'},
 	{"addr", required_argument, NULL, 'a'},
 	{"byte-count", required_argument, NULL, 'S'},
 	{NULL, 0, NULL, 0},
@@ -237,7 +249,8 @@ void cl_init(bmda_cli_options_s *opt, int argc, char **argv)
 	opt->opt_scanmode = BMP_SCAN_SWD;
 	opt->opt_mode = BMP_MODE_DEBUG;
 	while (true) {
-		const int option = getopt_long(argc, argv, "eEFhHv:Od:f:s:I:c:Cln:m:M:wVtTa:S:jApP:rR::", long_options, NULL);
+		const int option =
+			getopt_long(argc, argv, "eEFhHv:Od:f:s:I:c:Cln:m:M:i:b:wVtTa:S:jApP:rR::D", long_options, NULL);
 		if (option == -1)
 			break;
 
@@ -338,6 +351,9 @@ void cl_init(bmda_cli_options_s *opt, int argc, char **argv)
 		case 'r':
 			opt->opt_mode = BMP_MODE_FLASH_READ;
 			break;
+		case 'D':
+			opt->opt_flash_diff = true;
+			break;
 		case 'R':
 			if ((optarg) && (tolower(optarg[0]) == 'h'))
 				opt->opt_mode = BMP_MODE_RESET_HW;
@@ -363,6 +379,20 @@ void cl_init(bmda_cli_options_s *opt, int argc, char **argv)
 			if (optarg)
 				opt->opt_monitor = optarg;
 			break;
+		case 'i':
+			if (optarg) {
+				const uint32_t idle_cycles = strtoul(optarg, NULL, 0);
+				if (idle_cycles > ADIV5_IDLE_CYCLES_MAX) {
+					DEBUG_ERROR("Idle cycles must be between 0 and %u, got '%s'\n", ADIV5_IDLE_CYCLES_MAX, optarg);
+					exit(1);
+				}
+				adiv5_transfer_policy.idle_cycles = idle_cycles;
+			}
+			break;
+		case 'b':
+			if (optarg)
+				adiv5_transfer_policy.wait_retries = MIN(strtoul(optarg, NULL, 0), UINT16_MAX);
+			break;
 		case 'P':
 			if (optarg)
 				opt->opt_position = strtol(optarg, NULL, 0);
@@ -431,6 +461,103 @@ uint32_t scan_for_targets(const bmda_cli_options_s *const opt)
 	return 0U;
 }
 
+typedef struct flash_stage {
+	const char *name;
+	size_t bytes;
+	uint32_t time_ms;
+} flash_stage_s;
+
+static void flash_stage_report(const flash_stage_s *const stage)
+{
+	if (!stage->bytes)
+		return;
+	DEBUG_INFO("  %-6s %8zu bytes in %6" PRIu32 "ms, %8.3fkiB/s\n", stage->name, stage->bytes, stage->time_ms,
+		stage->time_ms ? (double)stage->bytes / stage->time_ms : 0.0);
+}
+
+static bool flash_verify_unit(target_s *const t, const target_addr_t addr, const uint8_t *const data, const size_t len)
+{
+	uint32_t crc = 0;
+	return generic_crc32(t, &crc, addr, len) && crc == crc32_buffer(0xffffffffU, data, len);
+}
+
+/*
+ * Verify the image by CRC. The whole range is done in one go, as each generic_crc32() call has to load
+ * the CRC stub and save and restore the target's state. Only if that doesn't match is the range split
+ * into units, each the larger of the erase block size and the Flash write buffer size, to find the
+ * region the failure is in.
+ */
+static bool flash_verify(target_s *const t, const target_addr_t start, const uint8_t *const data, const size_t size)
+{
+	if (flash_verify_unit(t, start, data, size))
+		return true;
+	DEBUG_WARN("CRC32 check did not pass, checking each unit to find the difference\n");
+	for (size_t offset = 0; offset < size;) {
+		const target_addr_t addr = start + offset;
+		const target_flash_s *const f = target_flash_for_addr(t, addr);
+		if (!f)
+			break;
+		const size_t unit_size = MAX(f->blocksize, f->writebufsize);
+		const target_addr_t unit_end = (addr & ~(unit_size - 1U)) + unit_size;
+		const size_t len = MIN(unit_end - addr, size - offset);
+		if (!flash_verify_unit(t, addr, data + offset, len)) {
+			DEBUG_ERROR("Verify failed at flash region 0x%08" PRIx32 "\n", addr);
+			return false;
+		}
+		offset += len;
+	}
+	DEBUG_ERROR("Verify failed\n");
+	return false;
+}
+
+/*
+ * Write (and optionally verify) an image to Flash straight from the mapped image. The whole range is
+ * erased first and then the image streamed in, so each Flash goes through one prepare/done cycle for
+ * the erase and one for the write. Drivers that unlock the Flash or load a programming stub when
+ * prepared then only do so once for each, rather than once per erase block.
+ */
+static bool cl_flash_write(target_s *const t, const target_addr_t start, const uint8_t *const data, const size_t size,
+	const bool verify)
+{
+	flash_stage_s erase = {"erase", 0, 0};
+	flash_stage_s write = {"write", 0, 0};
+	flash_stage_s check = {"verify", 0, 0};
+
+	uint32_t stage_start = platform_time_ms();
+	if (!target_flash_erase(t, start, size)) {
+		DEBUG_ERROR("Flash erase failed\n");
+		return false;
+	}
+	erase.time_ms = platform_time_ms() - stage_start;
+	erase.bytes = size;
+
+	stage_start = platform_time_ms();
+	if (!target_flash_write(t, start, data, size)) {
+		DEBUG_ERROR("Flash write failed\n");
+		return false;
+	}
+	/* Flush the final buffer out and finish up */
+	if (!target_flash_complete(t)) {
+		DEBUG_ERROR("Flash write failed completing the operation\n");
+		return false;
+	}
+	write.time_ms = platform_time_ms() - stage_start;
+	write.bytes = size;
+
+	if (verify) {
+		stage_start = platform_time_ms();
+		if (!flash_verify(t, start, data, size))
+			return false;
+		check.time_ms = platform_time_ms() - stage_start;
+		check.bytes = size;
+	}
+
+	flash_stage_report(&erase);
+	flash_stage_report(&write);
+	flash_stage_report(&check);
+	return true;
+}
+
 int cl_execute(bmda_cli_options_s *opt)
 {
 	if (opt->opt_mode == BMP_MODE_RESET_HW) {
@@ -522,11 +649,20 @@ int cl_execute(bmda_cli_options_s *opt)
 		 */
 		if (t->core[0] == 'M') {
 			DEBUG_WARN("Continuous read/write-back DEMCR. Abort with ^C\n");
+			uint32_t accesses = 0;
+			uint32_t start = platform_time_ms();
 			while (true) {
 				uint32_t demcr;
 				target_mem_read(t, &demcr, CORTEXM_DEMCR, 4);
 				target_mem_write32(t, CORTEXM_DEMCR, demcr);
-				platform_delay(1); /* To allow trigger */
+				accesses += 2U;
+				/* Report the rate achieved about once a second, which also leaves a gap to trigger on */
+				const uint32_t elapsed = platform_time_ms() - start;
+				if (elapsed >= 1000U) {
+					DEBUG_WARN("%" PRIu64 " accesses/s\n", (accesses * UINT64_C(1000)) / elapsed);
+					accesses = 0;
+					start = platform_time_ms();
+				}
 			}
 		} else
 			DEBUG_ERROR("No test for this core type yet\n");
@@ -570,31 +706,40 @@ int cl_execute(bmda_cli_options_s *opt)
 		}
 		target_reset(t);
 	} else if (opt->opt_mode == BMP_MODE_FLASH_WRITE || opt->opt_mode == BMP_MODE_FLASH_WRITE_VERIFY) {
-		DEBUG_INFO("Erasing %zu bytes at 0x%08" PRIx32 "\n", map.size, opt->opt_flash_start);
-		const uint32_t start_time = platform_time_ms();
-		if (!target_flash_erase(t, opt->opt_flash_start, map.size)) {
-			DEBUG_ERROR("Flash erase failed!\n");
-			res = -1;
-			goto free_map;
-		}
 		DEBUG_INFO("Flashing %zu bytes at 0x%08" PRIx32 "\n", map.size, opt->opt_flash_start);
-		/* Buffered write cares for padding*/
-		if (!target_flash_write(t, opt->opt_flash_start, map.data, map.size) || !target_flash_complete(t)) {
+		target_flash_diff = opt->opt_flash_diff;
+		const uint32_t start_time = platform_time_ms();
+		if (!cl_flash_write(
+				t, opt->opt_flash_start, map.data, map.size, opt->opt_mode == BMP_MODE_FLASH_WRITE_VERIFY)) {
 			DEBUG_ERROR("Flashing failed!\n");
 			res = -1;
 			goto free_map;
 		}
 		DEBUG_INFO("Success!\n");
 		const uint32_t end_time = platform_time_ms();
-		DEBUG_WARN(
-			"Flash Write succeeded for %zu bytes, %8.3fkiB/s\n", map.size, (double)map.size / (end_time - start_time));
-		if (opt->opt_mode != BMP_MODE_FLASH_WRITE_VERIFY) {
-			target_reset(t);
+		DEBUG_WARN("Flash Write%s succeeded for %zu bytes, %8.3fkiB/s\n",
+			opt->opt_mode == BMP_MODE_FLASH_WRITE_VERIFY ? " and Verify" : "", map.size,
+			(double)map.size / (end_time - start_time));
+		target_reset(t);
+		goto free_map;
+	}
+	if (opt->opt_mode == BMP_MODE_FLASH_VERIFY) {
+		/*
+		 * Try comparing CRCs first - when the target can calculate its CRC itself, this saves reading
+		 * the whole image back. Only if they differ do we read it back to find where the mismatch is.
+		 */
+		const uint32_t start_time = platform_time_ms();
+		uint32_t crc = 0;
+		if (generic_crc32(t, &crc, opt->opt_flash_start, map.size) &&
+			crc == crc32_buffer(0xffffffffU, map.data, map.size)) {
+			const uint32_t end_time = platform_time_ms();
+			DEBUG_WARN("Verify succeeded for %zu bytes by CRC32 (0x%08" PRIx32 ") in %" PRIu32 "ms\n", map.size, crc,
+				end_time - start_time);
 			goto free_map;
 		}
+		DEBUG_WARN("CRC32 check did not pass, reading back Flash to find the difference\n");
 	}
-	if (opt->opt_mode == BMP_MODE_FLASH_READ || opt->opt_mode == BMP_MODE_FLASH_VERIFY ||
-		opt->opt_mode == BMP_MODE_FLASH_WRITE_VERIFY) {
+	if (opt->opt_mode == BMP_MODE_FLASH_READ || opt->opt_mode == BMP_MODE_FLASH_VERIFY) {
 #define WORKSIZE 0x1000U
 		uint8_t data[WORKSIZE];
 		if (opt->opt_mode == BMP_MODE_FLASH_READ)
@@ -616,9 +761,9 @@ int cl_execute(bmda_cli_options_s *opt)
 				break;
 			}
 			bytes_read += worksize;
-			if (opt->opt_mode == BMP_MODE_FLASH_VERIFY || opt->opt_mode == BMP_MODE_FLASH_WRITE_VERIFY) {
+			if (opt->opt_mode == BMP_MODE_FLASH_VERIFY) {
 				if (memcmp(data, flash + offset, worksize) != 0) {
-					DEBUG_ERROR("Verify failed at flash region 0x%08" PRIx32 "\n", flash_src);
+					DEBUG_ERROR("Verify failed at flash region 0x%08" PRIx32 "\n", (uint32_t)(flash_src + offset));
 					res = -1;
 					goto free_map;
 				}
@@ -642,8 +787,6 @@ int cl_execute(bmda_cli_options_s *opt)
 			close(read_file);
 		DEBUG_WARN("Read/Verify succeeded for %zu bytes, %8.3fkiB/s\n", bytes_read,
 			(double)bytes_read / (end_time - start_time));
-		if (opt->opt_mode == BMP_MODE_FLASH_WRITE_VERIFY)
-			target_reset(t);
 	}
 free_map:
 	if (map.size)
@@ -104,7 +104,19 @@ static uint8_t in_ep;
 static uint8_t out_ep;
 static hid_device *handle = NULL;
 static uint8_t buffer[1024U];
-static size_t report_size = 64U + 1U; // TODO: read actual report size
+static size_t report_size = 64U + 1U;
+static bool report_size_quirk = false;
+static usb_queue_s usb_queue;
+
+/* Storage for commands in flight through usb_queue, indexed the same way as the queue's own slots */
+typedef struct dap_queued_cmd {
+	uint8_t request[1024U];
+	uint8_t response[1024U];
+	void *response_data;
+	size_t response_length;
+} dap_queued_cmd_s;
+
+static dap_queued_cmd_s queued_cmds[USB_QUEUE_DEPTH_MAX];
 bool dap_has_swd_sequence = false;
 
 dap_version_s dap_adaptor_version(dap_info_e version_kind);
@@ -183,6 +195,7 @@ static bool dap_init_hid(const bmp_info_s *const info)
 	if (info->vid == 0x1fc9U && info->pid == 0x0132U) {
 		DEBUG_WARN("Device does not work with the normal report length, activating quirk\n");
 		report_size = 64U + 1U;
+		report_size_quirk = true;
 	}
 	handle = hid_open(info->vid, info->pid, serial[0] ? serial : NULL);
 	if (!handle) {
@@ -262,6 +275,25 @@ bool dap_init(bmp_info_s *const info)
 	DEBUG_INFO(")\n");
 
 	DEBUG_INFO("Adaptor %s DAP SWD sequences\n", dap_has_swd_sequence ? "supports" : "does not support");
+
+	/* Size our requests to the adaptor's packet size so DAP_Transfer batches can be as large as possible */
+	uint8_t packet_size[2] = {};
+	if (!report_size_quirk && dap_info(DAP_INFO_PACKET_SIZE, packet_size, sizeof(packet_size)) == 2U) {
+		const size_t size = read_le2(packet_size, 0);
+		if (size >= 64U) {
+			/* report_size accounts for the HID report ID byte, so is one more than the packet size */
+			report_size = MIN(size, sizeof(buffer) - 1U) + 1U;
+			DEBUG_INFO("Adaptor packet size is %zu bytes\n", size);
+		}
+	}
+
+	/* If the adaptor can buffer more than one command, set up to keep that many in flight on the bulk endpoints */
+	if (type == CMSIS_TYPE_BULK) {
+		uint8_t packet_count = 1U;
+		if (dap_info(DAP_INFO_PACKET_COUNT, &packet_count, sizeof(packet_count)) == 1U && packet_count > 1U &&
+			usb_queue_init(&usb_queue, info->libusb_ctx, usb_handle, out_ep, in_ep, packet_count))
+			DEBUG_INFO("Adaptor buffers %u packets, queueing up to %zu\n", packet_count, usb_queue.depth);
+	}
 	return true;
 }
 
@@ -318,6 +350,11 @@ void dap_nrst_set_val(bool assert)
 	dap_set_reset_state(assert);
 }
 
+void dap_buffer_flush(void)
+{
+	perform_dap_transfer_flush(false);
+}
+
 void dap_dp_abort(adiv5_debug_port_s *const target_dp, const uint32_t abort)
 {
 	/* DP Write to Reg 0.*/
@@ -354,6 +391,7 @@ void dap_exit_function(void)
 	} else if (type == CMSIS_TYPE_BULK) {
 		if (usb_handle) {
 			dap_disconnect();
+			usb_queue_free(&usb_queue);
 			libusb_close(usb_handle);
 		}
 	}
@@ -423,7 +461,7 @@ static ssize_t dap_run_cmd_raw(const uint8_t *const request_data, const size_t r
 		DEBUG_WIRE("%02x ", request_data[i]);
 	DEBUG_WIRE("\n");
 
-	uint8_t data[65];
+	uint8_t data[sizeof(buffer)];
 
 	ssize_t response = -1;
 	if (type == CMSIS_TYPE_HID)
@@ -444,32 +482,101 @@ static ssize_t dap_run_cmd_raw(const uint8_t *const request_data, const size_t r
 	return response;
 }
 
+/* The largest DAP command (or response) the adaptor can handle, not including the HID report ID */
+size_t dap_packet_size(void)
+{
+	return report_size - 1U;
+}
+
 bool dap_run_cmd(const void *const request_data, const size_t request_length, void *const response_data,
 	const size_t response_length)
 {
+	/* No other command may overtake deferred AP writes, and most invalidate what we know about SELECT and CSW */
+	const uint8_t command = ((const uint8_t *)request_data)[0];
+	if (command != DAP_TRANSFER)
+		perform_dap_transfer_flush(command != DAP_TRANSFER_BLOCK);
 	/* This subtracts one off the result to account for the command byte that gets stripped above */
 	const ssize_t result =
 		dap_run_cmd_raw((const uint8_t *)request_data, request_length, (uint8_t *)response_data, response_length) - 1U;
 	return (size_t)result >= response_length;
 }
 
+/* The number of commands that may be queued with dap_queue_cmd() before one has to be reaped */
+size_t dap_queue_depth(void)
+{
+	return usb_queue.depth > 1U ? usb_queue.depth : 1U;
+}
+
+/*
+ * Queue a command without waiting for its response. The response is copied out to response_data
+ * (minus the command byte) by the matching call to dap_reap_cmd(), so it must remain valid until then.
+ */
+bool dap_queue_cmd(const void *const request_data, const size_t request_length, void *const response_data,
+	const size_t response_length)
+{
+	/* With no queue set up (HID adaptors, or if it failed to initialise) there's nowhere to put the command */
+	if (!usb_queue.depth || usb_queue.count == usb_queue.depth || request_length > sizeof(queued_cmds[0].request))
+		return false;
+	dap_queued_cmd_s *const cmd = &queued_cmds[(usb_queue.head + usb_queue.count) % usb_queue.depth];
+	memcpy(cmd->request, request_data, request_length);
+	cmd->response_data = response_data;
+	cmd->response_length = response_length;
+
+	DEBUG_WIRE(" queued: ");
+	for (size_t i = 0; i < request_length; ++i)
+		DEBUG_WIRE("%02x ", cmd->request[i]);
+	DEBUG_WIRE("\n");
+	return usb_queue_submit(&usb_queue, cmd->request, request_length, cmd->response, sizeof(cmd->response));
+}
+
+/* Wait for the oldest queued command to complete, with the same result semantics as dap_run_cmd() */
+bool dap_reap_cmd(void)
+{
+	if (!usb_queue.count)
+		return false;
+	dap_queued_cmd_s *const cmd = &queued_cmds[usb_queue.head];
+	const int result = usb_queue_reap(&usb_queue);
+	if (result < 1 || cmd->response[0] != cmd->request[0]) {
+		DEBUG_ERROR("CMSIS-DAP queued command %02x failed\n", cmd->request[0]);
+		return false;
+	}
+	const size_t response_length = (size_t)result - 1U;
+
+	DEBUG_WIRE("response: ");
+	for (size_t i = 0; i < (size_t)result; i++)
+		DEBUG_WIRE("%02x ", cmd->response[i]);
+	DEBUG_WIRE("\n");
+
+	if (cmd->response_length)
+		memcpy(cmd->response_data, cmd->response + 1U, MIN(cmd->response_length, response_length));
+	return response_length >= cmd->response_length;
+}
+
+/* Wait for every queued command to complete, throwing their responses away */
+void dap_drain_queue(void)
+{
+	usb_queue_drain(&usb_queue);
+}
+
 #define ALIGNOF(x) (((x)&3) == 0 ? ALIGN_WORD : (((x)&1) == 0 ? ALIGN_HALFWORD : ALIGN_BYTE))
 
-static void dap_mem_read(adiv5_access_port_s *ap, void *dest, uint32_t src, size_t len)
+/*
+ * Read a run of AP_DRW accesses of the given width. When packed, src and len must be word aligned and
+ * each access carries a whole word's worth of align sized accesses, so the data comes back as words.
+ */
+static bool dap_mem_read_run(adiv5_access_port_s *const ap, void *const dest, const uint32_t src, const size_t len,
+	const align_e align, const bool packed)
 {
-	if (len == 0)
-		return;
-	align_e align = MIN(ALIGNOF(src), ALIGNOF(len));
-	DEBUG_WIRE("dap_mem_read @ %" PRIx32 " len %zu, align %d\n", src, len, align);
-	/* If the read can be done in a single transaction, use the dap_read_single() fast-path */
-	if ((1U << align) == len)
-		return dap_read_single(ap, dest, src, align);
-	/* Otherwise proceed blockwise */
-	const size_t blocks_per_transfer = (report_size - 4U) >> 2U;
+	const align_e data_align = packed ? ALIGN_WORD : align;
+	/* A DAP_TransferBlock read response carries 3 bytes of header before the data */
+	const size_t blocks_per_transfer = (dap_packet_size() - 3U) >> 2U;
+	/* If the adaptor can buffer several commands, keep it fed by queueing the block transfers */
+	if (dap_queue_depth() > 1U)
+		return dap_read_block_queued(ap, dest, src, len, align, packed, blocks_per_transfer);
 	uint8_t *const data = (uint8_t *)dest;
 	for (size_t offset = 0; offset < len;) {
 		/* Setup AP_TAR every loop as failing to do so results in it wrapping */
-		dap_ap_mem_access_setup(ap, src + offset, align);
+		dap_ap_mem_access_setup(ap, src + offset, align, packed);
 		/*
 		 * src can start out unaligned to a 1024 byte chunk size,
 		 * so we have to calculate how much is left of the chunk.
@@ -477,34 +584,63 @@ static void dap_mem_read(adiv5_access_port_s *ap, void *dest, uint32_t src, size
 		 * has requested we fill.
 		 */
 		const size_t chunk_remaining = MIN(1024 - ((src + offset) & 0x3ffU), len - offset);
-		const size_t blocks = chunk_remaining >> align;
+		const size_t blocks = chunk_remaining >> data_align;
 		for (size_t i = 0; i < blocks; i += blocks_per_transfer) {
 			/* blocks - i gives how many blocks are left to transfer in this 1024 byte chunk */
-			const size_t transfer_length = MIN(blocks - i, blocks_per_transfer) << align;
-			if (!dap_read_block(ap, data + offset, src + offset, transfer_length, align)) {
-				DEBUG_WIRE("mem_read failed: %u\n", ap->dp->fault);
-				return;
-			}
+			const size_t transfer_length = MIN(blocks - i, blocks_per_transfer) << data_align;
+			if (!dap_read_block(ap, data + offset, src + offset, transfer_length, data_align))
+				return false;
 			offset += transfer_length;
 		}
 	}
-	DEBUG_WIRE("dap_mem_read transferred %zu blocks\n", len >> align);
+	return true;
 }
 
-static void dap_mem_write(adiv5_access_port_s *ap, uint32_t dest, const void *src, size_t len, align_e align)
+static void dap_mem_read(adiv5_access_port_s *ap, void *dest, uint32_t src, size_t len)
 {
 	if (len == 0)
 		return;
-	DEBUG_WIRE("memwrite @ %" PRIx32 " len %zu, align %d\n", dest, len, align);
-	/* If the write can be done in a single transaction, use the dap_write_single() fast-path */
+	align_e align = MIN(ALIGNOF(src), ALIGNOF(len));
+	DEBUG_WIRE("dap_mem_read @ %" PRIx32 " len %zu, align %d\n", src, len, align);
+	/* If the read can be done in a single transaction, use the dap_read_single() fast-path */
 	if ((1U << align) == len)
-		return dap_write_single(ap, dest, src, align);
-	/* Otherwise proceed blockwise */
-	const size_t blocks_per_transfer = (report_size - 4U) >> 2U;
+		return dap_read_single(ap, dest, src, align);
+	/* Otherwise proceed blockwise, doing the word-aligned middle of a sub-word read packed if the AP can */
+	uint8_t *const data = (uint8_t *)dest;
+	size_t head;
+	const size_t middle = adiv5_packed_split(ap, src, len, align, &head);
+	const size_t tail = middle ? len - head - middle : 0U;
+	bool result = true;
+	if (!middle)
+		result = dap_mem_read_run(ap, dest, src, len, align, false);
+	else {
+		if (head)
+			result = dap_mem_read_run(ap, data, src, head, align, false);
+		result = result && dap_mem_read_run(ap, data + head, src + head, middle, align, true);
+		if (tail)
+			result = result && dap_mem_read_run(ap, data + head + middle, src + head + middle, tail, align, false);
+	}
+	if (!result) {
+		DEBUG_WIRE("mem_read failed: %u\n", ap->dp->fault);
+		return;
+	}
+	DEBUG_WIRE("dap_mem_read transferred %zu blocks\n", len >> align);
+}
+
+/* Write a run of AP_DRW accesses of the given width, with the same packing rules as dap_mem_read_run() */
+static bool dap_mem_write_run(adiv5_access_port_s *const ap, const uint32_t dest, const void *const src,
+	const size_t len, const align_e align, const bool packed)
+{
+	const align_e data_align = packed ? ALIGN_WORD : align;
+	/* A DAP_TransferBlock write request carries 5 bytes of header before the data */
+	const size_t blocks_per_transfer = (dap_packet_size() - 5U) >> 2U;
+	/* If the adaptor can buffer several commands, keep it fed by queueing the block transfers */
+	if (dap_queue_depth() > 1U)
+		return dap_write_block_queued(ap, dest, src, len, align, packed, blocks_per_transfer);
 	const uint8_t *const data = (const uint8_t *)src;
 	for (size_t offset = 0; offset < len;) {
 		/* Setup AP_TAR every loop as failing to do so results in it wrapping */
-		dap_ap_mem_access_setup(ap, dest + offset, align);
+		dap_ap_mem_access_setup(ap, dest + offset, align, packed);
 		/*
 		 * dest can start out unaligned to a 1024 byte chunk size,
 		 * so we have to calculate how much is left of the chunk.
@@ -512,18 +648,45 @@ static void dap_mem_write(adiv5_access_port_s *ap, uint32_t dest, const void *sr
 		 * has requested we fill.
 		 */
 		const size_t chunk_remaining = MIN(1024 - ((dest + offset) & 0x3ffU), len - offset);
-		const size_t blocks = chunk_remaining >> align;
+		const size_t blocks = chunk_remaining >> data_align;
 		for (size_t i = 0; i < blocks; i += blocks_per_transfer) {
 			/* blocks - i gives how many blocks are left to transfer in this 1024 byte chunk */
-			const size_t transfer_length = MIN(blocks - i, blocks_per_transfer) << align;
-			if (!dap_write_block(ap, dest + offset, data + offset, transfer_length, align)) {
-				DEBUG_WIRE("mem_write failed: %u\n", ap->dp->fault);
-				return;
-			}
+			const size_t transfer_length = MIN(blocks - i, blocks_per_transfer) << data_align;
+			if (!dap_write_block(ap, dest + offset, data + offset, transfer_length, data_align))
+				return false;
 			offset += transfer_length;
 		}
 	}
-	DEBUG_WIRE("dap_mem_write_sized transferred %zu blocks\n", len >> align);
+	return true;
+}
+
+static void dap_mem_write(adiv5_access_port_s *ap, uint32_t dest, const void *src, size_t len, align_e align)
+{
+	if (len == 0)
+		return;
+	DEBUG_WIRE("memwrite @ %" PRIx32 " len %zu, align %d\n", dest, len, align);
+	/* If the write can be done in a single transaction, use the dap_write_single() fast-path */
+	if ((1U << align) == len)
+		return dap_write_single(ap, dest, src, align);
+	/* Otherwise proceed blockwise, doing the word-aligned middle of a sub-word write packed if the AP can */
+	const uint8_t *const data = (const uint8_t *)src;
+	size_t head;
+	const size_t middle = adiv5_packed_split(ap, dest, len, align, &head);
+	const size_t tail = middle ? len - head - middle : 0U;
+	bool result = true;
+	if (!middle)
+		result = dap_mem_write_run(ap, dest, src, len, align, false);
+	else {
+		if (head)
+			result = dap_mem_write_run(ap, dest, data, head, align, false);
+		result = result && dap_mem_write_run(ap, dest + head, data + head, middle, align, true);
+		if (tail)
+			result = result && dap_mem_write_run(ap, dest + head + middle, data + head + middle, tail, align, false);
+	}
+	if (result)
+		DEBUG_WIRE("dap_mem_write_sized transferred %zu blocks\n", len >> align);
+	else
+		DEBUG_WIRE("mem_write failed: %u\n", ap->dp->fault);
 
 	/* Make sure this write is complete by doing a dummy read */
 	adiv5_dp_read(ap->dp, ADIV5_DP_RDBUFF);
@@ -536,4 +699,5 @@ void dap_adiv5_dp_defaults(adiv5_debug_port_s *target_dp)
 	target_dp->ap_write = dap_ap_write;
 	target_dp->mem_read = dap_mem_read;
 	target_dp->mem_write = dap_mem_write;
+	target_dp->mem32_wait = dap_mem32_wait;
 }
@@ -34,6 +34,7 @@ void dap_jtag_dp_init(adiv5_debug_port_s *dp);
 uint32_t dap_swj_clock(uint32_t clock);
 void dap_swd_configure(uint8_t cfg);
 void dap_nrst_set_val(bool assert);
+void dap_buffer_flush(void);
 #else
 bool dap_init(bmp_info_s *info)
 {
@@ -81,6 +82,10 @@ void dap_nrst_set_val(bool assert)
 {
 }
 
+void dap_buffer_flush(void)
+{
+}
+
 #pragma GCC diagnostic pop
 #endif
 
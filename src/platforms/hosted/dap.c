@@ -39,9 +39,12 @@
 #include "dap_command.h"
 #include "jtag_scan.h"
 #include "buffer_utils.h"
+#include "bmp_hosted.h"
 
-#define DAP_TRANSFER_APnDP (1U << 0U)
-#define DAP_TRANSFER_RnW   (1U << 1U)
+#define DAP_TRANSFER_APnDP       (1U << 0U)
+#define DAP_TRANSFER_RnW         (1U << 1U)
+#define DAP_TRANSFER_MATCH_VALUE (1U << 4U)
+#define DAP_TRANSFER_MATCH_MASK  (1U << 5U)
 
 #define DAP_TRANSFER_WAIT (1U << 1U)
 
@@ -92,11 +95,14 @@ static uint32_t dap_current_clock_freq;
 bool dap_connect(void)
 {
 	/*
-	 * Setup how DAP_TRANSFER* commands will work
-	 * Sets 2 idle cycles between commands,
+	 * Setup how DAP_TRANSFER* commands will work from the transfer policy.
+	 * By default, sets 2 idle cycles between commands,
 	 * 128 retries each for wait and match retries
 	 */
-	if (!dap_transfer_configure(2, 128, 128))
+	const adiv5_transfer_policy_s *const policy = &adiv5_transfer_policy;
+	const uint8_t idle_cycles = policy->idle_cycles == ADIV5_IDLE_CYCLES_DEFAULT ? 2U : policy->idle_cycles;
+	const uint16_t wait_retries = policy->wait_retries ? policy->wait_retries : 128U;
+	if (!dap_transfer_configure(idle_cycles, wait_retries, 128))
 		return false;
 
 	/* Setup the connection request */
@@ -302,6 +308,189 @@ bool dap_write_block(
 	return result;
 }
 
+/*
+ * An entry in the ring of commands in flight for a queued block transfer - either a run of
+ * AP_DRW accesses, or (when blocks is 0) a DAP_Transfer moving AP_TAR on past a 1KiB boundary.
+ */
+typedef struct dap_queued_block {
+	uint32_t addr;
+	size_t offset;
+	size_t blocks;
+
+	union {
+		dap_transfer_response_s tar;
+		dap_transfer_block_response_read_s read;
+		dap_transfer_block_response_write_s write;
+	} response;
+} dap_queued_block_s;
+
+static dap_queued_block_s queued_blocks[USB_QUEUE_DEPTH_MAX];
+
+static bool dap_queue_tar_update(const adiv5_debug_port_s *const target_dp, dap_queued_block_s *const block)
+{
+	uint8_t request[8U] = {
+		DAP_TRANSFER,
+		target_dp->dev_index,
+		1U,
+		SWD_AP_TAR,
+	};
+	write_le4(request, 4U, block->addr);
+	return dap_queue_cmd(request, sizeof(request), &block->response.tar, 2U);
+}
+
+static bool dap_queue_block(const adiv5_debug_port_s *const target_dp, dap_queued_block_s *const block,
+	const void *const src, const align_e align)
+{
+	/* Reads are a straight DAP_TransferBlock request for the number of blocks wanted */
+	if (!src) {
+		dap_transfer_block_request_read_s request = {
+			DAP_TRANSFER_BLOCK,
+			target_dp->dev_index,
+			{},
+			SWD_AP_DRW | DAP_TRANSFER_RnW,
+		};
+		write_le2(request.block_count, 0, block->blocks);
+		return dap_queue_cmd(&request, sizeof(request), &block->response.read, 3U + (block->blocks * 4U));
+	}
+
+	/* Writes additionally carry the data, packed into the correct byte lanes for sub-word accesses */
+	dap_transfer_block_request_write_s request = {
+		DAP_TRANSFER_BLOCK,
+		target_dp->dev_index,
+		{},
+		SWD_AP_DRW & ~DAP_TRANSFER_RnW,
+	};
+	write_le2(request.block_count, 0, block->blocks);
+	if (align > ALIGN_HALFWORD)
+		memcpy(request.data, (const uint8_t *)src + block->offset, block->blocks * 4U);
+	else {
+		const void *data = (const uint8_t *)src + block->offset;
+		uint32_t dest = block->addr;
+		for (size_t i = 0; i < block->blocks; ++i) {
+			uint32_t value = 0;
+			data = adiv5_pack_data(dest, data, &value, align);
+			write_le4(request.data[i], 0, value);
+			dest += 1U << align;
+		}
+	}
+	return dap_queue_cmd(&request, 5U + (block->blocks * 4U), &block->response.write, sizeof(block->response.write));
+}
+
+static bool dap_queued_block_complete(
+	adiv5_debug_port_s *const target_dp, const dap_queued_block_s *const block, void *const dest, const align_e align)
+{
+	if (!block->blocks) {
+		if (block->response.tar.processed == 1U && block->response.tar.status == DAP_TRANSFER_OK)
+			return true;
+		target_dp->fault = block->response.tar.status;
+		return false;
+	}
+
+	/* The count and status fields are common to both the read and write responses */
+	const uint16_t blocks_done = read_le2(block->response.write.count, 0);
+	const uint8_t status = block->response.write.status;
+	if (blocks_done != block->blocks || status != DAP_TRANSFER_OK) {
+		target_dp->fault = status != DAP_TRANSFER_OK ? status : 0U;
+		DEBUG_PROBE("-> queued transfer failed with %u after processing %u blocks\n", status, blocks_done);
+		return false;
+	}
+
+	if (dest) {
+		uint8_t *const data = (uint8_t *)dest + block->offset;
+		if (align > ALIGN_HALFWORD)
+			memcpy(data, block->response.read.data, block->blocks * 4U);
+		else {
+			void *next = data;
+			uint32_t src = block->addr;
+			for (size_t i = 0; i < block->blocks; ++i) {
+				next = adiv5_unpack_data(next, src, read_le4(block->response.read.data[i], 0), align);
+				src += 1U << align;
+			}
+		}
+	}
+	return true;
+}
+
+/*
+ * Perform a block transfer as a stream of DAP_TransferBlock commands, keeping as many in flight
+ * as the adaptor says it can buffer so the link never sits idle waiting on a round trip.
+ * Exactly one of dest (for a read) or src (for a write) must be given. When packed, addr and len
+ * must be word aligned and each block carries a whole word's worth of align sized accesses.
+ */
+static bool dap_block_queued(adiv5_access_port_s *const target_ap, void *const dest, const void *const src,
+	const uint32_t addr, const size_t len, const align_e align, const bool packed, const size_t blocks_per_transfer)
+{
+	adiv5_debug_port_s *const target_dp = target_ap->dp;
+	const size_t depth = MIN(dap_queue_depth(), USB_QUEUE_DEPTH_MAX);
+	dap_ap_mem_access_setup(target_ap, addr, align, packed);
+	/* From here on, the alignment that describes how the data sits in each block */
+	const align_e data_align = packed ? ALIGN_WORD : align;
+	const uint8_t block_shift = MIN(data_align, ALIGN_WORD);
+
+	size_t offset = 0U;
+	size_t head = 0U;
+	size_t in_flight = 0U;
+	bool tar_valid = true;
+	bool result = true;
+	while (result && (offset < len || in_flight)) {
+		/* Top the queue up */
+		while (result && offset < len && in_flight < depth) {
+			dap_queued_block_s *const block = &queued_blocks[(head + in_flight) % depth];
+			block->addr = addr + offset;
+			block->offset = offset;
+			if (!tar_valid) {
+				/* AP_TAR only auto-increments within a 1KiB block, so it must be moved on to the next one */
+				block->blocks = 0U;
+				result = dap_queue_tar_update(target_dp, block);
+				tar_valid = true;
+			} else {
+				const size_t chunk_remaining = MIN(1024U - (block->addr & 0x3ffU), len - offset);
+				block->blocks = MIN(chunk_remaining >> block_shift, blocks_per_transfer);
+				result = dap_queue_block(target_dp, block, src, data_align);
+				const size_t transfer_length = block->blocks << block_shift;
+				offset += transfer_length;
+				tar_valid = ((block->addr + transfer_length) & 0x3ffU) != 0U;
+			}
+			if (result)
+				++in_flight;
+		}
+		if (!result || !in_flight)
+			break;
+
+		/* Then wait for the oldest command in it to complete */
+		const dap_queued_block_s *const block = &queued_blocks[head];
+		head = (head + 1U) % depth;
+		--in_flight;
+		result = dap_reap_cmd() && dap_queued_block_complete(target_dp, block, dest, data_align);
+	}
+
+	/*
+	 * If a response reported a failure, the commands behind it are still in flight, so drain them to get
+	 * the adaptor and the host back in step. When the link itself failed the queue has already been resynced.
+	 */
+	if (!result)
+		dap_drain_queue();
+	return result;
+}
+
+bool dap_read_block_queued(adiv5_access_port_s *const target_ap, void *const dest, const uint32_t src,
+	const size_t len, const align_e align, const bool packed, const size_t blocks_per_transfer)
+{
+	const bool result = dap_block_queued(target_ap, dest, NULL, src, len, align, packed, blocks_per_transfer);
+	if (!result)
+		DEBUG_ERROR("dap_read_block_queued failed\n");
+	return result;
+}
+
+bool dap_write_block_queued(adiv5_access_port_s *const target_ap, const uint32_t dest, const void *const src,
+	const size_t len, const align_e align, const bool packed, const size_t blocks_per_transfer)
+{
+	const bool result = dap_block_queued(target_ap, NULL, src, dest, len, align, packed, blocks_per_transfer);
+	if (!result)
+		DEBUG_ERROR("dap_write_block_queued failed\n");
+	return result;
+}
+
 void dap_reset_link(adiv5_debug_port_s *const target_dp)
 {
 	uint8_t sequence[18U];
@@ -332,9 +521,9 @@ void dap_reset_link(adiv5_debug_port_s *const target_dp)
 }
 
 static void mem_access_setup(const adiv5_access_port_s *const target_ap,
-	dap_transfer_request_s *const transfer_requests, const uint32_t addr, const align_e align)
+	dap_transfer_request_s *const transfer_requests, const uint32_t addr, const align_e align, const uint32_t addrinc)
 {
-	uint32_t csw = target_ap->csw | ADIV5_AP_CSW_ADDRINC_SINGLE;
+	uint32_t csw = target_ap->csw | addrinc;
 	switch (align) {
 	case ALIGN_BYTE:
 		csw |= ADIV5_AP_CSW_SIZE_BYTE;
@@ -358,11 +547,13 @@ static void mem_access_setup(const adiv5_access_port_s *const target_ap,
 	transfer_requests[2].data = addr;
 }
 
-void dap_ap_mem_access_setup(adiv5_access_port_s *const target_ap, const uint32_t addr, const align_e align)
+void dap_ap_mem_access_setup(
+	adiv5_access_port_s *const target_ap, const uint32_t addr, const align_e align, const bool packed)
 {
 	/* Start by setting up the transfer and attempting it */
 	dap_transfer_request_s requests[3];
-	mem_access_setup(target_ap, requests, addr, align);
+	mem_access_setup(
+		target_ap, requests, addr, align, packed ? ADIV5_AP_CSW_ADDRINC_PACKED : ADIV5_AP_CSW_ADDRINC_SINGLE);
 	adiv5_debug_port_s *const target_dp = target_ap->dp;
 	const bool result = perform_dap_transfer_recoverable(target_dp, requests, 3U, NULL, 0U);
 	/* If it didn't go well, say something and abort */
@@ -404,14 +595,15 @@ void dap_ap_write(adiv5_access_port_s *const target_ap, const uint16_t addr, con
 	requests[1].request = (addr & 0x0cU) | (addr & 0x100U ? DAP_TRANSFER_APnDP : 0);
 	requests[1].data = value;
 	adiv5_debug_port_s *const target_dp = target_ap->dp;
-	if (!perform_dap_transfer(target_dp, requests, 2U, NULL, 0U))
+	/* Nothing waits on the result of the write, so let it go out with whatever comes next */
+	if (!perform_dap_transfer_deferred(target_dp, requests, 2U))
 		DEBUG_ERROR("dap_ap_write failed (fault = %u)\n", target_dp->fault);
 }
 
 void dap_read_single(adiv5_access_port_s *const target_ap, void *const dest, const uint32_t src, const align_e align)
 {
 	dap_transfer_request_s requests[4];
-	mem_access_setup(target_ap, requests, src, align);
+	mem_access_setup(target_ap, requests, src, align, ADIV5_AP_CSW_ADDRINC_SINGLE);
 	requests[3].request = SWD_AP_DRW | DAP_TRANSFER_RnW;
 	uint32_t result;
 	adiv5_debug_port_s *target_dp = target_ap->dp;
@@ -428,11 +620,58 @@ void dap_write_single(
 	adiv5_access_port_s *const target_ap, const uint32_t dest, const void *const src, const align_e align)
 {
 	dap_transfer_request_s requests[4];
-	mem_access_setup(target_ap, requests, dest, align);
+	mem_access_setup(target_ap, requests, dest, align, ADIV5_AP_CSW_ADDRINC_SINGLE);
 	requests[3].request = SWD_AP_DRW;
 	/* Pack data into correct data lane */
 	adiv5_pack_data(dest, src, &requests[3].data, align);
 	adiv5_debug_port_s *target_dp = target_ap->dp;
-	if (!perform_dap_transfer_recoverable(target_dp, requests, 4U, NULL, 0U))
+	/*
+	 * Defer the write so it shares a packet with the next access - typically a status register read
+	 * when polling flash, which also then gets to skip the SELECT and CSW writes if they're unchanged
+	 */
+	if (!perform_dap_transfer_deferred(target_dp, requests, 4U))
 		DEBUG_ERROR("dap_write_single failed (fault = %u)\n", target_dp->fault);
 }
+
+/*
+ * Poll a 32-bit memory location using DAP_Transfer match reads, so the adaptor re-reads it
+ * (up to its configured match retry count) without a round trip to the host each time.
+ */
+bool dap_mem32_wait(adiv5_access_port_s *const target_ap, const uint32_t addr, const uint32_t mask,
+	const uint32_t match, const uint32_t timeout_ms, uint32_t *const value)
+{
+	adiv5_debug_port_s *const target_dp = target_ap->dp;
+	dap_transfer_request_s requests[6];
+	/* Point TAR at the location with auto-increment off so every DRW read is of the same word */
+	mem_access_setup(target_ap, requests, addr, ALIGN_WORD, ADIV5_AP_CSW_ADDRINC_NONE);
+	/* Load the match mask, then read DRW until it matches */
+	requests[3].request = DAP_TRANSFER_MATCH_MASK;
+	requests[3].data = mask;
+	requests[4].request = SWD_AP_DRW | DAP_TRANSFER_RnW | DAP_TRANSFER_MATCH_VALUE;
+	requests[4].data = match;
+	/* Match reads return no data, so follow up with a plain read to get the full value that matched */
+	requests[5].request = SWD_AP_DRW | DAP_TRANSFER_RnW;
+
+	platform_timeout_s timeout;
+	platform_timeout_set(&timeout, timeout_ms);
+	uint32_t result = 0U;
+	bool matched = false;
+	while (true) {
+		matched = perform_dap_transfer(target_dp, requests, 6U, &result, 1U);
+		if (matched || !(target_dp->fault & DAP_TRANSFER_MISMATCH)) {
+			if (!matched)
+				DEBUG_ERROR("dap_mem32_wait failed (fault = %u)\n", target_dp->fault);
+			break;
+		}
+		/* The adaptor ran out of match retries, which isn't a fault - clear it and go again if we have time */
+		target_dp->fault = 0U;
+		if (platform_timeout_is_expired(&timeout)) {
+			/* Pick up the current value so the caller can see what it was stuck on */
+			dap_read_single(target_ap, &result, addr, ALIGN_WORD);
+			break;
+		}
+	}
+	if (value)
+		*value = result;
+	return matched;
+}
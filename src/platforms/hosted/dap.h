@@ -81,12 +81,23 @@ void dap_write_reg(adiv5_debug_port_s *target_dp, uint8_t reg, uint32_t data);
 void dap_reset_link(adiv5_debug_port_s *target_dp);
 bool dap_read_block(adiv5_access_port_s *target_ap, void *dest, uint32_t src, size_t len, align_e align);
 bool dap_write_block(adiv5_access_port_s *target_ap, uint32_t dest, const void *src, size_t len, align_e align);
-void dap_ap_mem_access_setup(adiv5_access_port_s *target_ap, uint32_t addr, align_e align);
+bool dap_read_block_queued(adiv5_access_port_s *target_ap, void *dest, uint32_t src, size_t len, align_e align,
+	bool packed, size_t blocks_per_transfer);
+bool dap_write_block_queued(adiv5_access_port_s *target_ap, uint32_t dest, const void *src, size_t len,
+	align_e align, bool packed, size_t blocks_per_transfer);
+void dap_ap_mem_access_setup(adiv5_access_port_s *target_ap, uint32_t addr, align_e align, bool packed);
 uint32_t dap_ap_read(adiv5_access_port_s *target_ap, uint16_t addr);
 void dap_ap_write(adiv5_access_port_s *target_ap, uint16_t addr, uint32_t value);
 void dap_read_single(adiv5_access_port_s *target_ap, void *dest, uint32_t src, align_e align);
 void dap_write_single(adiv5_access_port_s *target_ap, uint32_t dest, const void *src, align_e align);
+bool dap_mem32_wait(
+	adiv5_access_port_s *target_ap, uint32_t addr, uint32_t mask, uint32_t match, uint32_t timeout_ms, uint32_t *value);
+size_t dap_packet_size(void);
 bool dap_run_cmd(const void *request_data, size_t request_length, void *response_data, size_t response_length);
+size_t dap_queue_depth(void);
+bool dap_queue_cmd(const void *request_data, size_t request_length, void *response_data, size_t response_length);
+bool dap_reap_cmd(void);
+void dap_drain_queue(void);
 bool dap_jtag_configure(void);
 
 void dap_dp_abort(adiv5_debug_port_s *target_dp, uint32_t abort);
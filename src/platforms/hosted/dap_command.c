@@ -60,53 +60,312 @@ static size_t dap_encode_transfer(
 	return 5U;
 }
 
-bool perform_dap_transfer(adiv5_debug_port_s *const target_dp, const dap_transfer_request_s *const transfer_requests,
-	const size_t requests, uint32_t *const response_data, const size_t responses)
+/* Largest DAP command we will build, matching the CMSIS-DAP driver's own buffer */
+#define DAP_TRANSFER_MAX_LENGTH 1024U
+/* Every deferred request is a write, which encodes to the request byte and 4 bytes of data */
+#define DAP_TRANSFER_WRITE_LENGTH 5U
+
+/*
+ * DAP_Transfer builder state. AP writes nothing is waiting on are deferred and go out at the
+ * front of the next DAP_Transfer, and the last DP SELECT and AP CSW values written are tracked
+ * so that rewriting them with the same value can be skipped. Deferred writes stay here until
+ * the adaptor has carried them out, so they can be sent again if the transfer has to be retried.
+ */
+typedef struct dap_transfer_state {
+	uint8_t dev_index;
+	/* The DP the deferred writes are for, so a failed flush of them can be recovered */
+	adiv5_debug_port_s *deferred_dp;
+	size_t deferred_count;
+	uint8_t deferred[DAP_TRANSFER_MAX_LENGTH];
+	bool select_valid;
+	uint32_t select;
+	bool csw_valid;
+	uint32_t csw_select;
+	uint32_t csw;
+} dap_transfer_state_s;
+
+static dap_transfer_state_s transfer_state;
+
+static void dap_transfer_invalidate(void)
+{
+	transfer_state.select_valid = false;
+	transfer_state.csw_valid = false;
+}
+
+/* Check whether a request would only rewrite a value SELECT or CSW is already known to hold, tracking it if not */
+static bool dap_transfer_is_redundant(const dap_transfer_request_s *const transfer)
 {
-	/* Validate that the number of requests this transfer is valid. We artificially limit it to 12 (from 256) */
-	if (!requests || requests > 12 || (responses && !response_data))
+	const uint8_t kind =
+		transfer->request & (DAP_TRANSFER_APnDP | DAP_TRANSFER_RnW | DAP_TRANSFER_A2 | DAP_TRANSFER_A3);
+	/* DP register 0x8 writes are to SELECT */
+	if (kind == DAP_TRANSFER_A3) {
+		if (transfer_state.select_valid && transfer_state.select == transfer->data)
+			return true;
+		transfer_state.select = transfer->data;
+		transfer_state.select_valid = true;
 		return false;
+	}
+	/* AP register 0x0 writes are to CSW when bank 0 is selected */
+	if (kind == DAP_TRANSFER_APnDP) {
+		if (!transfer_state.select_valid) {
+			transfer_state.csw_valid = false;
+			return false;
+		}
+		if (transfer_state.select & 0xf0U)
+			return false;
+		if (transfer_state.csw_valid && transfer_state.csw_select == transfer_state.select &&
+			transfer_state.csw == transfer->data)
+			return true;
+		transfer_state.csw = transfer->data;
+		transfer_state.csw_select = transfer_state.select;
+		transfer_state.csw_valid = true;
+	}
+	return false;
+}
+
+static bool dap_transfer_fits(const size_t length, const size_t requests, const size_t responses)
+{
+	const size_t packet_size = MIN(dap_packet_size(), DAP_TRANSFER_MAX_LENGTH);
+	return requests <= UINT8_MAX && 3U + length <= packet_size && 2U + (responses * 4U) <= packet_size;
+}
+
+/* Drop the first count deferred writes, once the adaptor has carried them out */
+static void dap_deferred_consume(size_t count)
+{
+	count = MIN(count, transfer_state.deferred_count);
+	const size_t consumed = count * DAP_TRANSFER_WRITE_LENGTH;
+	const size_t remaining = (transfer_state.deferred_count - count) * DAP_TRANSFER_WRITE_LENGTH;
+	memmove(transfer_state.deferred, transfer_state.deferred + consumed, remaining);
+	transfer_state.deferred_count -= count;
+	if (!transfer_state.deferred_count)
+		transfer_state.deferred_dp = NULL;
+}
+
+/*
+ * Give up on the deferred writes still waiting, reporting the failure against the first of them,
+ * which is the one the adaptor stopped at. The rest were never carried out.
+ */
+static void dap_deferred_drop(const uint8_t status)
+{
+	if (!transfer_state.deferred_count)
+		return;
+	const uint8_t *const write = transfer_state.deferred;
+	const uint8_t reg = write[0] & (DAP_TRANSFER_A2 | DAP_TRANSFER_A3);
+	DEBUG_WARN("Deferred %s write of 0x%08" PRIx32 " to register %02x failed with %u, dropping %zu writes\n",
+		(write[0] & DAP_TRANSFER_APnDP) ? "AP" : "DP", read_le4(write, 1), reg, status, transfer_state.deferred_count);
+	dap_deferred_consume(transfer_state.deferred_count);
+}
+
+/*
+ * Run one DAP_Transfer made up of any deferred writes followed by the already encoded transfers.
+ * On success the deferred writes are all done with. On failure, those the adaptor got through
+ * are dropped and the rest are left in place to either be retried or dropped by the caller.
+ */
+static bool dap_transfer_send(adiv5_debug_port_s *const target_dp, const uint8_t *const transfers,
+	const size_t transfers_length, const size_t count, uint32_t *const response_data, const size_t responses)
+{
+	const size_t deferred = transfer_state.deferred_count;
+	const size_t deferred_length = deferred * DAP_TRANSFER_WRITE_LENGTH;
+	if (!count && !deferred)
+		return true;
 
-	DEBUG_PROBE("-> dap_transfer (%zu requests)\n", requests);
-	/* 63 is 3 + (12 * 5) where 5 is the max length of each transfer request */
-	uint8_t request[63] = {
+	DEBUG_PROBE("-> dap_transfer (%zu requests, %zu deferred)\n", count, deferred);
+	uint8_t request[DAP_TRANSFER_MAX_LENGTH] = {
 		DAP_TRANSFER,
-		target_dp->dev_index,
-		requests,
+		transfer_state.dev_index,
+		deferred + count,
 	};
-	/* Encode the transfers into the buffer and detect if we're doing any reads */
-	size_t offset = 3U;
-	for (size_t i = 0; i < requests; ++i)
-		offset += dap_encode_transfer(&transfer_requests[i], request, offset);
-
-	dap_transfer_response_s response;
-	/* Run the request */
-	if (!dap_run_cmd(request, offset, &response, 2U + (responses * 4U)))
+	memcpy(request + 3U, transfer_state.deferred, deferred_length);
+	if (count)
+		memcpy(request + 3U + deferred_length, transfers, transfers_length);
+	const size_t length = 3U + deferred_length + transfers_length;
+
+	dap_transfer_response_s response = {};
+	/* Run the request, and if the link failed then we can't know what happened so keep the deferred writes */
+	if (!dap_run_cmd(request, length, &response, 2U + (responses * 4U))) {
+		dap_transfer_invalidate();
 		return false;
+	}
 
 	/* Look at the response and decipher what went on */
-	if (response.processed == requests && response.status == DAP_TRANSFER_OK) {
+	if (response.processed == deferred + count && response.status == DAP_TRANSFER_OK) {
+		dap_deferred_consume(deferred);
 		for (size_t i = 0; i < responses; ++i)
 			response_data[i] = read_le4(response.data[i], 0);
 		return true;
 	}
+	dap_transfer_invalidate();
 	target_dp->fault = response.status;
-
-	DEBUG_PROBE("-> transfer failed with %u after processing %u requests\n", response.status, response.processed);
+	dap_deferred_consume(response.processed);
+	if (response.processed < deferred)
+		DEBUG_PROBE("-> deferred AP writes failed with %u after processing %u of %zu\n", response.status,
+			response.processed, deferred);
+	else
+		DEBUG_PROBE("-> transfer failed with %u after processing %u requests\n", response.status,
+			response.processed);
 	return false;
 }
 
+static bool dap_transfer_flush_deferred(void);
+
+/*
+ * Clear the error a NO_RESPONSE left behind, holding back any deferred writes that didn't make it
+ * while that's done (so they don't get sent ahead of the DP's error handling), then put them back
+ * to go out first on the retry.
+ */
+static void dap_transfer_recover(adiv5_debug_port_s *const target_dp)
+{
+	const size_t held_count = transfer_state.deferred_count;
+	adiv5_debug_port_s *const held_dp = transfer_state.deferred_dp;
+	uint8_t held[DAP_TRANSFER_MAX_LENGTH];
+	memcpy(held, transfer_state.deferred, held_count * DAP_TRANSFER_WRITE_LENGTH);
+	transfer_state.deferred_count = 0U;
+	transfer_state.deferred_dp = NULL;
+
+	target_dp->error(target_dp, true);
+
+	/* Nothing in error handling defers writes, but if something did, send it on its way first */
+	dap_transfer_flush_deferred();
+	memcpy(transfer_state.deferred, held, held_count * DAP_TRANSFER_WRITE_LENGTH);
+	transfer_state.deferred_count = held_count;
+	transfer_state.deferred_dp = held_dp;
+}
+
+/* Send the deferred writes on their own, recovering from a NO_RESPONSE once, as a recoverable transfer would */
+static bool dap_transfer_flush_deferred(void)
+{
+	adiv5_debug_port_s *const target_dp = transfer_state.deferred_dp;
+	if (!transfer_state.deferred_count)
+		return true;
+	bool result = dap_transfer_send(target_dp, NULL, 0U, 0U, NULL, 0U);
+	if (!result && target_dp->fault == DAP_TRANSFER_NO_RESPONSE) {
+		dap_transfer_recover(target_dp);
+		result = dap_transfer_send(target_dp, NULL, 0U, 0U, NULL, 0U);
+	}
+	if (!result)
+		dap_deferred_drop(target_dp->fault);
+	return result;
+}
+
+/* Deferred writes and the SELECT/CSW tracking belong to one DP, so switch them over if the DP changes */
+static void dap_transfer_select_dp(const adiv5_debug_port_s *const target_dp)
+{
+	if (target_dp->dev_index == transfer_state.dev_index)
+		return;
+	dap_transfer_flush_deferred();
+	dap_transfer_invalidate();
+	transfer_state.dev_index = target_dp->dev_index;
+}
+
+/*
+ * Encode and run a set of transfers, with any deferred writes at the front. Anything deferred
+ * that doesn't get carried out is left for the caller to retry or drop.
+ */
+static bool dap_transfer_run(adiv5_debug_port_s *const target_dp, const dap_transfer_request_s *const transfer_requests,
+	const size_t requests, uint32_t *const response_data, const size_t responses)
+{
+	dap_transfer_select_dp(target_dp);
+
+	/* Encode the transfers, skipping any that would rewrite SELECT or CSW with the value it already has */
+	uint8_t transfers[DAP_TRANSFER_MAX_LENGTH];
+	size_t length = 0U;
+	size_t count = 0U;
+	for (size_t i = 0; i < requests; ++i) {
+		if (dap_transfer_is_redundant(&transfer_requests[i]))
+			continue;
+		if (!dap_transfer_fits(length + 5U, count + 1U, responses)) {
+			DEBUG_ERROR("dap_transfer of %zu requests does not fit in a packet\n", requests);
+			dap_transfer_invalidate();
+			return false;
+		}
+		length += dap_encode_transfer(&transfer_requests[i], transfers, length);
+		++count;
+	}
+
+	/* Deferred writes go out at the front of this transfer, unless the two together are too big for one packet */
+	const size_t deferred = transfer_state.deferred_count;
+	if (!dap_transfer_fits((deferred * DAP_TRANSFER_WRITE_LENGTH) + length, deferred + count, responses) &&
+		!dap_transfer_flush_deferred())
+		return false;
+	return dap_transfer_send(target_dp, transfers, length, count, response_data, responses);
+}
+
+bool perform_dap_transfer(adiv5_debug_port_s *const target_dp, const dap_transfer_request_s *const transfer_requests,
+	const size_t requests, uint32_t *const response_data, const size_t responses)
+{
+	if (!requests || (responses && !response_data))
+		return false;
+	bool result = dap_transfer_run(target_dp, transfer_requests, requests, response_data, responses);
+	/*
+	 * If it was deferred writes at the front that failed, none of the requests got run. Give the writes the
+	 * same single NO_RESPONSE recovery they'd have got from perform_dap_transfer_recoverable() before they
+	 * were deferred, then try again.
+	 */
+	if (!result && transfer_state.deferred_count && target_dp->fault == DAP_TRANSFER_NO_RESPONSE) {
+		dap_transfer_recover(target_dp);
+		result = dap_transfer_run(target_dp, transfer_requests, requests, response_data, responses);
+	}
+	if (!result)
+		dap_deferred_drop(target_dp->fault);
+	return result;
+}
+
+/*
+ * Queue AP writes to go out with the next DAP_Transfer (or other command), rather than costing
+ * a round trip each. Only writes may be deferred, as nothing can wait on a deferred result.
+ */
+bool perform_dap_transfer_deferred(
+	adiv5_debug_port_s *const target_dp, const dap_transfer_request_s *const transfer_requests, const size_t requests)
+{
+	for (size_t i = 0; i < requests; ++i) {
+		if (transfer_requests[i].request & DAP_TRANSFER_RnW)
+			return false;
+	}
+	dap_transfer_select_dp(target_dp);
+
+	for (size_t i = 0; i < requests; ++i) {
+		const dap_transfer_request_s *const transfer = &transfer_requests[i];
+		if (dap_transfer_is_redundant(transfer))
+			continue;
+		const size_t deferred = transfer_state.deferred_count;
+		if (!dap_transfer_fits((deferred + 1U) * DAP_TRANSFER_WRITE_LENGTH, deferred + 1U, 0U) &&
+			!dap_transfer_flush_deferred())
+			return false;
+		dap_encode_transfer(
+			transfer, transfer_state.deferred, transfer_state.deferred_count * DAP_TRANSFER_WRITE_LENGTH);
+		++transfer_state.deferred_count;
+		transfer_state.deferred_dp = target_dp;
+	}
+	return true;
+}
+
+/*
+ * Send any deferred writes on their own. If another kind of command is about to be run that could
+ * change the DP or AP state behind our backs, invalidate should be set so SELECT and CSW get rewritten.
+ */
+bool perform_dap_transfer_flush(const bool invalidate)
+{
+	const bool result = dap_transfer_flush_deferred();
+	if (invalidate)
+		dap_transfer_invalidate();
+	return result;
+}
+
 bool perform_dap_transfer_recoverable(adiv5_debug_port_s *const target_dp,
 	const dap_transfer_request_s *const transfer_requests, const size_t requests, uint32_t *const response_data,
 	const size_t responses)
 {
-	const bool result = perform_dap_transfer(target_dp, transfer_requests, requests, response_data, responses);
-	/* If all went well, or we can't recover, we get to early return */
-	if (result || target_dp->fault != DAP_TRANSFER_NO_RESPONSE)
-		return result;
-	/* Otherwise clear the error and try again as our best and final answer */
-	target_dp->error(target_dp, true);
-	return perform_dap_transfer(target_dp, transfer_requests, requests, response_data, responses);
+	if (!requests || (responses && !response_data))
+		return false;
+	bool result = dap_transfer_run(target_dp, transfer_requests, requests, response_data, responses);
+	/* If things went wrong in a way we can recover from, clear the error and try again as our best and final answer */
+	if (!result && target_dp->fault == DAP_TRANSFER_NO_RESPONSE) {
+		dap_transfer_recover(target_dp);
+		result = dap_transfer_run(target_dp, transfer_requests, requests, response_data, responses);
+	}
+	if (!result)
+		dap_deferred_drop(target_dp->fault);
+	return result;
 }
 
 bool perform_dap_transfer_block_read(
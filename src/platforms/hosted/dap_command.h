@@ -72,6 +72,8 @@ typedef enum dap_transfer_status {
 	DAP_TRANSFER_WAIT = 0x02U,
 	DAP_TRANSFER_FAULT = 0x04U,
 	DAP_TRANSFER_NO_RESPONSE = 0x07U,
+	/* Set alongside the ACK when a match read ran out of retries without matching */
+	DAP_TRANSFER_MISMATCH = 0x10U,
 } dap_transfer_status_e;
 
 typedef enum dap_info_status {
@@ -99,7 +101,7 @@ typedef struct dap_transfer_request {
 typedef struct dap_transfer_response {
 	uint8_t processed;
 	uint8_t status;
-	uint8_t data[12][4];
+	uint8_t data[255][4];
 } dap_transfer_response_s;
 
 typedef struct dap_transfer_block_request_read {
@@ -145,6 +147,9 @@ bool perform_dap_transfer(adiv5_debug_port_s *target_dp, const dap_transfer_requ
 	size_t requests, uint32_t *response_data, size_t responses);
 bool perform_dap_transfer_recoverable(adiv5_debug_port_s *target_dp, const dap_transfer_request_s *transfer_requests,
 	size_t requests, uint32_t *response_data, size_t responses);
+bool perform_dap_transfer_deferred(
+	adiv5_debug_port_s *target_dp, const dap_transfer_request_s *transfer_requests, size_t requests);
+bool perform_dap_transfer_flush(bool invalidate);
 bool perform_dap_transfer_block_read(
 	adiv5_debug_port_s *target_dp, uint8_t reg, uint16_t block_count, uint32_t *blocks);
 bool perform_dap_transfer_block_write(
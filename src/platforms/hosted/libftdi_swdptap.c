@@ -31,6 +31,7 @@
 
 #include <ftdi.h>
 #include "ftdi_bmp.h"
+#include "adiv5.h"
 
 typedef enum swdio_status {
 	SWDIO_STATUS_DRIVE,
@@ -50,6 +51,7 @@ static bool ftdi_swd_seq_in_parity(uint32_t *res, size_t clock_cycles);
 static uint32_t ftdi_swd_seq_in(size_t clock_cycles);
 static void ftdi_swd_seq_out(uint32_t tms_states, size_t clock_cycles);
 static void ftdi_swd_seq_out_parity(uint32_t tms_states, size_t clock_cycles);
+static uint8_t ftdi_swd_transfer(uint8_t request, uint32_t *data, bool *parity_error, uint8_t idle_cycles);
 
 bool ftdi_swd_possible(void)
 {
@@ -122,6 +124,7 @@ bool ftdi_swd_init(void)
 	swd_proc.seq_in_parity = ftdi_swd_seq_in_parity;
 	swd_proc.seq_out = ftdi_swd_seq_out;
 	swd_proc.seq_out_parity = ftdi_swd_seq_out_parity;
+	swd_proc.transfer = ftdi_swd_transfer;
 	return true;
 }
 
@@ -444,3 +447,26 @@ static void ftdi_swd_seq_out_parity(uint32_t tms_states, size_t clock_cycles)
 	else
 		ftdi_swd_seq_out_parity_raw(tms_states, parity, clock_cycles);
 }
+
+/*
+ * The data phase can only be clocked once the ACK is known to be OK, so reads still take two trips
+ * over USB - one for the ACK and one for the data. Writes only need the one for the ACK, with the
+ * data phase left queued to go out with whatever comes next. ftdi_swd_seq_out_parity() always
+ * clocks 8 idle cycles to complete the write, so a policy asking for fewer still gets those 8.
+ */
+static uint8_t ftdi_swd_transfer(
+	const uint8_t request, uint32_t *const data, bool *const parity_error, const uint8_t idle_cycles)
+{
+	ftdi_swd_seq_out(request, 8U);
+	const uint8_t ack = ftdi_swd_seq_in(3U);
+	if (ack != SWDP_ACK_OK)
+		return ack;
+	if (request & SWDP_REQUEST_RnW)
+		*parity_error = ftdi_swd_seq_in_parity(data, 32U);
+	else {
+		ftdi_swd_seq_out_parity(*data, 32U);
+		if (idle_cycles > 8U)
+			ftdi_swd_seq_out(0U, idle_cycles - 8U);
+	}
+	return ack;
+}
@@ -30,6 +30,7 @@
 #include "cli.h"
 #include "gdb_if.h"
 #include "gdb_packet.h"
+#include "gdb_main.h"
 #include <signal.h>
 
 #ifdef ENABLE_RTT
@@ -129,6 +130,9 @@ void platform_init(int argc, char **argv)
 	if (cl_opts.opt_mode != BMP_MODE_DEBUG)
 		exit(cl_execute(&cl_opts));
 	else {
+		/* Fast polling means never backing off from polling the target for halts */
+		if (cl_opts.fast_poll)
+			gdb_poll_max_interval_ms = 0U;
 		gdb_if_init();
 
 #ifdef ENABLE_RTT
@@ -475,17 +479,14 @@ void platform_buffer_flush(void)
 	case BMP_TYPE_LIBFTDI:
 		return libftdi_buffer_flush();
 
+	case BMP_TYPE_CMSIS_DAP:
+		return dap_buffer_flush();
+
 	default:
 		break;
 	}
 }
 
-void platform_pace_poll(void)
-{
-	if (!cl_opts.fast_poll)
-		platform_delay(8);
-}
-
 void platform_target_clk_output_enable(const bool enable)
 {
 	switch (info.bmp_type) {
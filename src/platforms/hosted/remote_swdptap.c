@@ -36,6 +36,7 @@ static bool remote_swd_seq_in_parity(uint32_t *res, size_t clock_cycles);
 static uint32_t remote_swd_seq_in(size_t clock_cycles);
 static void remote_swd_seq_out(uint32_t tms_states, size_t clock_cycles);
 static void remote_swd_seq_out_parity(uint32_t tms_states, size_t clock_cycles);
+static uint8_t remote_swd_transfer(uint8_t request, uint32_t *data, bool *parity_error, uint8_t idle_cycles);
 
 bool remote_swdptap_init(void)
 {
@@ -53,6 +54,8 @@ bool remote_swdptap_init(void)
 	swd_proc.seq_in_parity = remote_swd_seq_in_parity;
 	swd_proc.seq_out = remote_swd_seq_out;
 	swd_proc.seq_out_parity = remote_swd_seq_out_parity;
+	/* Version 7 and newer firmware can do a whole transfer in one request rather than 3 or 4 */
+	swd_proc.transfer = remote_protocol_version() >= 7U ? remote_swd_transfer : NULL;
 	return true;
 }
 
@@ -121,3 +124,28 @@ static void remote_swd_seq_out_parity(uint32_t tms_states, size_t clock_cycles)
 		exit(-1);
 	}
 }
+
+static uint8_t remote_swd_transfer(
+	const uint8_t request, uint32_t *const data, bool *const parity_error, const uint8_t idle_cycles)
+{
+	char buffer[REMOTE_MAX_MSG_SIZE];
+
+	int length = sprintf(buffer, REMOTE_SWDP_TRANSFER_STR, request, *data, idle_cycles);
+	platform_buffer_write(buffer, length);
+
+	length = platform_buffer_read(buffer, REMOTE_MAX_MSG_SIZE);
+	if (length < 2 || buffer[0] == REMOTE_RESP_ERR) {
+		DEBUG_ERROR("%s failed, error %s\n", __func__, length ? buffer + 1 : "short response");
+		exit(-1);
+	}
+
+	const uint64_t response = remote_hex_string_to_num(-1, buffer + 1);
+	const uint8_t ack = (response >> 32U) & 7U;
+	if (request & SWDP_REQUEST_RnW) {
+		*data = (uint32_t)response;
+		*parity_error = buffer[0] == REMOTE_RESP_PARERR;
+	}
+	DEBUG_PROBE("%s %02x: ack %u, %08" PRIx32 " %s\n", __func__, request, ack, (uint32_t)response,
+		buffer[0] != REMOTE_RESP_OK ? "ERR" : "OK");
+	return ack;
+}
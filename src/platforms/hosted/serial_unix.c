@@ -34,6 +34,17 @@
 
 static int fd; /* File descriptor for connection to GDB remote */
 
+/*
+ * Responses from the probe are read from the OS in as large chunks as are available,
+ * and then framed out of this buffer. Anything left over after a response's end-of-message
+ * byte is kept here for the next call to platform_buffer_read().
+ */
+#define READ_BUFFER_LENGTH 4096U
+
+static char read_buffer[READ_BUFFER_LENGTH];
+static size_t read_buffer_fullness = 0U;
+static size_t read_buffer_offset = 0U;
+
 /* A nice routine grabbed from
  * https://stackoverflow.com/questions/6947413/how-to-open-read-and-write-from-serial-port-in-c
  */
@@ -57,6 +68,8 @@ static int set_interface_attribs(void)
 	tty.c_cc[VTIME] = 5; // 0.5 seconds read timeout
 
 	tty.c_iflag &= ~(IXON | IXOFF | IXANY); // shut off xon/xoff ctrl
+	// don't mangle CR/LF or strip the top bit as the remote protocol carries binary payloads
+	tty.c_iflag &= ~(ISTRIP | INLCR | IGNCR | ICRNL);
 
 	tty.c_cflag |= (CLOCAL | CREAD); // ignore modem controls,
 	// enable reading
@@ -203,6 +216,8 @@ int serial_open(const bmda_cli_options_s *const cl_opts, const char *const seria
 void serial_close(void)
 {
 	close(fd);
+	read_buffer_offset = 0U;
+	read_buffer_fullness = 0U;
 }
 
 bool platform_buffer_write(const void *const data, const size_t length)
@@ -217,63 +232,93 @@ bool platform_buffer_write(const void *const data, const size_t length)
 	return (size_t)written == length;
 }
 
+/*
+ * Refill the read buffer with as much as the OS has available for us, waiting at most
+ * the remaining timeout for it to become readable.
+ * Returns a negative value on error, 0 on timeout or the number of bytes now buffered.
+ */
+static ssize_t read_buffer_refill(timeval_s *const timeout)
+{
+	fd_set select_set;
+	FD_ZERO(&select_set);
+	FD_SET(fd, &select_set);
+
+	const int result = select(FD_SETSIZE, &select_set, NULL, NULL, timeout);
+	if (result < 0) {
+		DEBUG_ERROR("Failed on select\n");
+		return -1;
+	}
+	if (result == 0)
+		return 0;
+
+	const ssize_t bytes_received = read(fd, read_buffer, READ_BUFFER_LENGTH);
+	if (bytes_received <= 0) {
+		const int error = errno;
+		DEBUG_ERROR("Failed to read response (%d): %s\n", error, strerror(error));
+		return -1;
+	}
+	read_buffer_offset = 0U;
+	read_buffer_fullness = (size_t)bytes_received;
+	return bytes_received;
+}
+
 /* XXX: We should either return size_t or bool */
-/* XXX: This needs documenting that it can abort the program with exit(), or the error handling fixed */
-int platform_buffer_read(void *const data, size_t length)
+int platform_buffer_read(void *const data, const size_t length)
 {
-	char response = 0;
 	timeval_s timeout = {
 		.tv_sec = cortexm_wait_timeout / 1000U,
 		.tv_usec = 1000U * (cortexm_wait_timeout % 1000U),
 	};
 
 	/* Drain the buffer for the remote till we see a start-of-response byte */
-	while (response != REMOTE_RESP) {
-		fd_set select_set;
-		FD_ZERO(&select_set);
-		FD_SET(fd, &select_set);
-
-		const int result = select(FD_SETSIZE, &select_set, NULL, NULL, &timeout);
-		if (result < 0) {
-			DEBUG_ERROR("Failed on select\n");
-			return -3;
-		}
-		if (result == 0) {
-			DEBUG_ERROR("Timeout while waiting for BMP response\n");
-			return -4;
+	while (true) {
+		if (read_buffer_offset == read_buffer_fullness) {
+			const ssize_t result = read_buffer_refill(&timeout);
+			if (result < 0)
+				return -3;
+			if (result == 0) {
+				DEBUG_ERROR("Timeout while waiting for BMP response\n");
+				return -4;
+			}
 		}
-		if (read(fd, &response, 1) != 1) {
-			const int error = errno;
-			DEBUG_ERROR("Failed to read response (%d): %s\n", error, strerror(error));
-			return -6;
+		const char *const buffer = read_buffer + read_buffer_offset;
+		const char *const response_begin = memchr(buffer, REMOTE_RESP, read_buffer_fullness - read_buffer_offset);
+		/* If we didn't find the start-of-response byte, discard everything and go again */
+		if (!response_begin) {
+			read_buffer_offset = read_buffer_fullness;
+			continue;
 		}
+		read_buffer_offset += (size_t)(response_begin - buffer) + 1U;
+		break;
 	}
-	/* Now collect the response */
+
+	char *const buffer = (char *)data;
+	/* Now collect the response, copying as much as we can out of the read buffer in one go */
 	for (size_t offset = 0; offset < length;) {
-		fd_set select_set;
-		FD_ZERO(&select_set);
-		FD_SET(fd, &select_set);
-		const int result = select(FD_SETSIZE, &select_set, NULL, NULL, &timeout);
-		if (result < 0) {
-			DEBUG_ERROR("Failed on select\n");
-			exit(-4);
-		}
-		if (result == 0) {
-			DEBUG_ERROR("Timeout on read\n");
-			return -5;
-		}
-		if (read(fd, data + offset, 1) != 1) {
-			const int error = errno;
-			DEBUG_ERROR("Failed to read response (%d): %s\n", error, strerror(error));
-			return -6;
+		if (read_buffer_offset == read_buffer_fullness) {
+			const ssize_t result = read_buffer_refill(&timeout);
+			if (result < 0)
+				return -6;
+			if (result == 0) {
+				DEBUG_ERROR("Timeout on read\n");
+				return -5;
+			}
 		}
-		char *const buffer = (char *)data;
-		if (buffer[offset] == REMOTE_EOM) {
-			buffer[offset] = 0;
+		const char *const chunk = read_buffer + read_buffer_offset;
+		/* The end-of-message byte must land inside the caller's buffer, so bound the search by that */
+		const size_t chunk_length = MIN(read_buffer_fullness - read_buffer_offset, length - offset);
+		const char *const response_end = memchr(chunk, REMOTE_EOM, chunk_length);
+		const size_t copy_length = response_end ? (size_t)(response_end - chunk) : chunk_length;
+		memcpy(buffer + offset, chunk, copy_length);
+		offset += copy_length;
+		read_buffer_offset += copy_length;
+		if (response_end) {
+			/* Consume the end-of-message byte, leaving anything after it for the next call */
+			++read_buffer_offset;
+			buffer[offset] = '\0';
 			DEBUG_WIRE("       %s\n", buffer);
-			return offset;
+			return (int)offset;
 		}
-		++offset;
 	}
 
 	DEBUG_ERROR("Failed to read\n");
@@ -1066,6 +1066,7 @@ void stlink_adiv5_dp_defaults(adiv5_debug_port_s *dp)
 	dp->ap_read = stlink_ap_read;
 	dp->mem_read = stlink_mem_read;
 	dp->mem_write = stlink_mem_write;
+	dp->low_access_ap0_only = true;
 }
 
 uint32_t stlink_swdp_scan(void)
@@ -49,6 +49,8 @@ int vasprintf(char **strp, const char *const fmt, va_list ap)
 
 void platform_delay(uint32_t ms)
 {
+	/* Anything still buffered up for the target has to reach it before the wait starts, not after */
+	platform_buffer_flush();
 #if defined(_WIN32) && !defined(__MINGW32__)
 	Sleep(ms);
 #else
@@ -65,10 +65,14 @@ static inline uint16_t bmp_gpio_get(const uint32_t gpioport, const uint16_t gpio
 
 static inline void gpio_set_val(const uint32_t gpioport, const uint16_t gpios, const bool val)
 {
-	if (val)
-		gpio_set(gpioport, gpios);
-	else
-		gpio_clear(gpioport, gpios);
+	/* BSRR sets the pins given in its bottom half and resets those in its top half, so this needs no branch */
+	const uint32_t bsrr = (uint32_t)gpios << (val ? 0U : 16U);
+	/* NOLINTNEXTLINE(clang-diagnostic-int-to-pointer-cast) */
+	GPIO_BSRR(gpioport) = bsrr;
+#if defined(STM32F4) || defined(STM32F7)
+	/* NOLINTNEXTLINE(clang-diagnostic-int-to-pointer-cast) */
+	GPIO_BSRR(gpioport) = bsrr;
+#endif
 }
 
 #endif /* PLATFORMS_STM32_GPIO_H */
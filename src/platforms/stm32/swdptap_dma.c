@@ -0,0 +1,254 @@
+/*
+ * This file is part of the Black Magic Debug project.
+ *
+ * Copyright (C) 2023 1BitSquared <info@1bitsquared.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * This file implements the SW-DP interface by having a timer pace DMA transfers to and from the
+ * GPIO port rather than bit-banging it from the CPU. Each SWD clock cycle is two timer periods.
+ * At the start of each period, compare channel 1 has the output stream write the next word of a
+ * precomputed waveform to the port's BSRR, and half way through, compare channel 2 has the input
+ * stream sample the port's IDR. This gives jitter-free clocking independent of the CPU.
+ *
+ * It requires SWCLK and SWDIO to be on the same GPIO port, and a timer whose compare channels
+ * can trigger DMA streams that can reach that port (DMA2 on the STM32F4). The platform provides
+ * these as SWD_DMA_TIM, SWD_DMA_BUS, SWD_DMA_OUT_STREAM, SWD_DMA_IN_STREAM and SWD_DMA_TRG.
+ */
+
+#include "general.h"
+#include "timing.h"
+#include "swd.h"
+#include "swdptap_dma.h"
+#include "swdptap_dma_pack.h"
+
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/timer.h>
+#include <libopencm3/stm32/dma.h>
+
+#if !defined(SWDIO_IN_PORT)
+#define SWDIO_IN_PORT SWDIO_PORT
+#endif
+#if !defined(SWDIO_IN_PIN)
+#define SWDIO_IN_PIN SWDIO_PIN
+#endif
+
+/* The fewest timer ticks per period for which both DMA streams reliably keep up */
+#define SWD_DMA_MIN_PERIOD 8U
+#define SWD_DMA_MAX_PERIOD 65536U
+
+typedef enum swdio_status_e {
+	SWDIO_STATUS_FLOAT = 0,
+	SWDIO_STATUS_DRIVE
+} swdio_status_t;
+
+static const swd_dma_pins_s swd_dma_pins = {
+	.swclk = SWCLK_PIN,
+	.swdio = SWDIO_PIN,
+	.swdio_in = SWDIO_IN_PIN,
+};
+
+static uint32_t swd_dma_waveform[SWD_DMA_MAX_WORDS];
+static uint16_t swd_dma_samples[SWD_DMA_MAX_WORDS];
+static uint32_t swd_dma_period = SWD_DMA_MIN_PERIOD;
+static swdio_status_t swd_dma_dir = SWDIO_STATUS_FLOAT;
+static bool swd_dma_active = false;
+
+static uint32_t swd_dma_seq_in(size_t clock_cycles);
+static bool swd_dma_seq_in_parity(uint32_t *ret, size_t clock_cycles);
+static void swd_dma_seq_out(uint32_t tms_states, size_t clock_cycles);
+static void swd_dma_seq_out_parity(uint32_t tms_states, size_t clock_cycles);
+
+void swdptap_dma_init(void)
+{
+	SWD_DMA_TIM_CLK_EN();
+	rcc_periph_clock_enable(SWD_DMA_CLK);
+
+	timer_disable_counter(SWD_DMA_TIM);
+	timer_set_mode(SWD_DMA_TIM, TIM_CR1_CKD_CK_INT, TIM_CR1_CMS_EDGE, TIM_CR1_DIR_UP);
+	timer_set_prescaler(SWD_DMA_TIM, 0U);
+	/* The waveform is advanced as each period starts, and SWDIO sampled half way through */
+	timer_set_oc_value(SWD_DMA_TIM, TIM_OC1, 0U);
+
+	swd_proc.seq_in = swd_dma_seq_in;
+	swd_proc.seq_in_parity = swd_dma_seq_in_parity;
+	swd_proc.seq_out = swd_dma_seq_out;
+	swd_proc.seq_out_parity = swd_dma_seq_out_parity;
+	/* Transfers are done a sequence at a time, each needing its own run of the DMA streams anyway */
+	swd_proc.transfer = NULL;
+	swd_dma_active = true;
+}
+
+void swdptap_dma_deinit(void)
+{
+	swd_dma_active = false;
+}
+
+bool swdptap_dma_active(void)
+{
+	return swd_dma_active;
+}
+
+static uint32_t swd_dma_timer_frequency(void)
+{
+	/* The APB2 timers run at twice the bus clock if the bus is prescaled */
+	if (rcc_apb2_frequency == rcc_ahb_frequency)
+		return rcc_apb2_frequency;
+	return rcc_apb2_frequency * 2U;
+}
+
+void swdptap_dma_frequency_set(const uint32_t freq)
+{
+	/* Each SWD clock cycle takes two timer periods */
+	uint32_t period = freq ? (swd_dma_timer_frequency() / 2U) / freq : SWD_DMA_MAX_PERIOD;
+	if (period < SWD_DMA_MIN_PERIOD)
+		period = SWD_DMA_MIN_PERIOD;
+	else if (period > SWD_DMA_MAX_PERIOD)
+		period = SWD_DMA_MAX_PERIOD;
+	swd_dma_period = period;
+}
+
+uint32_t swdptap_dma_frequency_get(void)
+{
+	return swd_dma_timer_frequency() / (swd_dma_period * 2U);
+}
+
+static void swd_dma_stream_setup(const uint8_t stream, const uint32_t peripheral, void *const memory,
+	const size_t count, const uint32_t direction, const uint32_t psize, const uint32_t msize)
+{
+	dma_stream_reset(SWD_DMA_BUS, stream);
+	dma_channel_select(SWD_DMA_BUS, stream, SWD_DMA_TRG);
+	dma_set_peripheral_address(SWD_DMA_BUS, stream, peripheral);
+	dma_set_memory_address(SWD_DMA_BUS, stream, (uint32_t)memory);
+	dma_set_number_of_data(SWD_DMA_BUS, stream, count);
+	dma_set_transfer_mode(SWD_DMA_BUS, stream, direction);
+	dma_enable_memory_increment_mode(SWD_DMA_BUS, stream);
+	dma_set_peripheral_size(SWD_DMA_BUS, stream, psize);
+	dma_set_memory_size(SWD_DMA_BUS, stream, msize);
+	dma_set_priority(SWD_DMA_BUS, stream, DMA_SxCR_PL_VERY_HIGH);
+	dma_enable_stream(SWD_DMA_BUS, stream);
+}
+
+/*
+ * Play out the first words of the waveform, sampling SWDIO once per word into swd_dma_samples.
+ * If the DMA streams don't finish in time, the samples read as though the target never answered.
+ */
+static void swd_dma_run(const size_t words)
+{
+	swd_dma_stream_setup(SWD_DMA_OUT_STREAM, (uint32_t)&GPIO_BSRR(SWCLK_PORT), swd_dma_waveform, words,
+		DMA_SxCR_DIR_MEM_TO_PERIPHERAL, DMA_SxCR_PSIZE_32BIT, DMA_SxCR_MSIZE_32BIT);
+	swd_dma_stream_setup(SWD_DMA_IN_STREAM, (uint32_t)&GPIO_IDR(SWDIO_IN_PORT), swd_dma_samples, words,
+		DMA_SxCR_DIR_PERIPHERAL_TO_MEM, DMA_SxCR_PSIZE_16BIT, DMA_SxCR_MSIZE_16BIT);
+
+	timer_set_period(SWD_DMA_TIM, swd_dma_period - 1U);
+	timer_set_oc_value(SWD_DMA_TIM, TIM_OC2, swd_dma_period / 2U);
+	timer_enable_irq(SWD_DMA_TIM, TIM_DIER_CC1DE | TIM_DIER_CC2DE);
+	/* Start at the end of a period so the first word goes out on the very next tick */
+	timer_set_counter(SWD_DMA_TIM, swd_dma_period - 1U);
+	timer_enable_counter(SWD_DMA_TIM);
+
+	/*
+	 * The last sample is taken half a period after the last word goes out, so wait on that. The run takes
+	 * words timer periods, so if it's taken twice that and a couple of SysTicks more, something's stuck.
+	 */
+	const uint32_t run_ms = (uint32_t)(((uint64_t)words * swd_dma_period * 2000U) / swd_dma_timer_frequency());
+	platform_timeout_s timeout;
+	platform_timeout_set(&timeout, run_ms + 20U);
+	while (!dma_get_interrupt_flag(SWD_DMA_BUS, SWD_DMA_IN_STREAM, DMA_TCIF)) {
+		if (platform_timeout_is_expired(&timeout))
+			break;
+	}
+
+	timer_disable_counter(SWD_DMA_TIM);
+	timer_disable_irq(SWD_DMA_TIM, TIM_DIER_CC1DE | TIM_DIER_CC2DE);
+	if (dma_get_interrupt_flag(SWD_DMA_BUS, SWD_DMA_IN_STREAM, DMA_TCIF))
+		return;
+
+	DEBUG_ERROR("SWD DMA run of %zu words did not complete\n", words);
+	dma_disable_stream(SWD_DMA_BUS, SWD_DMA_OUT_STREAM);
+	dma_disable_stream(SWD_DMA_BUS, SWD_DMA_IN_STREAM);
+	/* Make the samples read as SWDIO left high, so the transfer's ACK comes back as no response */
+	memset(swd_dma_samples, 0xff, sizeof(swd_dma_samples));
+}
+
+/*
+ * Switching to reading needs a turnaround cycle, but as the target is the one that takes over
+ * driving SWDIO, that cycle can lead the read's own waveform. Returns where the read's cycles start.
+ */
+static size_t swd_dma_begin_in(void)
+{
+	if (swd_dma_dir == SWDIO_STATUS_FLOAT)
+		return 0U;
+	swd_dma_dir = SWDIO_STATUS_FLOAT;
+#ifdef DEBUG_SWD_BITS
+	DEBUG_INFO("\n<- ");
+#endif
+	SWDIO_MODE_FLOAT();
+	return swd_dma_encode(&swd_dma_pins, swd_dma_waveform, 0U, 0U, 1U, false);
+}
+
+/* Switching to writing must wait out the turnaround cycle before SWDIO can be driven, so it goes out on its own */
+static void swd_dma_begin_out(void)
+{
+	if (swd_dma_dir == SWDIO_STATUS_DRIVE)
+		return;
+	swd_dma_dir = SWDIO_STATUS_DRIVE;
+#ifdef DEBUG_SWD_BITS
+	DEBUG_INFO("\n-> ");
+#endif
+	swd_dma_run(swd_dma_encode(&swd_dma_pins, swd_dma_waveform, 0U, 0U, 1U, false));
+	SWDIO_MODE_DRIVE();
+}
+
+static uint32_t swd_dma_seq_in(const size_t clock_cycles)
+{
+	const size_t start = swd_dma_begin_in();
+	size_t words = swd_dma_encode(&swd_dma_pins, swd_dma_waveform, start, 0U, clock_cycles, false);
+	words = swd_dma_encode_end(&swd_dma_pins, swd_dma_waveform, words);
+	swd_dma_run(words);
+	return swd_dma_decode(&swd_dma_pins, swd_dma_samples + start, clock_cycles);
+}
+
+static bool swd_dma_seq_in_parity(uint32_t *const ret, const size_t clock_cycles)
+{
+	const size_t start = swd_dma_begin_in();
+	size_t words = swd_dma_encode(&swd_dma_pins, swd_dma_waveform, start, 0U, clock_cycles + 1U, false);
+	words = swd_dma_encode_end(&swd_dma_pins, swd_dma_waveform, words);
+	swd_dma_run(words);
+
+	const bool parity_error = swd_dma_decode_parity(&swd_dma_pins, swd_dma_samples + start, clock_cycles, ret);
+	/* Terminate the read cycle now */
+	swd_dma_begin_out();
+	return parity_error;
+}
+
+static void swd_dma_seq_out(const uint32_t tms_states, const size_t clock_cycles)
+{
+	swd_dma_begin_out();
+	size_t words = swd_dma_encode(&swd_dma_pins, swd_dma_waveform, 0U, tms_states, clock_cycles, true);
+	words = swd_dma_encode_end(&swd_dma_pins, swd_dma_waveform, words);
+	swd_dma_run(words);
+}
+
+static void swd_dma_seq_out_parity(const uint32_t tms_states, const size_t clock_cycles)
+{
+	swd_dma_begin_out();
+	const uint32_t parity = swd_dma_parity(tms_states);
+	size_t words = swd_dma_encode(&swd_dma_pins, swd_dma_waveform, 0U, tms_states, clock_cycles, true);
+	words = swd_dma_encode(&swd_dma_pins, swd_dma_waveform, words, parity, 1U, true);
+	words = swd_dma_encode_end(&swd_dma_pins, swd_dma_waveform, words);
+	swd_dma_run(words);
+}
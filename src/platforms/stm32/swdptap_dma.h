@@ -0,0 +1,34 @@
+/*
+ * This file is part of the Black Magic Debug project.
+ *
+ * Copyright (C) 2023 1BitSquared <info@1bitsquared.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PLATFORMS_STM32_SWDPTAP_DMA_H
+#define PLATFORMS_STM32_SWDPTAP_DMA_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Switches swd_proc over to the timer + DMA driven SWD implementation */
+void swdptap_dma_init(void);
+/* Notes that the pins have been taken over for JTAG, which is always bit-banged */
+void swdptap_dma_deinit(void);
+bool swdptap_dma_active(void);
+void swdptap_dma_frequency_set(uint32_t freq);
+uint32_t swdptap_dma_frequency_get(void);
+
+#endif /* PLATFORMS_STM32_SWDPTAP_DMA_H */
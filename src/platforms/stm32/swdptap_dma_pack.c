@@ -0,0 +1,70 @@
+/*
+ * This file is part of the Black Magic Debug project.
+ *
+ * Copyright (C) 2023 1BitSquared <info@1bitsquared.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * This file implements the packing of SWD sequences into the GPIO waveforms swdptap_dma.c plays out
+ * and the unpacking of the samples it takes. It touches no hardware, so it can be tested on the host.
+ */
+
+#include "swdptap_dma_pack.h"
+
+size_t swd_dma_encode(const swd_dma_pins_s *const pins, uint32_t *const waveform, size_t index, const uint32_t value,
+	const size_t clock_cycles, const bool drive)
+{
+	for (size_t cycle = 0; cycle < clock_cycles; ++cycle) {
+		uint32_t data = 0U;
+		if (drive)
+			data = (value >> cycle) & 1U ? pins->swdio : pins->swdio << 16U;
+		/* Set SWCLK low along with the next bit, then high for the target to clock that bit in */
+		waveform[index++] = (pins->swclk << 16U) | data;
+		waveform[index++] = pins->swclk;
+	}
+	return index;
+}
+
+size_t swd_dma_encode_end(const swd_dma_pins_s *const pins, uint32_t *const waveform, size_t index)
+{
+	waveform[index++] = pins->swclk << 16U;
+	return index;
+}
+
+uint32_t swd_dma_decode(const swd_dma_pins_s *const pins, const uint16_t *const samples, const size_t clock_cycles)
+{
+	uint32_t value = 0U;
+	for (size_t cycle = 0; cycle < clock_cycles; ++cycle) {
+		if (samples[cycle * 2U] & pins->swdio_in)
+			value |= 1U << cycle;
+	}
+	return value;
+}
+
+bool swd_dma_decode_parity(const swd_dma_pins_s *const pins, const uint16_t *const samples, const size_t clock_cycles,
+	uint32_t *const value)
+{
+	const uint32_t result = swd_dma_decode(pins, samples, clock_cycles);
+	size_t parity = __builtin_popcount(result);
+	parity += samples[clock_cycles * 2U] & pins->swdio_in ? 1U : 0U;
+	*value = result;
+	return parity & 1U;
+}
+
+uint32_t swd_dma_parity(const uint32_t value)
+{
+	return __builtin_popcount(value) & 1U;
+}
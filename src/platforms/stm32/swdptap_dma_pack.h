@@ -0,0 +1,57 @@
+/*
+ * This file is part of the Black Magic Debug project.
+ *
+ * Copyright (C) 2023 1BitSquared <info@1bitsquared.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PLATFORMS_STM32_SWDPTAP_DMA_PACK_H
+#define PLATFORMS_STM32_SWDPTAP_DMA_PACK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/* The longest sequence is a turnaround cycle followed by 32 bits of data and a parity bit */
+#define SWD_DMA_MAX_CYCLES 34U
+/* Two timer periods per clock cycle, plus one at the end to return SWCLK low */
+#define SWD_DMA_MAX_WORDS ((SWD_DMA_MAX_CYCLES * 2U) + 1U)
+
+/* The GPIO port bits SWCLK and SWDIO sit on, as they appear in the port's BSRR and IDR */
+typedef struct swd_dma_pins {
+	uint32_t swclk;
+	uint32_t swdio;
+	uint32_t swdio_in;
+} swd_dma_pins_s;
+
+/*
+ * Append clock_cycles SWD clock cycles to the BSRR waveform starting at index, returning the new length.
+ * If drive is set, the bits of value are clocked out LSb first, otherwise SWDIO is left alone.
+ */
+size_t swd_dma_encode(const swd_dma_pins_s *pins, uint32_t *waveform, size_t index, uint32_t value,
+	size_t clock_cycles, bool drive);
+/* Append the word that returns SWCLK low at the end of a waveform, returning the new length */
+size_t swd_dma_encode_end(const swd_dma_pins_s *pins, uint32_t *waveform, size_t index);
+/* Extract clock_cycles bits, LSb first, from the IDR samples taken while SWCLK was low in each cycle */
+uint32_t swd_dma_decode(const swd_dma_pins_s *pins, const uint16_t *samples, size_t clock_cycles);
+/*
+ * Extract clock_cycles bits of data and the parity bit that follows them into value,
+ * returning true if the parity is wrong.
+ */
+bool swd_dma_decode_parity(const swd_dma_pins_s *pins, const uint16_t *samples, size_t clock_cycles, uint32_t *value);
+/* The parity bit to send after value */
+uint32_t swd_dma_parity(uint32_t value);
+
+#endif /* PLATFORMS_STM32_SWDPTAP_DMA_PACK_H */
@@ -18,6 +18,9 @@
  */
 #include "general.h"
 #include "morse.h"
+#ifdef PLATFORM_HAS_SWD_DMA
+#include "swdptap_dma.h"
+#endif
 
 #include <libopencm3/cm3/systick.h>
 #include <libopencm3/cm3/nvic.h>
@@ -78,6 +81,9 @@ uint32_t platform_time_ms(void)
 
 void platform_max_frequency_set(uint32_t freq)
 {
+#ifdef PLATFORM_HAS_SWD_DMA
+	swdptap_dma_frequency_set(freq);
+#endif
 	uint32_t divisor = rcc_ahb_frequency - USED_SWD_CYCLES * freq;
 	/* If we now have an insanely big divisor, the above operation wrapped to a negative signed number. */
 	if (divisor >= 0x80000000U) {
@@ -92,6 +98,11 @@ void platform_max_frequency_set(uint32_t freq)
 
 uint32_t platform_max_frequency_get(void)
 {
+#ifdef PLATFORM_HAS_SWD_DMA
+	/* SWD is clocked by a timer, so report its exact frequency rather than the bit-banged estimate */
+	if (swdptap_dma_active())
+		return swdptap_dma_frequency_get();
+#endif
 	uint32_t ret = rcc_ahb_frequency;
 	ret /= USED_SWD_CYCLES + CYCLES_PER_CNT * swd_delay_cnt;
 	return ret;
@@ -32,6 +32,7 @@
 #include "exception.h"
 #include <stdarg.h>
 #include "target/adiv5.h"
+#include "target/jtag_scan.h"
 #include "target.h"
 #include "hex_utils.h"
 #include "exception.h"
@@ -53,6 +54,35 @@ uint64_t remote_hex_string_to_num(const uint32_t max, const char *const str)
 	return ret;
 }
 
+/* Check if a byte must be escaped to be sent as part of a binary payload */
+bool remote_binary_needs_escape(const uint8_t value)
+{
+	return value == REMOTE_SOM || value == REMOTE_EOM || value == REMOTE_RESP || value == REMOTE_ESCAPE ||
+		value == '$';
+}
+
+/*
+ * Decode an escaped binary payload, stopping when either the input is exhausted or
+ * dest_length bytes have been produced. Returns the number of bytes produced.
+ * This is safe to use in-place as the output never overtakes the input.
+ */
+size_t remote_binary_decode(void *const dest, const size_t dest_length, const char *const src, const size_t src_length)
+{
+	uint8_t *const data = (uint8_t *)dest;
+	size_t length = 0U;
+	for (size_t offset = 0U; offset < src_length && length < dest_length; ++offset) {
+		uint8_t value = (uint8_t)src[offset];
+		if (value == REMOTE_ESCAPE) {
+			/* An escape at the very end of the payload is malformed, so stop */
+			if (++offset == src_length)
+				break;
+			value = (uint8_t)src[offset] ^ 0x20U;
+		}
+		data[length++] = value;
+	}
+	return length;
+}
+
 #if PC_HOSTED == 0
 /* hex-ify and send a buffer of data */
 static void remote_send_buf(const void *const buffer, const size_t len)
@@ -66,6 +96,20 @@ static void remote_send_buf(const void *const buffer, const size_t len)
 	}
 }
 
+/* Escape and send a buffer of binary data */
+static void remote_send_buf_binary(const void *const buffer, const size_t len)
+{
+	const uint8_t *const data = (const uint8_t *)buffer;
+	for (size_t offset = 0; offset < len; ++offset) {
+		const uint8_t value = data[offset];
+		if (remote_binary_needs_escape(value)) {
+			gdb_if_putchar(REMOTE_ESCAPE, 0);
+			gdb_if_putchar((char)(value ^ 0x20U), 0);
+		} else
+			gdb_if_putchar((char)value, 0);
+	}
+}
+
 /* Send a response with some data following */
 static void remote_respond_buf(const char response_code, const void *const buffer, const size_t len)
 {
@@ -140,6 +184,7 @@ static void remote_packet_process_swd(unsigned i, char *packet)
 			remote_dp.dp_read = firmware_swdp_read;
 			remote_dp.low_access = firmware_swdp_low_access;
 			remote_dp.abort = firmware_swdp_abort;
+			remote_dp.transfer_policy = adiv5_transfer_policy;
 			swdptap_init();
 			remote_respond(REMOTE_RESP_OK, 0);
 		} else {
@@ -173,6 +218,20 @@ static void remote_packet_process_swd(unsigned i, char *packet)
 		remote_respond(REMOTE_RESP_OK, 0);
 		break;
 
+	case REMOTE_TRANSFER: { /* St = Transfer ========================== */
+		if (i != 14) {
+			remote_respond(REMOTE_RESP_ERR, REMOTE_ERROR_WRONGLEN);
+			break;
+		}
+		const uint8_t request = remote_hex_string_to_num(2, &packet[2]);
+		param = remote_hex_string_to_num(8, &packet[4]);
+		ticks = remote_hex_string_to_num(2, &packet[12]);
+		badParity = false;
+		const uint8_t ack = firmware_swdp_transfer(request, &param, &badParity, ticks);
+		remote_respond(badParity ? REMOTE_RESP_PARERR : REMOTE_RESP_OK, ((uint64_t)ack << 32U) | param);
+		break;
+	}
+
 	default:
 		remote_respond(REMOTE_RESP_ERR, REMOTE_ERROR_UNRECOGNISED);
 		break;
@@ -185,17 +244,25 @@ static void remote_packet_process_jtag(unsigned i, char *packet)
 	uint64_t DO = 0;
 	size_t ticks;
 	uint64_t DI = 0;
+	/* The host drives the TAPs from Run-Test/Idle, so finish off any chained scan an ADIv5 access left */
+	if (packet[1] != REMOTE_INIT)
+		jtag_tap_idle();
 	switch (packet[1]) {
 	case REMOTE_INIT: /* JS = initialise ============================= */
 		remote_dp.dp_read = fw_adiv5_jtagdp_read;
 		remote_dp.low_access = fw_adiv5_jtagdp_low_access;
 		remote_dp.abort = adiv5_jtagdp_abort;
+		adiv5_jtagdp_select_invalidate(&remote_dp);
 		jtagtap_init();
+		/* That leaves the TAPs in Test-Logic-Reset, so there's no longer a scan to finish */
+		jtag_tap_state_reset();
 		remote_respond(REMOTE_RESP_OK, 0);
 		break;
 
 	case REMOTE_RESET: /* JR = reset ================================= */
+		adiv5_jtagdp_select_invalidate(&remote_dp);
 		jtag_proc.jtagtap_reset();
+		jtag_tap_state_reset();
 		remote_respond(REMOTE_RESP_OK, 0);
 		break;
 
@@ -372,6 +439,67 @@ static void remote_adiv5_respond(const void *const data, const size_t length)
 	}
 }
 
+static void remote_adiv5_respond_binary(const void *const data, const size_t length)
+{
+	if (remote_dp.fault)
+		/* If the request didn't work and caused a fault, tell the host */
+		remote_respond(REMOTE_RESP_ERR, REMOTE_ERROR_FAULT | ((uint16_t)remote_dp.fault << 8U));
+	else {
+		/* Otherwise reply back with the data, escaped rather than hex encoded */
+		gdb_if_putchar(REMOTE_RESP, 0);
+		gdb_if_putchar(REMOTE_RESP_OK, 0);
+		remote_send_buf_binary(data, length);
+		gdb_if_putchar(REMOTE_EOM, 1);
+	}
+}
+
+static void remote_adiv5_respond_batch(const uint8_t completed, const uint32_t *const results, const size_t count)
+{
+	gdb_if_putchar(REMOTE_RESP, 0);
+	gdb_if_putchar(REMOTE_RESP_OK, 0);
+	/* Tell the host how far we got and why we stopped, then give it all the values read */
+	const uint8_t status[2] = {completed, remote_dp.fault};
+	remote_send_buf(status, sizeof(status));
+	remote_send_buf(results, count * sizeof(*results));
+	gdb_if_putchar(REMOTE_EOM, 1);
+}
+
+static void remote_packet_process_adiv5_batch(
+	adiv5_access_port_s *const remote_ap, const char *const packet, const size_t packet_len)
+{
+	/* Grab how many entries there are and check the packet is long enough to hold them all */
+	const size_t count = remote_hex_string_to_num(2, packet + 6);
+	if (count > REMOTE_ADIv5_BATCH_MAX_ENTRIES || packet_len < 8U + (count * REMOTE_ADIv5_BATCH_ENTRY_LENGTH)) {
+		remote_respond(REMOTE_RESP_PARERR, 0);
+		return;
+	}
+	/* Validate all the entries before we perform any of them */
+	for (size_t idx = 0; idx < count; ++idx) {
+		const char *const entry = packet + 8U + (idx * REMOTE_ADIv5_BATCH_ENTRY_LENGTH);
+		if (remote_hex_string_to_num(1, entry) > ADIV5_BATCH_LOW_WRITE) {
+			remote_respond(REMOTE_RESP_PARERR, 0);
+			return;
+		}
+	}
+
+	uint32_t results[REMOTE_ADIv5_BATCH_MAX_ENTRIES];
+	size_t reads = 0;
+	size_t completed = 0;
+	/* Run each access back to back, stopping at the first to fault */
+	for (; completed < count; ++completed) {
+		const char *const entry = packet + 8U + (completed * REMOTE_ADIv5_BATCH_ENTRY_LENGTH);
+		const adiv5_batch_op_e op = remote_hex_string_to_num(1, entry);
+		const uint16_t addr = remote_hex_string_to_num(4, entry + 1U);
+		const uint32_t value = remote_hex_string_to_num(8, entry + 5U);
+		const uint32_t result = adiv5_batch_access(remote_ap, op, addr, value);
+		if (remote_dp.fault)
+			break;
+		if (op != ADIV5_BATCH_AP_WRITE && op != ADIV5_BATCH_LOW_WRITE)
+			results[reads++] = result;
+	}
+	remote_adiv5_respond_batch(completed, results, reads);
+}
+
 static void remote_packet_process_adiv5(const char *const packet, const size_t packet_len)
 {
 	/* Our shortest ADIv5 packet is 8 bytes long, check that we have at least that */
@@ -381,8 +509,12 @@ static void remote_packet_process_adiv5(const char *const packet, const size_t p
 	}
 
 	/* Set up the DP and a fake AP structure to perform the access with */
-	remote_dp.dev_index = remote_hex_string_to_num(2, packet + 2);
-	adiv5_access_port_s remote_ap;
+	const uint8_t dev_index = remote_hex_string_to_num(2, packet + 2);
+	/* What's known about SELECT belongs to the DP it was learnt from */
+	if (dev_index != remote_dp.dev_index)
+		adiv5_jtagdp_select_invalidate(&remote_dp);
+	remote_dp.dev_index = dev_index;
+	adiv5_access_port_s remote_ap = {};
 	remote_ap.apsel = remote_hex_string_to_num(2, packet + 4);
 	remote_ap.dp = &remote_dp;
 
@@ -423,14 +555,15 @@ static void remote_packet_process_adiv5(const char *const packet, const size_t p
 		break;
 	}
 	/* Memory access commands */
-	case REMOTE_MEM_READ: { /* Am = Read from memory */
+	case REMOTE_MEM_READ:          /* Am = Read from memory */
+	case REMOTE_MEM_READ_BINARY: { /* Ax = Read from memory, binary response */
 		/* Grab the CSW value to use in the access */
 		remote_ap.csw = remote_hex_string_to_num(8, packet + 6);
 		/* Grab the start address for the read */
 		const uint32_t address = remote_hex_string_to_num(8, packet + 14U);
 		/* And how many bytes to read, validating it for buffer overflows */
 		const uint32_t length = remote_hex_string_to_num(8, packet + 22U);
-		if (length > 1024U) {
+		if (length > REMOTE_ADIv5_MEM_MAX_LENGTH) {
 			remote_respond(REMOTE_RESP_PARERR, 0);
 			break;
 		}
@@ -438,7 +571,10 @@ static void remote_packet_process_adiv5(const char *const packet, const size_t p
 		void *data = gdb_packet_buffer();
 		/* Perform the read and send back the results */
 		adiv5_mem_read(&remote_ap, data, address, length);
-		remote_adiv5_respond(data, length);
+		if (packet[1] == REMOTE_MEM_READ_BINARY)
+			remote_adiv5_respond_binary(data, length);
+		else
+			remote_adiv5_respond(data, length);
 		break;
 	}
 	case REMOTE_MEM_WRITE: { /* Am = Write to memory */
@@ -450,12 +586,12 @@ static void remote_packet_process_adiv5(const char *const packet, const size_t p
 		const uint32_t dest = remote_hex_string_to_num(8, packet + 16U);
 		/* And how many bytes to read, validating it for buffer overflows */
 		const size_t length = remote_hex_string_to_num(8, packet + 24U);
-		if (length > 1024U) {
+		if (length > REMOTE_ADIv5_MEM_MAX_LENGTH) {
 			remote_respond(REMOTE_RESP_PARERR, 0);
 			break;
 		}
-		/* Validate the alignment is suitable */
-		if (length & ((1U << align) - 1U)) {
+		/* Validate the alignment is one we can do and suitable for the length */
+		if (align > ALIGN_WORD || (length & ((1U << align) - 1U))) {
 			remote_respond(REMOTE_RESP_PARERR, 0);
 			break;
 		}
@@ -468,6 +604,55 @@ static void remote_packet_process_adiv5(const char *const packet, const size_t p
 		remote_adiv5_respond(NULL, 0);
 		break;
 	}
+	case REMOTE_MEM_WRITE_BINARY: { /* AX = Write to memory, binary payload */
+		/* Grab the CSW value to use in the access */
+		remote_ap.csw = remote_hex_string_to_num(8, packet + 6);
+		/* Grab the alignment for the access */
+		const align_e align = remote_hex_string_to_num(2, packet + 14U);
+		/* Grab the start address for the write */
+		const uint32_t dest = remote_hex_string_to_num(8, packet + 16U);
+		/* And how many bytes to write, validating it for buffer overflows */
+		const size_t length = remote_hex_string_to_num(8, packet + 24U);
+		if (packet_len < 32U || length > REMOTE_ADIv5_MEM_MAX_LENGTH || align > ALIGN_WORD ||
+			(length & ((1U << align) - 1U))) {
+			remote_respond(REMOTE_RESP_PARERR, 0);
+			break;
+		}
+		/* Get the aligned packet buffer to reuse for the data to write */
+		void *data = gdb_packet_buffer();
+		/* Decode the data from the packet into it, checking we got everything the host said we would */
+		if (remote_binary_decode(data, length, packet + 32U, packet_len - 32U) != length) {
+			remote_respond(REMOTE_RESP_PARERR, 0);
+			break;
+		}
+		/* Perform the write and report success/failures */
+		adiv5_mem_write_sized(&remote_ap, dest, data, length, align);
+		remote_adiv5_respond(NULL, 0);
+		break;
+	}
+
+	case REMOTE_ADIv5_MEM32_WAIT: { /* AW = Wait for a memory location to match a value */
+		if (packet_len < REMOTE_ADIv5_MEM32_WAIT_LENGTH - 2U) {
+			remote_respond(REMOTE_RESP_PARERR, 0);
+			break;
+		}
+		/* Grab the CSW value to use in the access */
+		remote_ap.csw = remote_hex_string_to_num(8, packet + 6);
+		/* Grab the location to poll, what to compare it against and how long to keep trying */
+		const uint32_t address = remote_hex_string_to_num(8, packet + 14U);
+		const uint32_t mask = remote_hex_string_to_num(8, packet + 22U);
+		const uint32_t match = remote_hex_string_to_num(8, packet + 30U);
+		const uint32_t timeout = remote_hex_string_to_num(4, packet + 38U);
+		/* Run the poll loop and send back the last value read, from which the host can tell if it matched */
+		uint32_t value = 0U;
+		adiv5_mem32_wait(&remote_ap, address, mask, match, timeout, &value);
+		remote_adiv5_respond(&value, 4U);
+		break;
+	}
+
+	case REMOTE_ADIv5_BATCH: /* AB = Perform a batch of accesses */
+		remote_packet_process_adiv5_batch(&remote_ap, packet, packet_len);
+		break;
 
 	default:
 		remote_respond(REMOTE_RESP_ERR, REMOTE_ERROR_UNRECOGNISED);
@@ -26,7 +26,7 @@
 #include <inttypes.h>
 #include "general.h"
 
-#define REMOTE_HL_VERSION 3
+#define REMOTE_HL_VERSION 7
 
 /*
  * Commands to remote end, and responses
@@ -48,6 +48,20 @@
  *       resp: F<PARAM> - hex value returned, bad parity.
  *             X<err>   - error occurred
  *
+ * From protocol version 4, the binary memory access commands (Ax and AX) carry
+ * their data payload as raw bytes rather than hex. Any payload byte that would
+ * otherwise be mistaken for a framing character is escaped by sending
+ * REMOTE_ESCAPE followed by the byte XOR'd with 0x20, as in GDB's X packet.
+ *
+ * From protocol version 5, a batch of ADIv5 accesses can be sent in a single
+ * AB request and the results of all of them are returned in a single response.
+ *
+ * From protocol version 6, the probe can poll a memory location until it matches
+ * a value (AW), so waiting on a Flash controller doesn't cost a round trip per read.
+ *
+ * From protocol version 7, a whole SWD transfer - request, ACK, data phase and the idle
+ * cycles after a write - can be done in a single St request rather than one request per sequence.
+ *
  * The whole protocol is defined in this header file. Parameters have
  * to be marshalled in remote.c, swdptap.c and jtagtap.c, so be
  * careful to ensure the parameter handling matches the protocol
@@ -65,6 +79,9 @@
 #define REMOTE_EOM  '#'
 #define REMOTE_RESP '&'
 
+/* Binary payload escape character */
+#define REMOTE_ESCAPE '}'
+
 /* Protocol response options */
 #define REMOTE_RESP_OK     'K'
 #define REMOTE_RESP_PARERR 'P'
@@ -96,6 +113,7 @@
 #define REMOTE_RESET         'R'
 #define REMOTE_INIT          'S'
 #define REMOTE_TMS           'T'
+#define REMOTE_TRANSFER      't'
 #define REMOTE_VOLTAGE       'V'
 #define REMOTE_NRST_SET      'Z'
 #define REMOTE_NRST_GET      'z'
@@ -179,6 +197,13 @@
 		REMOTE_SOM, REMOTE_SWDP_PACKET, REMOTE_OUT_PAR, '%', '0', '2', 'x', '%', 'x', REMOTE_EOM, 0 \
 	}
 
+/* A whole transfer including idle cycles, response is the ACK in bits 32+ and the data read in the low 32 */
+#define REMOTE_SWDP_TRANSFER_STR                                                                                  \
+	(char[])                                                                                                      \
+	{                                                                                                             \
+		REMOTE_SOM, REMOTE_SWDP_PACKET, REMOTE_TRANSFER, REMOTE_UINT8, REMOTE_UINT32, REMOTE_UINT8, REMOTE_EOM, 0 \
+	}
+
 /* JTAG protocol elements */
 #define REMOTE_JTAG_PACKET 'J'
 #define REMOTE_JTAG_INIT_STR                                                        \
@@ -247,6 +272,10 @@
 #define REMOTE_ADIv5_RAW_ACCESS 'R'
 #define REMOTE_MEM_READ         'm'
 #define REMOTE_MEM_WRITE        'M'
+#define REMOTE_MEM_READ_BINARY  'x'
+#define REMOTE_MEM_WRITE_BINARY 'X'
+#define REMOTE_ADIv5_BATCH      'B'
+#define REMOTE_ADIv5_MEM32_WAIT 'W'
 
 #define REMOTE_ADIv5_DEV_INDEX REMOTE_UINT8
 #define REMOTE_ADIv5_AP_SEL    REMOTE_UINT8
@@ -303,8 +332,70 @@
  * 8 for the address and 8 for the count and one trailer gives 34U
  */
 #define REMOTE_ADIv5_MEM_WRITE_LENGTH 34U
+#define REMOTE_ADIv5_MEM_READ_BINARY_STR                                                                      \
+	(char[])                                                                                                  \
+	{                                                                                                         \
+		REMOTE_SOM, REMOTE_ADIv5_PACKET, REMOTE_MEM_READ_BINARY, REMOTE_ADIv5_DEV_INDEX, REMOTE_ADIv5_AP_SEL, \
+			REMOTE_ADIv5_CSW, REMOTE_ADIv5_ADDR32, REMOTE_ADIv5_COUNT, REMOTE_EOM, 0                          \
+	}
+#define REMOTE_ADIv5_MEM_WRITE_BINARY_STR                                                                      \
+	(char[])                                                                                                   \
+	{                                                                                                          \
+		REMOTE_SOM, REMOTE_ADIv5_PACKET, REMOTE_MEM_WRITE_BINARY, REMOTE_ADIv5_DEV_INDEX, REMOTE_ADIv5_AP_SEL, \
+			REMOTE_ADIv5_CSW, REMOTE_ADIv5_ALIGNMENT, REMOTE_ADIv5_ADDR32, REMOTE_ADIv5_COUNT, 0               \
+	}
+/* The binary variants of the memory access requests use the same header layouts as the hex ones */
+#define REMOTE_ADIv5_MEM_WRITE_BINARY_LENGTH REMOTE_ADIv5_MEM_WRITE_LENGTH
+/* This is the largest memory access in bytes the firmware will accept in a single request */
+#define REMOTE_ADIv5_MEM_MAX_LENGTH 1024U
+
+/*
+ * A batch request is a header giving the device index, AP selection and number of entries
+ * followed by that many entries, each of which is 1 hex digit giving the adiv5_batch_op_e
+ * of the access, followed by the 16-bit address and 32-bit value to use.
+ *
+ * The response is the number of entries that completed, the fault code the first entry to
+ * not complete saw (if any), and then the 32-bit result of each completed read entry in order.
+ */
+#define REMOTE_ADIv5_BATCH_STR                                                                           \
+	(char[])                                                                                             \
+	{                                                                                                    \
+		REMOTE_SOM, REMOTE_ADIv5_PACKET, REMOTE_ADIv5_BATCH, REMOTE_ADIv5_DEV_INDEX, REMOTE_ADIv5_AP_SEL, \
+			REMOTE_UINT8, /* count */ 0                                                                  \
+	}
+/* 3 leader bytes + 2 bytes for dev index + 2 bytes for AP select + 2 for the entry count gives 9U */
+#define REMOTE_ADIv5_BATCH_LENGTH 9U
+#define REMOTE_ADIv5_BATCH_ENTRY_STR \
+	(char[])                         \
+	{                                \
+		'%', '1', 'x', REMOTE_ADIv5_ADDR16, REMOTE_ADIv5_DATA, 0 \
+	}
+#define REMOTE_ADIv5_BATCH_ENTRY_LENGTH 13U
+/* The most entries the firmware will accept in a single batch request */
+#define REMOTE_ADIv5_BATCH_MAX_ENTRIES 64U
+
+/*
+ * A wait request polls the 32-bit location at the address until (value & mask) == match, or the
+ * timeout in milliseconds expires. The response is the last value read, so the host can tell which.
+ */
+#define REMOTE_ADIv5_MEM32_WAIT_STR                                                                           \
+	(char[])                                                                                                  \
+	{                                                                                                         \
+		REMOTE_SOM, REMOTE_ADIv5_PACKET, REMOTE_ADIv5_MEM32_WAIT, REMOTE_ADIv5_DEV_INDEX, REMOTE_ADIv5_AP_SEL, \
+			REMOTE_ADIv5_CSW, REMOTE_ADIv5_ADDR32, REMOTE_ADIv5_DATA, /* mask */                             \
+			REMOTE_ADIv5_DATA,                                        /* match */                            \
+			REMOTE_UINT16,                                            /* timeout */                          \
+			REMOTE_EOM, 0                                                                                     \
+	}
+/*
+ * 3 leader bytes + 2 bytes for dev index + 2 bytes for AP select + 8 for CSW + 8 for the address,
+ * 8 each for the mask and match values, 4 for the timeout and one trailer gives 44U
+ */
+#define REMOTE_ADIv5_MEM32_WAIT_LENGTH 44U
 
 uint64_t remote_hex_string_to_num(uint32_t limit, const char *str);
+bool remote_binary_needs_escape(uint8_t value);
+size_t remote_binary_decode(void *dest, size_t dest_length, const char *src, size_t src_length);
 void remote_packet_process(unsigned int i, char *packet);
 
 #endif /* REMOTE_H */
@@ -73,6 +73,13 @@ char rtt_ident[16] = {0};
 
 /* usb uart transmit buffer */
 static char xmit_buf[RTT_UP_BUF_SIZE];
+/* buffer for data on its way to the target */
+static char recv_buf[RTT_DOWN_BUF_SIZE];
+
+/* host to target transfer statistics */
+uint32_t rtt_down_bytes = 0;
+static uint32_t rtt_down_start_ms;
+static uint32_t rtt_down_last_ms;
 
 /*********************************************************************
 *
@@ -232,27 +239,56 @@ static rtt_retval_e read_rtt(target_s *const cur_target, const uint32_t i)
 	if (rtt_channel[i].head >= rtt_channel[i].buf_size || rtt_channel[i].tail >= rtt_channel[i].buf_size)
 		return RTT_ERR;
 
-	/* write recv_buf to target rtt 'down' buf */
-	while (true) {
-		const uint32_t next_head = (rtt_channel[i].head + 1U) % rtt_channel[i].buf_size;
-		if (rtt_channel[i].tail == next_head)
-			break;
-		const int ch = rtt_getchar();
+	/* work out how much space there is in the target rtt 'down' buffer, keeping one byte free */
+	const uint32_t head = rtt_channel[i].head;
+	const uint32_t tail = rtt_channel[i].tail;
+	uint32_t bytes_free = tail > head ? tail - head - 1U : rtt_channel[i].buf_size - head + tail - 1U;
+	if (bytes_free > sizeof(recv_buf))
+		bytes_free = sizeof(recv_buf);
+
+	/* gather as much of the host's data as will fit */
+	uint32_t len = 0;
+	for (; len < bytes_free; ++len) {
+		const int32_t ch = rtt_getchar();
 		if (ch == -1)
 			break;
-		if (target_mem_write(cur_target, rtt_channel[i].buf_addr + rtt_channel[i].head, &ch, 1))
-			return RTT_ERR;
-		/* advance head pointer */
-		rtt_channel[i].head = next_head;
+		recv_buf[len] = (char)ch;
 	}
+	/* target buffer full, keep polling until it drains */
+	if (len == 0)
+		return RTT_OK;
+
+	/* write recv_buf to target rtt 'down' buf, wrapping around at most once */
+	const uint32_t first_len = MIN(len, rtt_channel[i].buf_size - head);
+	if (target_mem_write(cur_target, rtt_channel[i].buf_addr + head, recv_buf, first_len))
+		return RTT_ERR;
+	if (first_len < len && target_mem_write(cur_target, rtt_channel[i].buf_addr, recv_buf + first_len, len - first_len))
+		return RTT_ERR;
+	rtt_channel[i].head = (head + len) % rtt_channel[i].buf_size;
 
 	/* update head of target 'down' buffer */
 	const uint32_t head_addr = rtt_cbaddr + 24U + i * 24U + 12U;
 	if (target_mem_write(cur_target, head_addr, &rtt_channel[i].head, sizeof(rtt_channel[i].head)))
 		return RTT_ERR;
+
+	/* keep track of how fast data is going to the target */
+	const uint32_t now = platform_time_ms();
+	if (rtt_down_bytes == 0)
+		rtt_down_start_ms = now;
+	rtt_down_bytes += len;
+	rtt_down_last_ms = now;
 	return RTT_OK;
 }
 
+/* average rate data has gone from host to target at since rtt was enabled, in bytes/s */
+uint32_t rtt_down_rate(void)
+{
+	const uint32_t elapsed = rtt_down_last_ms - rtt_down_start_ms;
+	if (elapsed == 0)
+		return 0;
+	return (uint32_t)(((uint64_t)rtt_down_bytes * 1000U) / elapsed);
+}
+
 /*********************************************************************
 *
 *       rtt from target to host
@@ -332,6 +368,15 @@ static rtt_retval_e print_rtt(target_s *const cur_target, const uint32_t i)
 **********************************************************************
 */
 
+/* How long until poll_rtt() next has something to do */
+uint32_t rtt_poll_wait_ms(void)
+{
+	const uint32_t now = platform_time_ms();
+	if (last_poll_ms + poll_ms <= now || now < last_poll_ms)
+		return 0U;
+	return last_poll_ms + poll_ms - now;
+}
+
 void poll_rtt(target_s *const cur_target)
 {
 	/* rtt off */
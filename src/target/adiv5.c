@@ -48,6 +48,10 @@
 #define ARM_AP_TYPE_AXI  4U
 #define ARM_AP_TYPE_AHB5 5U
 
+/* AP IDR class field (bits 16:13), ADIv5 C2.6.1 */
+#define ARM_AP_IDR_CLASS(idr) (((idr) >> 13U) & 0xfU)
+#define ARM_AP_CLASS_MEM      8U
+
 /* ROM table CIDR values */
 #define CIDR0_OFFSET 0xff0U /* DBGCID0 */
 #define CIDR1_OFFSET 0xff4U /* DBGCID1 */
@@ -697,11 +701,24 @@ adiv5_access_port_s *adiv5_new_ap(adiv5_debug_port_s *dp, uint8_t apsel)
 
 	memcpy(ap, &tmpap, sizeof(*ap));
 
+	/*
+	 * Packed transfer support is optional. A MEM-AP that lacks it won't keep 0b10 in CSW.AddrInc,
+	 * so try setting it and see if it sticks, then put CSW back how we found it.
+	 */
+	if (ARM_AP_IDR_CLASS(ap->idr) == ARM_AP_CLASS_MEM) {
+		const uint32_t csw = adiv5_ap_read(ap, ADIV5_AP_CSW);
+		adiv5_ap_write(ap, ADIV5_AP_CSW, ap->csw | ADIV5_AP_CSW_ADDRINC_PACKED | ADIV5_AP_CSW_SIZE_BYTE);
+		const uint32_t packed_csw = adiv5_ap_read(ap, ADIV5_AP_CSW);
+		ap->packed_transfers = (packed_csw & ADIV5_AP_CSW_ADDRINC_MASK) == ADIV5_AP_CSW_ADDRINC_PACKED;
+		adiv5_ap_write(ap, ADIV5_AP_CSW, csw);
+	}
+
 #if defined(ENABLE_DEBUG)
 	uint32_t cfg = adiv5_ap_read(ap, ADIV5_AP_CFG);
 	DEBUG_INFO("AP %3d: IDR=%08" PRIx32 " CFG=%08" PRIx32 " BASE=%08" PRIx32 " CSW=%08" PRIx32, apsel, ap->idr, cfg,
 		ap->base, ap->csw);
-	DEBUG_INFO(" (AHB-AP var%" PRIx32 " rev%" PRIx32 ")\n", (ap->idr >> 4U) & 0xfU, ap->idr >> 28U);
+	DEBUG_INFO(" (AHB-AP var%" PRIx32 " rev%" PRIx32 "%s)\n", (ap->idr >> 4U) & 0xfU, ap->idr >> 28U,
+		ap->packed_transfers ? ", packed" : "");
 #endif
 	adiv5_ap_ref(ap);
 	return ap;
@@ -939,10 +956,11 @@ void adiv5_dp_init(adiv5_debug_port_s *dp, const uint32_t idcode)
 
 #define ALIGNOF(x) (((x)&3U) == 0 ? ALIGN_WORD : (((x)&1U) == 0 ? ALIGN_HALFWORD : ALIGN_BYTE))
 
-/* Program the CSW and TAR for sequential access at a given width */
-void ap_mem_access_setup(adiv5_access_port_s *ap, uint32_t addr, align_e align)
+/* Program the CSW and TAR for sequential access at a given width, with the given address increment mode */
+static void ap_mem_access_setup_addrinc(
+	adiv5_access_port_s *const ap, const uint32_t addr, const align_e align, const uint32_t addrinc)
 {
-	uint32_t csw = ap->csw | ADIV5_AP_CSW_ADDRINC_SINGLE;
+	uint32_t csw = ap->csw | addrinc;
 
 	switch (align) {
 	case ALIGN_BYTE:
@@ -960,6 +978,27 @@ void ap_mem_access_setup(adiv5_access_port_s *ap, uint32_t addr, align_e align)
 	adiv5_dp_low_access(ap->dp, ADIV5_LOW_WRITE, ADIV5_AP_TAR, addr);
 }
 
+/* Program the CSW and TAR for sequential access at a given width */
+void ap_mem_access_setup(adiv5_access_port_s *ap, uint32_t addr, align_e align)
+{
+	ap_mem_access_setup_addrinc(ap, addr, align, ADIV5_AP_CSW_ADDRINC_SINGLE);
+}
+
+/*
+ * Work out how to split a sub-word transfer so the word-aligned middle of it can be done with
+ * packed accesses, returning the length of the unaligned head and of the packed middle.
+ * The middle length is 0 if packing is not possible or not worthwhile.
+ */
+size_t adiv5_packed_split(
+	const adiv5_access_port_s *const ap, const uint32_t addr, const size_t len, const align_e align, size_t *const head)
+{
+	*head = 0U;
+	if (!ap->packed_transfers || align >= ALIGN_WORD)
+		return 0U;
+	*head = MIN((4U - (addr & 3U)) & 3U, len);
+	return (len - *head) & ~3U;
+}
+
 /* Unpack data from the source uint32_t value based on data alignment and source address */
 void *adiv5_unpack_data(void *const dest, const uint32_t src, const uint32_t data, const align_e align)
 {
@@ -1027,22 +1066,26 @@ const void *adiv5_pack_data(const uint32_t dest, const void *const src, uint32_t
 	return (const uint8_t *)src + (1 << align);
 }
 
-void advi5_mem_read_bytes(adiv5_access_port_s *ap, void *dest, uint32_t src, size_t len)
+/*
+ * Read a run of DRW accesses of the given width. When packed, each DRW access
+ * carries a whole word's worth of them, and src and len must be word aligned.
+ */
+static void adiv5_mem_read_run(
+	adiv5_access_port_s *const ap, void *dest, uint32_t src, size_t len, const align_e align, const bool packed)
 {
 	uint32_t osrc = src;
-	const align_e align = MIN(ALIGNOF(src), ALIGNOF(len));
+	/* The alignment that describes how the data comes back in each DRW access */
+	const align_e data_align = packed ? ALIGN_WORD : align;
 
-	if (len == 0)
-		return;
-
-	len >>= align;
-	ap_mem_access_setup(ap, src, align);
+	len >>= data_align;
+	ap_mem_access_setup_addrinc(
+		ap, src, align, packed ? ADIV5_AP_CSW_ADDRINC_PACKED : ADIV5_AP_CSW_ADDRINC_SINGLE);
 	adiv5_dp_low_access(ap->dp, ADIV5_LOW_READ, ADIV5_AP_DRW, 0);
 	while (--len) {
 		const uint32_t value = adiv5_dp_low_access(ap->dp, ADIV5_LOW_READ, ADIV5_AP_DRW, 0);
-		dest = adiv5_unpack_data(dest, src, value, align);
+		dest = adiv5_unpack_data(dest, src, value, data_align);
 
-		src += 1U << align;
+		src += 1U << data_align;
 		/* Check for 10 bit address overflow */
 		if ((src ^ osrc) & 0xfffffc00U) {
 			osrc = src;
@@ -1051,27 +1094,71 @@ void advi5_mem_read_bytes(adiv5_access_port_s *ap, void *dest, uint32_t src, siz
 		}
 	}
 	const uint32_t value = adiv5_dp_low_access(ap->dp, ADIV5_LOW_READ, ADIV5_DP_RDBUFF, 0);
-	adiv5_unpack_data(dest, src, value, align);
+	adiv5_unpack_data(dest, src, value, data_align);
 }
 
-void adiv5_mem_write_bytes(adiv5_access_port_s *ap, uint32_t dest, const void *src, size_t len, align_e align)
+void advi5_mem_read_bytes(adiv5_access_port_s *ap, void *dest, uint32_t src, size_t len)
+{
+	const align_e align = MIN(ALIGNOF(src), ALIGNOF(len));
+
+	if (len == 0)
+		return;
+
+	/* If the AP supports it, do the word-aligned middle of a sub-word read as packed accesses */
+	size_t head;
+	const size_t middle = adiv5_packed_split(ap, src, len, align, &head);
+	if (middle) {
+		uint8_t *const data = (uint8_t *)dest;
+		const size_t tail = len - head - middle;
+		if (head)
+			adiv5_mem_read_run(ap, data, src, head, align, false);
+		adiv5_mem_read_run(ap, data + head, src + head, middle, align, true);
+		if (tail)
+			adiv5_mem_read_run(ap, data + head + middle, src + head + middle, tail, align, false);
+		return;
+	}
+	adiv5_mem_read_run(ap, dest, src, len, align, false);
+}
+
+/* Write a run of DRW accesses of the given width, with the same packing rules as adiv5_mem_read_run() */
+static void adiv5_mem_write_run(
+	adiv5_access_port_s *const ap, uint32_t dest, const void *src, size_t len, const align_e align, const bool packed)
 {
 	uint32_t odest = dest;
+	const align_e data_align = packed ? ALIGN_WORD : align;
 
-	len >>= align;
-	ap_mem_access_setup(ap, dest, align);
+	len >>= data_align;
+	ap_mem_access_setup_addrinc(
+		ap, dest, align, packed ? ADIV5_AP_CSW_ADDRINC_PACKED : ADIV5_AP_CSW_ADDRINC_SINGLE);
 	while (len--) {
 		uint32_t value = 0;
-		src = adiv5_pack_data(dest, src, &value, align);
+		src = adiv5_pack_data(dest, src, &value, data_align);
 		adiv5_dp_low_access(ap->dp, ADIV5_LOW_WRITE, ADIV5_AP_DRW, value);
 
-		dest += 1U << align;
+		dest += 1U << data_align;
 		/* Check for 10 bit address overflow */
 		if ((dest ^ odest) & 0xfffffc00U) {
 			odest = dest;
 			adiv5_dp_low_access(ap->dp, ADIV5_LOW_WRITE, ADIV5_AP_TAR, dest);
 		}
 	}
+}
+
+void adiv5_mem_write_bytes(adiv5_access_port_s *ap, uint32_t dest, const void *src, size_t len, align_e align)
+{
+	/* If the AP supports it, do the word-aligned middle of a sub-word write as packed accesses */
+	size_t head;
+	const size_t middle = adiv5_packed_split(ap, dest, len, align, &head);
+	if (middle) {
+		const uint8_t *const data = (const uint8_t *)src;
+		const size_t tail = len - head - middle;
+		if (head)
+			adiv5_mem_write_run(ap, dest, data, head, align, false);
+		adiv5_mem_write_run(ap, dest + head, data + head, middle, align, true);
+		if (tail)
+			adiv5_mem_write_run(ap, dest + head + middle, data + head + middle, tail, align, false);
+	} else
+		adiv5_mem_write_run(ap, dest, src, len, align, false);
 	/* Make sure this write is complete by doing a dummy read */
 	adiv5_dp_read(ap->dp, ADIV5_DP_RDBUFF);
 }
@@ -1092,6 +1179,134 @@ uint32_t firmware_ap_read(adiv5_access_port_s *ap, uint16_t addr)
 	return ret;
 }
 
+/* Perform a single access as described by a batch entry, returning the value read for reads */
+uint32_t adiv5_batch_access(
+	adiv5_access_port_s *const ap, const adiv5_batch_op_e op, const uint16_t addr, const uint32_t value)
+{
+	switch (op) {
+	case ADIV5_BATCH_DP_READ:
+		return adiv5_dp_read(ap->dp, addr);
+	case ADIV5_BATCH_AP_READ:
+		return adiv5_ap_read(ap, addr);
+	case ADIV5_BATCH_AP_WRITE:
+		adiv5_ap_write(ap, addr, value);
+		return 0U;
+	case ADIV5_BATCH_LOW_READ:
+		return adiv5_dp_low_access(ap->dp, ADIV5_LOW_READ, addr, value);
+	case ADIV5_BATCH_LOW_WRITE:
+		return adiv5_dp_low_access(ap->dp, ADIV5_LOW_WRITE, addr, value);
+	}
+	return 0U;
+}
+
+void adiv5_batch_init(adiv5_batch_s *const batch, adiv5_access_port_s *const ap)
+{
+	batch->ap = ap;
+	batch->queued = 0U;
+	batch->issued = 0U;
+	batch->fault_index = SIZE_MAX;
+}
+
+/*
+ * Queue an access onto the batch. If the batch is full, it is flushed first.
+ * Once any access in the batch has faulted, further accesses are discarded and read as 0.
+ */
+void adiv5_batch_queue(adiv5_batch_s *const batch, const adiv5_batch_op_e op, const uint16_t addr,
+	const uint32_t value, uint32_t *const result)
+{
+	if (batch->queued == ADIV5_BATCH_MAX_ENTRIES)
+		adiv5_batch_flush(batch);
+	if (batch->fault_index != SIZE_MAX) {
+		if (result)
+			*result = 0U;
+		return;
+	}
+	adiv5_batch_entry_s *const entry = &batch->entries[batch->queued++];
+	entry->op = op;
+	entry->addr = addr;
+	entry->value = value;
+	entry->result = result;
+}
+
+/*
+ * Run everything queued on the batch and deliver the results.
+ * Returns the index of the first access to fault, or the total number of accesses issued if none did.
+ */
+size_t adiv5_batch_flush(adiv5_batch_s *const batch)
+{
+	if (batch->fault_index != SIZE_MAX)
+		return batch->fault_index;
+	adiv5_access_port_s *const ap = batch->ap;
+	size_t completed = 0U;
+#if PC_HOSTED == 1
+	/* If the probe can run the whole batch in one go, let it */
+	if (ap->dp->batch_access)
+		completed = ap->dp->batch_access(ap, batch->entries, batch->queued);
+	else
+#endif
+	{
+		for (; completed < batch->queued; ++completed) {
+			adiv5_batch_entry_s *const entry = &batch->entries[completed];
+			const uint32_t result = adiv5_batch_access(ap, entry->op, entry->addr, entry->value);
+			if (ap->dp->fault)
+				break;
+			if (entry->result)
+				*entry->result = result;
+		}
+	}
+	if (completed != batch->queued) {
+		batch->fault_index = batch->issued + completed;
+		/* Make sure everything from the faulting access on reads as 0 */
+		for (size_t idx = completed; idx < batch->queued; ++idx) {
+			if (batch->entries[idx].result)
+				*batch->entries[idx].result = 0U;
+		}
+	}
+	batch->issued += batch->queued;
+	batch->queued = 0U;
+	return batch->fault_index != SIZE_MAX ? batch->fault_index : batch->issued;
+}
+
+/*
+ * Poll the 32-bit value at addr until (value & mask) == match, or until timeout_ms has passed.
+ * The last value read is stored into value if that's not NULL. Returns true if the value matched.
+ */
+bool adiv5_mem32_wait(adiv5_access_port_s *const ap, const uint32_t addr, const uint32_t mask, const uint32_t match,
+	const uint32_t timeout_ms, uint32_t *const value)
+{
+#if PC_HOSTED == 1
+	/* If the probe can run the poll loop itself, let it and save a round trip per read */
+	if (ap->dp->mem32_wait)
+		return ap->dp->mem32_wait(ap, addr, mask, match, timeout_ms, value);
+#endif
+	platform_timeout_s timeout;
+	platform_timeout_set(&timeout, timeout_ms);
+	uint32_t result = 0U;
+	bool matched = false;
+#if PC_HOSTED == 1
+	do {
+		adiv5_mem_read(ap, &result, addr, sizeof(result));
+		matched = (result & mask) == match;
+	} while (!matched && !ap->dp->fault && !platform_timeout_is_expired(&timeout));
+#else
+	/* Point TAR at the location once with auto-increment off, and then just keep re-reading DRW */
+	ap_mem_access_setup_addrinc(ap, addr, ALIGN_WORD, ADIV5_AP_CSW_ADDRINC_NONE);
+	/* DRW reads are posted, so each one returns the value fetched by the one before it */
+	adiv5_dp_low_access(ap->dp, ADIV5_LOW_READ, ADIV5_AP_DRW, 0);
+	while (!ap->dp->fault) {
+		result = adiv5_dp_low_access(ap->dp, ADIV5_LOW_READ, ADIV5_AP_DRW, 0);
+		matched = (result & mask) == match;
+		if (matched || platform_timeout_is_expired(&timeout))
+			break;
+	}
+	/* Collect the read still in flight so the DP is left idle */
+	adiv5_dp_read(ap->dp, ADIV5_DP_RDBUFF);
+#endif
+	if (value)
+		*value = result;
+	return matched;
+}
+
 void adiv5_mem_write(adiv5_access_port_s *ap, uint32_t dest, const void *src, size_t len)
 {
 	align_e align = MIN(ALIGNOF(dest), ALIGNOF(len));
@@ -179,6 +179,9 @@
 #define SWDP_ACK_FAULT       0x04U
 #define SWDP_ACK_NO_RESPONSE 0x07U
 
+/* The RnW bit of an SWD request, as built by make_packet_request() */
+#define SWDP_REQUEST_RnW 0x04U
+
 typedef enum align {
 	ALIGN_BYTE = 0,
 	ALIGN_HALFWORD = 1,
@@ -189,6 +192,64 @@ typedef enum align {
 typedef struct adiv5_access_port adiv5_access_port_s;
 typedef struct adiv5_debug_port adiv5_debug_port_s;
 
+/* Kinds of access that can be queued into an ADIv5 transaction batch */
+typedef enum adiv5_batch_op {
+	ADIV5_BATCH_DP_READ = 0,
+	ADIV5_BATCH_AP_READ = 1,
+	ADIV5_BATCH_AP_WRITE = 2,
+	ADIV5_BATCH_LOW_READ = 3,
+	ADIV5_BATCH_LOW_WRITE = 4,
+} adiv5_batch_op_e;
+
+typedef struct adiv5_batch_entry {
+	adiv5_batch_op_e op;
+	uint16_t addr;
+	uint32_t value;
+	/* Where to store the result of a read, or NULL if it's not wanted */
+	uint32_t *result;
+} adiv5_batch_entry_s;
+
+/*
+ * Under BMDA, batches are sent to the probe in as few requests as possible,
+ * so let them grow large. In firmware they're only a convenience so keep them small.
+ */
+#if PC_HOSTED == 1
+#define ADIV5_BATCH_MAX_ENTRIES 64U
+#else
+#define ADIV5_BATCH_MAX_ENTRIES 8U
+#endif
+
+typedef struct adiv5_batch {
+	adiv5_access_port_s *ap;
+	/* How many entries are waiting in the queue */
+	size_t queued;
+	/* How many entries have been issued so far, including those flushed already */
+	size_t issued;
+	/* Index of the first entry that faulted, or SIZE_MAX if none have */
+	size_t fault_index;
+	adiv5_batch_entry_s entries[ADIV5_BATCH_MAX_ENTRIES];
+} adiv5_batch_s;
+
+/*
+ * How transfers are clocked. Most targets are fine with transfers back to back, but the ADIv5
+ * spec plays it safe, so these are tunable per board. Each DP takes a copy of adiv5_transfer_policy
+ * when it's found, so changes apply from the next scan.
+ */
+typedef struct adiv5_transfer_policy {
+	/* Idle cycles clocked after each write, or ADIV5_IDLE_CYCLES_DEFAULT to leave it up to the interface */
+	uint8_t idle_cycles;
+	/* How many WAIT responses to retry before giving up, 0 to leave it up to the interface */
+	uint16_t wait_retries;
+} adiv5_transfer_policy_s;
+
+/* Natively that's 8 idle cycles after each write, CMSIS-DAP adaptors get 2 after every transfer */
+#define ADIV5_IDLE_CYCLES_DEFAULT 0xffU
+#define ADIV5_IDLE_CYCLES_WRITE   8U
+/* The most idle cycles that can be asked for, as sequences are at most 32 cycles long */
+#define ADIV5_IDLE_CYCLES_MAX 32U
+
+extern adiv5_transfer_policy_s adiv5_transfer_policy;
+
 /* Try to keep this somewhat absract for later adding SW-DP */
 struct adiv5_debug_port {
 	int refcnt;
@@ -208,6 +269,13 @@ struct adiv5_debug_port {
 	void (*ap_reg_write)(adiv5_access_port_s *ap, int num, uint32_t value);
 	void (*read_block)(uint32_t addr, uint8_t *data, int size);
 	void (*dap_write_block_sized)(uint32_t addr, uint8_t *data, int size, align_e align);
+	/* Perform a list of accesses back to back, returning how many completed before a fault */
+	size_t (*batch_access)(adiv5_access_port_s *ap, adiv5_batch_entry_s *entries, size_t count);
+	/* Poll a 32-bit memory location until (value & mask) == match, or the timeout expires */
+	bool (*mem32_wait)(
+		adiv5_access_port_s *ap, uint32_t addr, uint32_t mask, uint32_t match, uint32_t timeout_ms, uint32_t *value);
+	/* low_access always goes to AP 0 for AP registers (HLA adaptors), so only ap_read/ap_write reach other APs */
+	bool low_access_ap0_only;
 #endif
 	uint32_t (*ap_read)(adiv5_access_port_s *ap, uint16_t addr);
 	void (*ap_write)(adiv5_access_port_s *ap, uint16_t addr, uint32_t value);
@@ -217,6 +285,14 @@ struct adiv5_debug_port {
 	uint8_t dev_index;
 	uint8_t fault;
 
+	/*
+	 * JTAG-DP only: the last value written to SELECT if it's known, and whether the selected AP has been
+	 * used as a MEM-AP since, which lets posted AP reads be collected without switching the IR to DPACC
+	 */
+	uint32_t jtag_select;
+	bool jtag_select_valid;
+	bool jtag_mem_ap_selected;
+
 	/* targetsel DPv2 */
 	uint8_t instance;
 	uint32_t targetsel;
@@ -232,6 +308,8 @@ struct adiv5_debug_port {
 	/* TARGETID designer and partno, present on DPv2 */
 	uint16_t target_designer_code;
 	uint16_t target_partno;
+
+	adiv5_transfer_policy_s transfer_policy;
 };
 
 struct adiv5_access_port {
@@ -243,6 +321,8 @@ struct adiv5_access_port {
 	uint32_t idr;
 	uint32_t base;
 	uint32_t csw;
+	/* Set if the AP can pack several byte or halfword accesses into one DRW access */
+	bool packed_transfers;
 	uint32_t ap_cortexm_demcr; /* Copy of demcr when starting */
 	uint32_t ap_storage;       /* E.g to hold STM32F7 initial DBGMCU_CR value.*/
 
@@ -346,12 +426,21 @@ uint64_t adiv5_ap_read_pidr(adiv5_access_port_s *ap, uint32_t addr);
 void *adiv5_unpack_data(void *dest, uint32_t src, uint32_t val, align_e align);
 const void *adiv5_pack_data(uint32_t dest, const void *src, uint32_t *data, align_e align);
 
+uint32_t adiv5_batch_access(adiv5_access_port_s *ap, adiv5_batch_op_e op, uint16_t addr, uint32_t value);
+void adiv5_batch_init(adiv5_batch_s *batch, adiv5_access_port_s *ap);
+void adiv5_batch_queue(adiv5_batch_s *batch, adiv5_batch_op_e op, uint16_t addr, uint32_t value, uint32_t *result);
+size_t adiv5_batch_flush(adiv5_batch_s *batch);
+bool adiv5_mem32_wait(
+	adiv5_access_port_s *ap, uint32_t addr, uint32_t mask, uint32_t match, uint32_t timeout_ms, uint32_t *value);
+
 void ap_mem_access_setup(adiv5_access_port_s *ap, uint32_t addr, align_e align);
+size_t adiv5_packed_split(const adiv5_access_port_s *ap, uint32_t addr, size_t len, align_e align, size_t *head);
 void adiv5_mem_write_bytes(adiv5_access_port_s *ap, uint32_t dest, const void *src, size_t len, align_e align);
 void advi5_mem_read_bytes(adiv5_access_port_s *ap, void *dest, uint32_t src, size_t len);
 void firmware_ap_write(adiv5_access_port_s *ap, uint16_t addr, uint32_t value);
 uint32_t firmware_ap_read(adiv5_access_port_s *ap, uint16_t addr);
 uint32_t firmware_swdp_low_access(adiv5_debug_port_s *dp, uint8_t RnW, uint16_t addr, uint32_t value);
+uint8_t firmware_swdp_transfer(uint8_t request, uint32_t *data, bool *parity_error, uint8_t idle_cycles);
 uint32_t fw_adiv5_jtagdp_low_access(adiv5_debug_port_s *dp, uint8_t RnW, uint16_t addr, uint32_t value);
 uint32_t firmware_swdp_read(adiv5_debug_port_s *dp, uint16_t addr);
 uint32_t fw_adiv5_jtagdp_read(adiv5_debug_port_s *dp, uint16_t addr);
@@ -360,5 +449,6 @@ uint32_t firmware_swdp_error(adiv5_debug_port_s *dp, bool protocol_recovery);
 
 void firmware_swdp_abort(adiv5_debug_port_s *dp, uint32_t abort);
 void adiv5_jtagdp_abort(adiv5_debug_port_s *dp, uint32_t abort);
+void adiv5_jtagdp_select_invalidate(adiv5_debug_port_s *dp);
 
 #endif /* TARGET_ADIV5_H */
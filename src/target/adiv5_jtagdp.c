@@ -37,6 +37,9 @@
 #define IR_DPACC 0xaU
 #define IR_APACC 0xbU
 
+/* The APBANKSEL field of SELECT */
+#define JTAGDP_SELECT_APBANK_MASK 0x000000f0U
+
 static uint32_t adiv5_jtagdp_error(adiv5_debug_port_s *dp, bool protocol_recovery);
 
 void adiv5_jtag_dp_handler(const uint8_t dev_index)
@@ -64,6 +67,13 @@ void adiv5_jtag_dp_handler(const uint8_t dev_index)
 	adiv5_dp_init(dp, jtag_devs[dev_index].jd_idcode);
 }
 
+/* Forget what we know about SELECT, for when an access may not have had the effect we expected */
+void adiv5_jtagdp_select_invalidate(adiv5_debug_port_s *const dp)
+{
+	dp->jtag_select_valid = false;
+	dp->jtag_mem_ap_selected = false;
+}
+
 uint32_t fw_adiv5_jtagdp_read(adiv5_debug_port_s *dp, uint16_t addr)
 {
 	fw_adiv5_jtagdp_low_access(dp, ADIV5_LOW_READ, addr, 0);
@@ -73,6 +83,7 @@ uint32_t fw_adiv5_jtagdp_read(adiv5_debug_port_s *dp, uint16_t addr)
 static uint32_t adiv5_jtagdp_error(adiv5_debug_port_s *dp, const bool protocol_recovery)
 {
 	(void)protocol_recovery;
+	adiv5_jtagdp_select_invalidate(dp);
 	const uint32_t status = adiv5_dp_read(dp, ADIV5_DP_CTRLSTAT) & ADIV5_DP_CTRLSTAT_ERRMASK;
 	dp->fault = 0;
 	return adiv5_dp_low_access(dp, ADIV5_LOW_WRITE, ADIV5_DP_CTRLSTAT, status) & 0x32U;
@@ -80,9 +91,29 @@ static uint32_t adiv5_jtagdp_error(adiv5_debug_port_s *dp, const bool protocol_r
 
 uint32_t fw_adiv5_jtagdp_low_access(adiv5_debug_port_s *dp, uint8_t RnW, uint16_t addr, uint32_t value)
 {
-	const bool APnDP = addr & ADIV5_APnDP;
+	bool APnDP = addr & ADIV5_APnDP;
 	addr &= 0xffU;
 
+	if (!APnDP && !RnW && addr == ADIV5_DP_SELECT) {
+		/* SELECT holds its value until written again, so don't spend a scan rewriting what it already holds */
+		if (dp->jtag_select_valid && value == dp->jtag_select)
+			return 0;
+		dp->jtag_select = value;
+		dp->jtag_select_valid = true;
+		dp->jtag_mem_ap_selected = false;
+	} else if (!APnDP && RnW && addr == ADIV5_DP_RDBUFF && dp->jtag_mem_ap_selected &&
+		jtag_devs[dp->dev_index].current_ir == IR_APACC) {
+		/*
+		 * RDBUFF only exists to have a scan whose response carries the previous read's result. Reading
+		 * CSW does the same without side effects and keeps the IR on APACC, so a run of AP accesses
+		 * doesn't pay for two IR scans each time its posted reads are collected.
+		 */
+		APnDP = true;
+		addr = ADIV5_AP_CSW & 0xffU;
+	} else if (APnDP && addr == (ADIV5_AP_DRW & 0xffU) && dp->jtag_select_valid &&
+		!(dp->jtag_select & JTAGDP_SELECT_APBANK_MASK))
+		dp->jtag_mem_ap_selected = true;
+
 	const uint64_t request = ((uint64_t)value << 3U) | ((addr >> 1U) & 0x06U) | (RnW ? 1U : 0U);
 
 	uint32_t result;
@@ -94,7 +125,8 @@ uint32_t fw_adiv5_jtagdp_low_access(adiv5_debug_port_s *dp, uint8_t RnW, uint16_
 	platform_timeout_set(&timeout, 250);
 	do {
 		uint64_t response;
-		jtag_dev_shift_dr(dp->dev_index, (uint8_t *)&response, (uint8_t *)&request, 35);
+		/* The DAP starts the access on Update-DR, so there's no need to pass through Run-Test/Idle */
+		jtag_dev_shift_dr_chained(dp->dev_index, (uint8_t *)&response, (uint8_t *)&request, 35);
 		result = response >> 3U;
 		ack = response & 0x07U;
 	} while (!platform_timeout_is_expired(&timeout) && ack == JTAGDP_ACK_WAIT);
@@ -107,6 +139,7 @@ uint32_t fw_adiv5_jtagdp_low_access(adiv5_debug_port_s *dp, uint8_t RnW, uint16_
 	}
 
 	if (ack != JTAGDP_ACK_OK) {
+		adiv5_jtagdp_select_invalidate(dp);
 		DEBUG_ERROR("JTAG access resulted in: %" PRIx32 ":%x\n", result, ack);
 		raise_exception(EXCEPTION_ERROR, "JTAG-DP invalid ACK");
 	}
@@ -117,6 +150,7 @@ uint32_t fw_adiv5_jtagdp_low_access(adiv5_debug_port_s *dp, uint8_t RnW, uint16_
 void adiv5_jtagdp_abort(adiv5_debug_port_s *dp, uint32_t abort)
 {
 	uint64_t request = (uint64_t)abort << 3U;
+	adiv5_jtagdp_select_invalidate(dp);
 	jtag_dev_write_ir(dp->dev_index, IR_ABORT);
 	jtag_dev_shift_dr(dp->dev_index, NULL, (const uint8_t *)&request, 35);
 }
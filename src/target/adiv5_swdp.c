@@ -30,6 +30,12 @@
 #include "target.h"
 #include "target_internal.h"
 
+/* The transfer policy newly found DPs start out with */
+adiv5_transfer_policy_s adiv5_transfer_policy = {
+	.idle_cycles = ADIV5_IDLE_CYCLES_DEFAULT,
+	.wait_retries = 0U,
+};
+
 uint8_t make_packet_request(uint8_t RnW, uint16_t addr)
 {
 	bool APnDP = addr & ADIV5_APnDP;
@@ -95,6 +101,7 @@ uint32_t adiv5_swdp_scan(uint32_t targetid)
 		.dp_read = firmware_swdp_read,
 		.low_access = firmware_swdp_low_access,
 		.abort = firmware_swdp_abort,
+		.transfer_policy = adiv5_transfer_policy,
 	};
 	adiv5_debug_port_s *initial_dp = &idp;
 
@@ -252,19 +259,65 @@ uint32_t firmware_swdp_error(adiv5_debug_port_s *dp, const bool protocol_recover
 	return err;
 }
 
+/* Perform a transfer a sequence at a time, for interfaces that don't provide a fused swd_proc.transfer() */
+static uint8_t swdp_transfer_seq(
+	const uint8_t request, uint32_t *const data, bool *const parity_error, const uint8_t idle_cycles)
+{
+	swd_proc.seq_out(request, 8);
+	const uint8_t ack = swd_proc.seq_in(3);
+	if (ack != SWDP_ACK_OK)
+		return ack;
+
+	if (request & SWDP_REQUEST_RnW)
+		*parity_error = swd_proc.seq_in_parity(data, 32);
+	else {
+		swd_proc.seq_out_parity(*data, 32);
+		/* ARM Debug Interface Architecture Specification ADIv5.0 to ADIv5.2
+		 * tells to clock the data through SW-DP to either :
+		 * - immediate start a new transaction
+		 * - continue to drive idle cycles
+		 * - or clock at least 8 idle cycles
+		 *
+		 * The transfer policy picks which, defaulting to the last option to
+		 *   favour correctness over slight speed decrease
+		 */
+		if (idle_cycles)
+			swd_proc.seq_out(0, idle_cycles);
+	}
+	return ack;
+}
+
+/* Perform a transfer using the interface's fused swd_proc.transfer() where it has one */
+uint8_t firmware_swdp_transfer(
+	const uint8_t request, uint32_t *const data, bool *const parity_error, const uint8_t idle_cycles)
+{
+	if (swd_proc.transfer)
+		return swd_proc.transfer(request, data, parity_error, idle_cycles);
+	return swdp_transfer_seq(request, data, parity_error, idle_cycles);
+}
+
 uint32_t firmware_swdp_low_access(adiv5_debug_port_s *dp, const uint8_t RnW, const uint16_t addr, const uint32_t value)
 {
 	if ((addr & ADIV5_APnDP) && dp->fault)
 		return 0;
 
 	const uint8_t request = make_packet_request(RnW, addr);
-	uint32_t response = 0;
+	const adiv5_transfer_policy_s *const policy = &dp->transfer_policy;
+	const uint8_t idle_cycles =
+		policy->idle_cycles == ADIV5_IDLE_CYCLES_DEFAULT ? ADIV5_IDLE_CYCLES_WRITE : policy->idle_cycles;
+	uint32_t data = 0;
+	bool parity_error = false;
 	uint8_t ack = SWDP_ACK_WAIT;
+	/* Without a retry budget, WAITs are retried for as long as the timeout allows */
+	uint32_t waits = 0;
 	platform_timeout_s timeout;
 	platform_timeout_set(&timeout, 250);
 	do {
-		swd_proc.seq_out(request, 8);
-		ack = swd_proc.seq_in(3);
+		/* The request, its ACK and the data phase (if the ACK was OK) all go out in one transfer */
+		data = value;
+		ack = firmware_swdp_transfer(request, &data, &parity_error, idle_cycles);
+		if (ack == SWDP_ACK_WAIT && policy->wait_retries && waits++ >= policy->wait_retries)
+			break;
 		if (ack == SWDP_ACK_FAULT) {
 			DEBUG_ERROR("SWD access resulted in fault, retrying\n");
 			/* On fault, abort the request and repeat */
@@ -299,26 +352,14 @@ uint32_t firmware_swdp_low_access(adiv5_debug_port_s *dp, const uint8_t RnW, con
 		raise_exception(EXCEPTION_ERROR, "SWD invalid ACK");
 	}
 
-	if (RnW) {
-		if (swd_proc.seq_in_parity(&response, 32)) { /* Give up on parity error */
-			dp->fault = 1;
-			DEBUG_ERROR("SWD access resulted in parity error\n");
-			raise_exception(EXCEPTION_ERROR, "SWD parity error");
-		}
-	} else {
-		swd_proc.seq_out_parity(value, 32);
-		/* ARM Debug Interface Architecture Specification ADIv5.0 to ADIv5.2
-		 * tells to clock the data through SW-DP to either :
-		 * - immediate start a new transaction
-		 * - continue to drive idle cycles
-		 * - or clock at least 8 idle cycles
-		 *
-		 * Implement last option to favour correctness over
-		 *   slight speed decrease
-		 */
-		swd_proc.seq_out(0, 8);
+	if (!RnW)
+		return 0;
+	if (parity_error) { /* Give up on parity error */
+		dp->fault = 1;
+		DEBUG_ERROR("SWD access resulted in parity error\n");
+		raise_exception(EXCEPTION_ERROR, "SWD parity error");
 	}
-	return response;
+	return data;
 }
 
 void firmware_swdp_abort(adiv5_debug_port_s *dp, uint32_t abort)
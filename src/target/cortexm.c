@@ -72,12 +72,15 @@
 static const char cortexm_driver_str[] = "ARM Cortex-M";
 
 static bool cortexm_vector_catch(target_s *t, int argc, const char **argv);
+static bool cortexm_cache_setway(target_s *t, int argc, const char **argv);
 #if PC_HOSTED == 0
 static bool cortexm_redirect_stdout(target_s *t, int argc, const char **argv);
 #endif
 
 const command_s cortexm_cmd_list[] = {
 	{"vector_catch", cortexm_vector_catch, "Catch exception vectors"},
+	{"cache_setway", cortexm_cache_setway,
+		"Clean the whole D-cache by set/way for accesses larger than this many bytes: (bytes|disable)"},
 #if PC_HOSTED == 0
 	{"redirect_stdout", cortexm_redirect_stdout, "Redirect semihosting stdout to USB UART"},
 #endif
@@ -109,8 +112,24 @@ static target_addr_t cortexm_check_watch(target_s *t);
 
 static int cortexm_hostio_request(target_s *t);
 
+static bool cortexm_crc32(target_s *t, uint32_t *crc_res, target_addr_t base, size_t len);
+
+static const uint16_t cortexm_crc32_stub[] = {
+#include "flashstub/crc32.stub"
+};
+
+/*
+ * How much memory to CRC per stub run. The stub takes roughly 25 cycles a byte, so this keeps
+ * each run comfortably inside cortexm_run_stub()'s timeout even on a slowly clocked part
+ */
+#define CORTEXM_CRC32_CHUNK_SIZE 0x10000U
+
 static uint32_t time0_sec = UINT32_MAX; /* sys_clock time origin */
 
+/* Number of registers in regnum_cortex_m and regnum_cortex_mf respectively */
+#define CORTEXM_GENERAL_REG_COUNT 20U
+#define CORTEXM_FLOAT_REG_COUNT   33U
+
 typedef struct cortexm_priv {
 	adiv5_access_port_s *ap;
 	bool stepping;
@@ -127,10 +146,19 @@ typedef struct cortexm_priv {
 	/* Cache parameters */
 	bool has_cache;
 	uint32_t dcache_minline;
+	/* L1 data cache geometry, for set/way maintenance */
+	uint32_t dcache_sets;
+	uint32_t dcache_ways;
+	uint8_t dcache_line_shift;
+	/* Clean the whole cache by set/way rather than by address for ranges larger than this, 0 to never do so */
+	size_t dcache_setway_threshold;
+	/* Snapshot of the register file for the current halt, valid until the core resumes or a register is written */
+	bool reg_cache_valid;
+	uint32_t reg_cache[CORTEXM_GENERAL_REG_COUNT + CORTEXM_FLOAT_REG_COUNT];
 } cortexm_priv_s;
 
 /* Register number tables */
-static const uint32_t regnum_cortex_m[] = {
+static const uint32_t regnum_cortex_m[CORTEXM_GENERAL_REG_COUNT] = {
 	0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, /* standard r0-r15 */
 	0x10,                                                 /* xpsr */
 	0x11,                                                 /* msp */
@@ -138,7 +166,7 @@ static const uint32_t regnum_cortex_m[] = {
 	0x14,                                                 /* special */
 };
 
-static const uint32_t regnum_cortex_mf[] = {
+static const uint32_t regnum_cortex_mf[CORTEXM_FLOAT_REG_COUNT] = {
 	0x21,                                           /* fpscr */
 	0x40, 0x41, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47, /* s0-s7 */
 	0x48, 0x49, 0x4a, 0x4b, 0x4c, 0x4d, 0x4e, 0x4f, /* s8-s15 */
@@ -446,6 +474,55 @@ adiv5_access_port_s *cortexm_ap(target_s *t)
 	return ((cortexm_priv_s *)t->priv)->ap;
 }
 
+/*
+ * Cache maintenance streams writes to TAR and DRW through low_access, which has to reach the core's AP.
+ * That's not the case on adaptors whose low_access only talks to AP 0, so those fall back to memory writes.
+ */
+static bool cortexm_cache_can_stream(const adiv5_access_port_s *const ap)
+{
+#if PC_HOSTED == 1
+	if (ap->dp->low_access_ap0_only && ap->apsel != 0U)
+		return false;
+#else
+	(void)ap;
+#endif
+	return true;
+}
+
+/* Clean (and optionally invalidate) the entire L1 data cache by set/way */
+static void cortexm_cache_clean_setway(target_s *const t, const bool invalidate)
+{
+	cortexm_priv_s *const priv = t->priv;
+	adiv5_access_port_s *const ap = cortexm_ap(t);
+	/* The way number sits in the top bits of the register, the set number just above the line offset */
+	const uint8_t way_shift = priv->dcache_ways > 1U ? __builtin_clz(priv->dcache_ways - 1U) : 0U;
+
+	adiv5_batch_s batch;
+	adiv5_batch_init(&batch, ap);
+	adiv5_batch_queue(&batch, ADIV5_BATCH_AP_WRITE, ADIV5_AP_CSW,
+		ap->csw | ADIV5_AP_CSW_SIZE_WORD | ADIV5_AP_CSW_ADDRINC_NONE, NULL);
+	adiv5_batch_queue(&batch, ADIV5_BATCH_LOW_WRITE, ADIV5_AP_TAR, invalidate ? CORTEXM_DCCISW : CORTEXM_DCCSW, NULL);
+	for (uint32_t way = 0; way < priv->dcache_ways; ++way) {
+		const uint32_t way_bits = priv->dcache_ways > 1U ? way << way_shift : 0U;
+		for (uint32_t set = 0; set < priv->dcache_sets; ++set)
+			adiv5_batch_queue(
+				&batch, ADIV5_BATCH_LOW_WRITE, ADIV5_AP_DRW, way_bits | (set << priv->dcache_line_shift), NULL);
+	}
+	adiv5_batch_flush(&batch);
+}
+
+/* Intersect [addr, mem_end) with a RAM region as [*ram, *ram_end), which is empty if *ram >= *ram_end */
+static void cortexm_cache_ram_intersect(const target_ram_s *const r, const target_addr_t addr,
+	const target_addr_t mem_end, target_addr_t *const ram, target_addr_t *const ram_end)
+{
+	*ram = r->start;
+	*ram_end = r->start + r->length;
+	if (addr > *ram)
+		*ram = addr;
+	if (mem_end < *ram_end)
+		*ram_end = mem_end;
+}
+
 static void cortexm_cache_clean(target_s *t, target_addr_t addr, size_t len, bool invalidate)
 {
 	cortexm_priv_s *priv = t->priv;
@@ -454,21 +531,56 @@ static void cortexm_cache_clean(target_s *t, target_addr_t addr, size_t len, boo
 	uint32_t cache_reg = invalidate ? CORTEXM_DCCIMVAC : CORTEXM_DCCMVAC;
 	size_t minline = priv->dcache_minline;
 
-	/* flush data cache for RAM regions that intersect requested region */
+	/* Only RAM regions that intersect the requested region [addr, mem_end) need their lines cleaning */
 	target_addr_t mem_end = addr + len; /* following code is NOP if wraparound */
-	/* requested region is [src, src_end) */
+	/* Find out how much of the requested region is RAM, and so might be cached, nothing to do if none */
+	size_t cached_len = 0U;
+	for (target_ram_s *r = t->ram; r; r = r->next) {
+		target_addr_t ram;
+		target_addr_t ram_end;
+		cortexm_cache_ram_intersect(r, addr, mem_end, &ram, &ram_end);
+		if (ram < ram_end)
+			cached_len += ram_end - ram;
+	}
+	if (!cached_len)
+		return;
+
+	adiv5_access_port_s *const ap = cortexm_ap(t);
+	const bool stream = cortexm_cache_can_stream(ap);
+	/* For large enough ranges, it's cheaper to clean the whole cache by set/way than each line by address */
+	if (stream && priv->dcache_setway_threshold && cached_len > priv->dcache_setway_threshold) {
+		cortexm_cache_clean_setway(t, invalidate);
+		return;
+	}
+
+	/*
+	 * Set the AP up to not auto-increment so TAR stays pointed at the maintenance register,
+	 * then stream the address of each line to clean through DRW
+	 */
+	adiv5_batch_s batch;
+	adiv5_batch_init(&batch, ap);
+	bool ap_setup = false;
+
 	for (target_ram_s *r = t->ram; r; r = r->next) {
-		target_addr_t ram = r->start;
-		target_addr_t ram_end = r->start + r->length;
-		/* RAM region is [ram, ram_end) */
-		if (addr > ram)
-			ram = addr;
-		if (mem_end < ram_end)
-			ram_end = mem_end;
-		/* intersection is [ram, ram_end) */
-		for (ram &= ~(minline - 1U); ram < ram_end; ram += minline)
-			adiv5_mem_write(cortexm_ap(t), cache_reg, &ram, 4);
+		target_addr_t ram;
+		target_addr_t ram_end;
+		cortexm_cache_ram_intersect(r, addr, mem_end, &ram, &ram_end);
+		for (ram &= ~(minline - 1U); ram < ram_end; ram += minline) {
+			if (!stream) {
+				adiv5_mem_write(ap, cache_reg, &ram, sizeof(ram));
+				continue;
+			}
+			if (!ap_setup) {
+				adiv5_batch_queue(&batch, ADIV5_BATCH_AP_WRITE, ADIV5_AP_CSW,
+					ap->csw | ADIV5_AP_CSW_SIZE_WORD | ADIV5_AP_CSW_ADDRINC_NONE, NULL);
+				adiv5_batch_queue(&batch, ADIV5_BATCH_LOW_WRITE, ADIV5_AP_TAR, cache_reg, NULL);
+				ap_setup = true;
+			}
+			adiv5_batch_queue(&batch, ADIV5_BATCH_LOW_WRITE, ADIV5_AP_DRW, ram, NULL);
+		}
 	}
+	if (ap_setup)
+		adiv5_batch_flush(&batch);
 }
 
 static void cortexm_mem_read(target_s *t, void *dest, target_addr_t src, size_t len)
@@ -483,6 +595,13 @@ static void cortexm_mem_write(target_s *t, target_addr_t dest, const void *src,
 	adiv5_mem_write(cortexm_ap(t), dest, src, len);
 }
 
+static bool cortexm_mem32_wait(target_s *const t, const target_addr_t addr, const uint32_t mask, const uint32_t match,
+	const uint32_t timeout_ms, uint32_t *const value)
+{
+	cortexm_cache_clean(t, addr, sizeof(uint32_t), false);
+	return adiv5_mem32_wait(cortexm_ap(t), addr, mask, match, timeout_ms, value);
+}
+
 static bool cortexm_check_error(target_s *t)
 {
 	adiv5_access_port_s *ap = cortexm_ap(t);
@@ -591,6 +710,7 @@ bool cortexm_probe(adiv5_access_port_s *ap)
 	t->check_error = cortexm_check_error;
 	t->mem_read = cortexm_mem_read;
 	t->mem_write = cortexm_mem_write;
+	t->mem32_wait = cortexm_mem32_wait;
 
 	t->driver = cortexm_driver_str;
 
@@ -621,6 +741,7 @@ bool cortexm_probe(adiv5_access_port_s *ap)
 
 	t->breakwatch_set = cortexm_breakwatch_set;
 	t->breakwatch_clear = cortexm_breakwatch_clear;
+	t->crc32 = cortexm_crc32;
 
 	target_add_commands(t, cortexm_cmd_list, cortexm_driver_str);
 
@@ -637,6 +758,17 @@ bool cortexm_probe(adiv5_access_port_s *ap)
 	if (ctr >> 29U == 4U) {
 		priv->has_cache = true;
 		priv->dcache_minline = 4U << (ctr & 0xfU);
+		/* Select the L1 data cache and read out its geometry */
+		target_mem_write32(t, CORTEXM_CSSELR, 0U);
+		const uint32_t ccsidr = target_mem_read32(t, CORTEXM_CCSIDR);
+		priv->dcache_sets = CORTEXM_CCSIDR_NUMSETS(ccsidr);
+		priv->dcache_ways = CORTEXM_CCSIDR_ASSOCIATIVITY(ccsidr);
+		priv->dcache_line_shift = CORTEXM_CCSIDR_LINESIZE(ccsidr);
+		/*
+		 * By default, switch to set/way maintenance once a range has more lines in it than the cache
+		 * has, as at that point cleaning everything takes fewer operations
+		 */
+		priv->dcache_setway_threshold = (priv->dcache_sets * priv->dcache_ways) * priv->dcache_minline;
 	} else
 		target_check_error(t);
 
@@ -780,6 +912,7 @@ bool cortexm_attach(target_s *t)
 	/* Clear any pending fault condition */
 	target_check_error(t);
 
+	cortexm_regs_invalidate(t);
 	target_halt_request(t);
 	/* Request halt on reset */
 	target_mem_write32(t, CORTEXM_DEMCR, priv->demcr);
@@ -849,6 +982,7 @@ void cortexm_detach(target_s *t)
 	adiv5_access_port_s *ap = cortexm_ap(t);
 	target_mem_write32(t, CORTEXM_DEMCR, ap->ap_cortexm_demcr);
 	/* Resume target and disable debug, re-enabling interrupts in the process */
+	cortexm_regs_invalidate(t);
 	target_mem_write32(t, CORTEXM_DHCSR, CORTEXM_DHCSR_DBGKEY | CORTEXM_DHCSR_C_DEBUGEN | CORTEXM_DHCSR_C_HALT);
 	target_mem_write32(t, CORTEXM_DHCSR, CORTEXM_DHCSR_DBGKEY | CORTEXM_DHCSR_C_DEBUGEN);
 	target_mem_write32(t, CORTEXM_DHCSR, CORTEXM_DHCSR_DBGKEY);
@@ -861,51 +995,92 @@ enum {
 	DB_DEMCR
 };
 
-static void cortexm_regs_read(target_s *t, void *data)
+/*
+ * Queue reads of the core registers listed in regnums through DCRSR and DCRDR. The banked data registers
+ * must already be mapped onto the debug registers through TAR. If switch_bank is set, the first access
+ * also switches the AP over to the bank they're in.
+ */
+static void cortexm_regs_queue_read(adiv5_batch_s *const batch, const uint32_t *const regnums, const size_t count,
+	uint32_t *regs, const bool switch_bank)
+{
+	for (size_t i = 0; i < count; i++) {
+		adiv5_batch_queue(batch, i == 0U && switch_bank ? ADIV5_BATCH_AP_WRITE : ADIV5_BATCH_LOW_WRITE,
+			ADIV5_AP_DB(DB_DCRSR), regnums[i], NULL);
+		adiv5_batch_queue(batch, ADIV5_BATCH_DP_READ, ADIV5_AP_DB(DB_DCRDR), 0, regs++);
+	}
+}
+
+/* Read the whole register file from the core, returning false if any of the accesses faulted */
+static bool cortexm_regs_fetch(target_s *t, uint32_t *regs)
 {
-	uint32_t *regs = data;
 	adiv5_access_port_s *ap = cortexm_ap(t);
+	const bool has_fpu = t->target_options & TOPT_FLAVOUR_V7MF;
+	bool base_regs_read = false;
 #if PC_HOSTED == 1
 	if (ap->dp->ap_reg_read && ap->dp->ap_regs_read) {
 		uint32_t base_regs[21];
 		ap->dp->ap_regs_read(ap, base_regs);
 		for (size_t i = 0; i < sizeof(regnum_cortex_m) / 4U; i++)
 			*regs++ = base_regs[regnum_cortex_m[i]];
-		if (t->target_options & TOPT_FLAVOUR_V7MF)
+		/* Without batch support, a request per FP register is still cheaper than a batch run access by access */
+		if (has_fpu && !ap->dp->batch_access) {
 			for (size_t i = 0; i < sizeof(regnum_cortex_mf) / 4U; i++)
 				*regs++ = ap->dp->ap_reg_read(ap, regnum_cortex_mf[i]);
-	} else
+		}
+		if (!has_fpu || !ap->dp->batch_access)
+			return !ap->dp->fault;
+		base_regs_read = true;
+	}
 #endif
-	{
-		/* FIXME: Describe what's really going on here */
-		adiv5_ap_write(ap, ADIV5_AP_CSW, ap->csw | ADIV5_AP_CSW_SIZE_WORD);
+	/*
+	 * Queue all the accesses needed into a batch so that probes able to
+	 * perform them back to back can do so without a round trip per access
+	 */
+	adiv5_batch_s batch;
+	adiv5_batch_init(&batch, ap);
+	/* FIXME: Describe what's really going on here */
+	adiv5_batch_queue(&batch, ADIV5_BATCH_AP_WRITE, ADIV5_AP_CSW, ap->csw | ADIV5_AP_CSW_SIZE_WORD, NULL);
+
+	/* Map the banked data registers (0x10-0x1c) to the
+	 * debug registers DHCSR, DCRSR, DCRDR and DEMCR respectively */
+	adiv5_batch_queue(&batch, ADIV5_BATCH_LOW_WRITE, ADIV5_AP_TAR, CORTEXM_DHCSR, NULL);
+
+	/* Walk the regnum_cortex_m array, reading the registers it calls out, then the FP ones if present */
+	if (!base_regs_read) {
+		cortexm_regs_queue_read(&batch, regnum_cortex_m, ARRAY_LENGTH(regnum_cortex_m), regs, true);
+		regs += ARRAY_LENGTH(regnum_cortex_m);
+	}
+	if (has_fpu)
+		cortexm_regs_queue_read(&batch, regnum_cortex_mf, ARRAY_LENGTH(regnum_cortex_mf), regs, base_regs_read);
+	adiv5_batch_flush(&batch);
+	return batch.fault_index == SIZE_MAX;
+}
 
-		/* Map the banked data registers (0x10-0x1c) to the
-		 * debug registers DHCSR, DCRSR, DCRDR and DEMCR respectively */
-		adiv5_dp_low_access(ap->dp, ADIV5_LOW_WRITE, ADIV5_AP_TAR, CORTEXM_DHCSR);
+/*
+ * The register file only changes while the core runs or when it's written, so it's read once per halt
+ * and kept, letting GDB's register reads, semihosting and fault unwinding all share the one snapshot.
+ */
+static void cortexm_regs_read(target_s *t, void *data)
+{
+	cortexm_priv_s *const priv = t->priv;
+	if (!priv->reg_cache_valid)
+		priv->reg_cache_valid = cortexm_regs_fetch(t, priv->reg_cache);
+	memcpy(data, priv->reg_cache, t->regs_size);
+}
 
-		/* Walk the regnum_cortex_m array, reading the registers it
-		 * calls out. */
-		adiv5_ap_write(ap, ADIV5_AP_DB(DB_DCRSR), regnum_cortex_m[0]);
-		/* Required to switch banks */
-		*regs++ = adiv5_dp_read(ap->dp, ADIV5_AP_DB(DB_DCRDR));
-		for (size_t i = 1; i < sizeof(regnum_cortex_m) / 4U; i++) {
-			adiv5_dp_low_access(ap->dp, ADIV5_LOW_WRITE, ADIV5_AP_DB(DB_DCRSR), regnum_cortex_m[i]);
-			*regs++ = adiv5_dp_read(ap->dp, ADIV5_AP_DB(DB_DCRDR));
-		}
-		if (t->target_options & TOPT_FLAVOUR_V7MF) {
-			for (size_t i = 0; i < sizeof(regnum_cortex_mf) / 4U; i++) {
-				adiv5_dp_low_access(ap->dp, ADIV5_LOW_WRITE, ADIV5_AP_DB(DB_DCRSR), regnum_cortex_mf[i]);
-				*regs++ = adiv5_dp_read(ap->dp, ADIV5_AP_DB(DB_DCRDR));
-			}
-		}
-	}
+/* Drop the register snapshot, for when something outside this driver may have changed the registers */
+void cortexm_regs_invalidate(target_s *t)
+{
+	cortexm_priv_s *const priv = t->priv;
+	priv->reg_cache_valid = false;
 }
 
 static void cortexm_regs_write(target_s *t, const void *data)
 {
 	const uint32_t *regs = data;
 	adiv5_access_port_s *ap = cortexm_ap(t);
+	/* Writes to one register can show up in others (SP and MSP/PSP for example), so start afresh */
+	cortexm_regs_invalidate(t);
 #if PC_HOSTED == 1
 	if (ap->dp->ap_reg_write) {
 		for (size_t i = 0; i < sizeof(regnum_cortex_m) / 4U; i++) {
@@ -920,27 +1095,32 @@ static void cortexm_regs_write(target_s *t, const void *data)
 	} else
 #endif
 	{
+		adiv5_batch_s batch;
+		adiv5_batch_init(&batch, ap);
 		/* FIXME: Describe what's really going on here */
-		adiv5_ap_write(ap, ADIV5_AP_CSW, ap->csw | ADIV5_AP_CSW_SIZE_WORD);
+		adiv5_batch_queue(&batch, ADIV5_BATCH_AP_WRITE, ADIV5_AP_CSW, ap->csw | ADIV5_AP_CSW_SIZE_WORD, NULL);
 
 		/* Map the banked data registers (0x10-0x1c) to the
 		 * debug registers DHCSR, DCRSR, DCRDR and DEMCR respectively */
-		adiv5_dp_low_access(ap->dp, ADIV5_LOW_WRITE, ADIV5_AP_TAR, CORTEXM_DHCSR);
+		adiv5_batch_queue(&batch, ADIV5_BATCH_LOW_WRITE, ADIV5_AP_TAR, CORTEXM_DHCSR, NULL);
 		/* Walk the regnum_cortex_m array, writing the registers it
 		 * calls out. */
-		adiv5_ap_write(ap, ADIV5_AP_DB(DB_DCRDR), *regs++);
+		adiv5_batch_queue(&batch, ADIV5_BATCH_AP_WRITE, ADIV5_AP_DB(DB_DCRDR), *regs++, NULL);
 		/* Required to switch banks */
-		adiv5_dp_low_access(ap->dp, ADIV5_LOW_WRITE, ADIV5_AP_DB(DB_DCRSR), 0x10000 | regnum_cortex_m[0]);
+		adiv5_batch_queue(&batch, ADIV5_BATCH_LOW_WRITE, ADIV5_AP_DB(DB_DCRSR), 0x10000 | regnum_cortex_m[0], NULL);
 		for (size_t i = 1; i < sizeof(regnum_cortex_m) / 4U; i++) {
-			adiv5_dp_low_access(ap->dp, ADIV5_LOW_WRITE, ADIV5_AP_DB(DB_DCRDR), *regs++);
-			adiv5_dp_low_access(ap->dp, ADIV5_LOW_WRITE, ADIV5_AP_DB(DB_DCRSR), 0x10000 | regnum_cortex_m[i]);
+			adiv5_batch_queue(&batch, ADIV5_BATCH_LOW_WRITE, ADIV5_AP_DB(DB_DCRDR), *regs++, NULL);
+			adiv5_batch_queue(
+				&batch, ADIV5_BATCH_LOW_WRITE, ADIV5_AP_DB(DB_DCRSR), 0x10000 | regnum_cortex_m[i], NULL);
 		}
 		if (t->target_options & TOPT_FLAVOUR_V7MF) {
 			for (size_t i = 0; i < sizeof(regnum_cortex_mf) / 4U; i++) {
-				adiv5_dp_low_access(ap->dp, ADIV5_LOW_WRITE, ADIV5_AP_DB(DB_DCRDR), *regs++);
-				adiv5_dp_low_access(ap->dp, ADIV5_LOW_WRITE, ADIV5_AP_DB(DB_DCRSR), 0x10000 | regnum_cortex_mf[i]);
+				adiv5_batch_queue(&batch, ADIV5_BATCH_LOW_WRITE, ADIV5_AP_DB(DB_DCRDR), *regs++, NULL);
+				adiv5_batch_queue(
+					&batch, ADIV5_BATCH_LOW_WRITE, ADIV5_AP_DB(DB_DCRSR), 0x10000 | regnum_cortex_mf[i], NULL);
 			}
 		}
+		adiv5_batch_flush(&batch);
 	}
 }
 
@@ -965,6 +1145,11 @@ static ssize_t cortexm_reg_read(target_s *t, int reg, void *data, size_t max)
 	if (max < 4U)
 		return -1;
 	uint32_t *r = data;
+	const cortexm_priv_s *const priv = t->priv;
+	if (priv->reg_cache_valid && reg >= 0 && (size_t)reg < t->regs_size / 4U) {
+		*r = priv->reg_cache[reg];
+		return 4U;
+	}
 	target_mem_write32(t, CORTEXM_DCRSR, dcrsr_regnum(t, reg));
 	*r = target_mem_read32(t, CORTEXM_DCRDR);
 	return 4U;
@@ -975,6 +1160,7 @@ static ssize_t cortexm_reg_write(target_s *t, int reg, const void *data, size_t
 	if (max < 4U)
 		return -1;
 	const uint32_t *r = data;
+	cortexm_regs_invalidate(t);
 	target_mem_write32(t, CORTEXM_DCRDR, *r);
 	target_mem_write32(t, CORTEXM_DCRSR, CORTEXM_DCRSR_REGWnR | dcrsr_regnum(t, reg));
 	return 4U;
@@ -982,12 +1168,16 @@ static ssize_t cortexm_reg_write(target_s *t, int reg, const void *data, size_t
 
 static uint32_t cortexm_pc_read(target_s *t)
 {
+	const cortexm_priv_s *const priv = t->priv;
+	if (priv->reg_cache_valid)
+		return priv->reg_cache[REG_PC];
 	target_mem_write32(t, CORTEXM_DCRSR, 0x0f);
 	return target_mem_read32(t, CORTEXM_DCRDR);
 }
 
 static void cortexm_pc_write(target_s *t, const uint32_t val)
 {
+	cortexm_regs_invalidate(t);
 	target_mem_write32(t, CORTEXM_DCRDR, val);
 	target_mem_write32(t, CORTEXM_DCRSR, CORTEXM_DCRSR_REGWnR | 0x0fU);
 }
@@ -996,6 +1186,7 @@ static void cortexm_pc_write(target_s *t, const uint32_t val)
  * using the core debug registers in the NVIC. */
 static void cortexm_reset(target_s *t)
 {
+	cortexm_regs_invalidate(t);
 	/* Read DHCSR here to clear S_RESET_ST bit before reset */
 	target_mem_read32(t, CORTEXM_DHCSR);
 	platform_timeout_s reset_timeout;
@@ -1066,10 +1257,15 @@ static target_halt_reason_e cortexm_halt_poll(target_s *t, target_addr_t *watch)
 		return TARGET_HALT_RUNNING;
 	}
 
+	/* The core has been reset since DHCSR was last read, so any register snapshot is stale */
+	if (dhcsr & CORTEXM_DHCSR_S_RESET_ST)
+		cortexm_regs_invalidate(t);
+
 	if (!(dhcsr & CORTEXM_DHCSR_S_HALT))
 		return TARGET_HALT_RUNNING;
 
-	/* We've halted.  Let's find out why. */
+	/* We've halted, which begins a new register snapshot. Let's find out why. */
+	cortexm_regs_invalidate(t);
 	uint32_t dfsr = target_mem_read32(t, CORTEXM_DFSR);
 	target_mem_write32(t, CORTEXM_DFSR, dfsr); /* write back to reset */
 
@@ -1136,6 +1332,7 @@ void cortexm_halt_resume(target_s *const target, const bool step)
 	if (priv->has_cache)
 		target_mem_write32(target, CORTEXM_ICIALLU, 0);
 
+	cortexm_regs_invalidate(target);
 	/* Release C_HALT to resume the core in whichever mode is selected */
 	target_mem_write32(target, CORTEXM_DHCSR, dhcsr);
 }
@@ -1196,7 +1393,11 @@ static int cortexm_fault_unwind(target_s *t)
 	return 0;
 }
 
-bool cortexm_run_stub(target_s *t, uint32_t loadaddr, uint32_t r0, uint32_t r1, uint32_t r2, uint32_t r3)
+/*
+ * Set a stub loaded into target RAM at loadaddr running with the given arguments in r0-r3,
+ * without waiting for it to finish. Returns false if the stub could not be started.
+ */
+bool cortexm_start_stub(target_s *t, uint32_t loadaddr, uint32_t r0, uint32_t r1, uint32_t r2, uint32_t r3)
 {
 	uint32_t regs[t->regs_size / 4U];
 
@@ -1215,15 +1416,46 @@ bool cortexm_run_stub(target_s *t, uint32_t loadaddr, uint32_t r0, uint32_t r1,
 		return false;
 
 	/* Execute the stub */
-	target_halt_reason_e reason = TARGET_HALT_RUNNING;
-#if defined(PLATFORM_HAS_DEBUG)
-	uint32_t arm_regs_start[t->regs_size];
-	target_regs_read(t, arm_regs_start);
-#endif
 	cortexm_halt_resume(t, 0);
+	return true;
+}
+
+/*
+ * Check on a stub started with cortexm_start_stub(). Returns CORTEXM_STUB_RUNNING if it's still going,
+ * otherwise the immediate of the bkpt instruction the stub exited with, or -1 if it stopped some other way.
+ */
+int cortexm_poll_stub(target_s *t)
+{
+	const target_halt_reason_e reason = cortexm_halt_poll(t, NULL);
+	if (reason == TARGET_HALT_RUNNING)
+		return CORTEXM_STUB_RUNNING;
+
+	if (reason == TARGET_HALT_ERROR)
+		raise_exception(EXCEPTION_ERROR, "Target lost in stub");
+
+	if (reason != TARGET_HALT_BREAKPOINT) {
+		DEBUG_WARN(" Reason %d\n", reason);
+		return -1;
+	}
+
+	uint32_t pc = cortexm_pc_read(t);
+	uint16_t bkpt_instr = target_mem_read16(t, pc);
+	if (bkpt_instr >> 8U != 0xbeU)
+		return -1;
+
+	return bkpt_instr & 0xffU;
+}
+
+/*
+ * Wait up to timeout_ms for a stub started with cortexm_start_stub() to exit, halting it if it doesn't.
+ * Returns the immediate of the bkpt instruction the stub exited with, or -1 if the stub failed.
+ */
+int cortexm_wait_stub(target_s *t, uint32_t timeout_ms)
+{
 	platform_timeout_s timeout;
-	platform_timeout_set(&timeout, 5000);
-	while (reason == TARGET_HALT_RUNNING) {
+	platform_timeout_set(&timeout, timeout_ms);
+	int result = CORTEXM_STUB_RUNNING;
+	while (result == CORTEXM_STUB_RUNNING) {
 		if (platform_timeout_is_expired(&timeout)) {
 			cortexm_halt_request(t);
 #if defined(PLATFORM_HAS_DEBUG)
@@ -1231,27 +1463,76 @@ bool cortexm_run_stub(target_s *t, uint32_t loadaddr, uint32_t r0, uint32_t r1,
 			uint32_t arm_regs[t->regs_size];
 			target_regs_read(t, arm_regs);
 			for (uint32_t i = 0; i < 20U; ++i)
-				DEBUG_WARN("%2" PRIu32 ": %08" PRIx32 ", %08" PRIx32 "\n", i, arm_regs_start[i], arm_regs[i]);
+				DEBUG_WARN("%2" PRIu32 ": %08" PRIx32 "\n", i, arm_regs[i]);
 #endif
-			return false;
+			return -1;
 		}
-		reason = cortexm_halt_poll(t, NULL);
+		result = cortexm_poll_stub(t);
 	}
+	return result;
+}
 
-	if (reason == TARGET_HALT_ERROR)
-		raise_exception(EXCEPTION_ERROR, "Target lost in stub");
+/*
+ * Run a stub loaded into target RAM at loadaddr with the given arguments in r0-r3.
+ * Returns the immediate of the bkpt instruction the stub exits with, or -1 if the stub failed to run.
+ */
+int cortexm_run_stub(target_s *t, uint32_t loadaddr, uint32_t r0, uint32_t r1, uint32_t r2, uint32_t r3)
+{
+	if (!cortexm_start_stub(t, loadaddr, r0, r1, r2, r3))
+		return -1;
+	return cortexm_wait_stub(t, 5000);
+}
 
-	if (reason != TARGET_HALT_BREAKPOINT) {
-		DEBUG_WARN(" Reason %d\n", reason);
-		return false;
+/* Pick a RAM region to run a stub from, preferring one in the SRAM region of the memory map which is executable */
+target_ram_s *cortexm_stub_ram(target_s *const t, const size_t len)
+{
+	target_ram_s *result = NULL;
+	for (target_ram_s *ram = t->ram; ram; ram = ram->next) {
+		if (ram->length < len)
+			continue;
+		if (ram->start >= 0x20000000U && ram->start < 0x40000000U)
+			return ram;
+		if (!result)
+			result = ram;
 	}
+	return result;
+}
 
-	uint32_t pc = cortexm_pc_read(t);
-	uint16_t bkpt_instr = target_mem_read16(t, pc);
-	if (bkpt_instr >> 8U != 0xbeU)
+/*
+ * Calculate the CRC32 of target memory on the target itself using a stub, preserving the RAM
+ * used by and the register state clobbered by running it. Returns false so the caller can fall
+ * back to reading the memory out if there's no RAM to use or the stub fails.
+ */
+static bool cortexm_crc32(target_s *const t, uint32_t *const crc_res, target_addr_t base, size_t len)
+{
+	target_ram_s *const ram = cortexm_stub_ram(t, sizeof(cortexm_crc32_stub));
+	if (!ram)
 		return false;
 
-	return bkpt_instr & 0xffU;
+	uint32_t saved_regs[t->regs_size / 4U];
+	uint8_t saved_ram[sizeof(cortexm_crc32_stub)];
+	cortexm_regs_read(t, saved_regs);
+	if (target_mem_read(t, saved_ram, ram->start, sizeof(saved_ram)))
+		return false;
+	target_mem_write(t, ram->start, cortexm_crc32_stub, sizeof(cortexm_crc32_stub));
+
+	uint32_t crc = 0xffffffffU;
+	bool result = !target_check_error(t);
+	while (result && len) {
+		const size_t amount = MIN(len, CORTEXM_CRC32_CHUNK_SIZE);
+		result = cortexm_run_stub(t, ram->start, base, amount, crc, 0) == 0 &&
+			cortexm_reg_read(t, 0, &crc, sizeof(crc)) == (ssize_t)sizeof(crc);
+		base += amount;
+		len -= amount;
+	}
+
+	target_mem_write(t, ram->start, saved_ram, sizeof(saved_ram));
+	cortexm_regs_write(t, saved_regs);
+	if (!result)
+		DEBUG_WARN("CRC32 stub failed, falling back to reading memory\n");
+	else
+		*crc_res = crc;
+	return result;
 }
 
 /* The following routines implement hardware breakpoints and watchpoints.
@@ -1416,6 +1697,28 @@ static bool cortexm_vector_catch(target_s *t, int argc, const char **argv)
 	return true;
 }
 
+static bool cortexm_cache_setway(target_s *t, int argc, const char **argv)
+{
+	cortexm_priv_s *priv = t->priv;
+	if (!priv->has_cache) {
+		gdb_out("Target has no data cache\n");
+		return true;
+	}
+	if (argc > 1) {
+		if (!strncmp(argv[1], "disable", strlen(argv[1])))
+			priv->dcache_setway_threshold = 0;
+		else
+			priv->dcache_setway_threshold = strtoul(argv[1], NULL, 0);
+	}
+	gdb_outf("D-cache: %" PRIu32 " sets, %" PRIu32 " ways, %" PRIu32 " byte lines\n", priv->dcache_sets,
+		priv->dcache_ways, priv->dcache_minline);
+	if (priv->dcache_setway_threshold)
+		gdb_outf("Cleaning by set/way for accesses over %zu bytes\n", priv->dcache_setway_threshold);
+	else
+		gdb_out("Cleaning by set/way disabled\n");
+	return true;
+}
+
 #if PC_HOSTED == 0
 static bool cortexm_redirect_stdout(target_s *t, int argc, const char **argv)
 {
@@ -49,7 +49,14 @@ extern unsigned cortexm_wait_timeout;
 /* Cache maintenance operations */
 #define CORTEXM_ICIALLU  (CORTEXM_SCS_BASE + 0xf50U)
 #define CORTEXM_DCCMVAC  (CORTEXM_SCS_BASE + 0xf68U)
+#define CORTEXM_DCCSW    (CORTEXM_SCS_BASE + 0xf6cU)
 #define CORTEXM_DCCIMVAC (CORTEXM_SCS_BASE + 0xf70U)
+#define CORTEXM_DCCISW   (CORTEXM_SCS_BASE + 0xf74U)
+
+/* Cache Size ID Register (CCSIDR) */
+#define CORTEXM_CCSIDR_LINESIZE(ccsidr)      (((ccsidr) & 0x7U) + 4U) /* log2 of the line size in bytes */
+#define CORTEXM_CCSIDR_ASSOCIATIVITY(ccsidr) ((((ccsidr) >> 3U) & 0x3ffU) + 1U)
+#define CORTEXM_CCSIDR_NUMSETS(ccsidr)       ((((ccsidr) >> 13U) & 0x7fffU) + 1U)
 
 #define CORTEXM_FPB_BASE (CORTEXM_PPB_BASE + 0x2000U)
 
@@ -173,6 +180,9 @@ extern unsigned cortexm_wait_timeout;
 
 #define CORTEXM_TOPT_INHIBIT_NRST (1U << 2U)
 
+/* Returned by cortexm_poll_stub() while the stub is still running */
+#define CORTEXM_STUB_RUNNING (-2)
+
 #define CORTEX_M0  0xc200U
 #define CORTEX_M0P 0xc600U
 #define CORTEX_M3  0xc230U
@@ -191,7 +201,12 @@ adiv5_access_port_s *cortexm_ap(target_s *t);
 bool cortexm_attach(target_s *t);
 void cortexm_detach(target_s *t);
 void cortexm_halt_resume(target_s *t, bool step);
-bool cortexm_run_stub(target_s *t, uint32_t loadaddr, uint32_t r0, uint32_t r1, uint32_t r2, uint32_t r3);
+void cortexm_regs_invalidate(target_s *t);
+int cortexm_run_stub(target_s *t, uint32_t loadaddr, uint32_t r0, uint32_t r1, uint32_t r2, uint32_t r3);
+bool cortexm_start_stub(target_s *t, uint32_t loadaddr, uint32_t r0, uint32_t r1, uint32_t r2, uint32_t r3);
+int cortexm_poll_stub(target_s *t);
+int cortexm_wait_stub(target_s *t, uint32_t timeout_ms);
+struct target_ram *cortexm_stub_ram(target_s *t, size_t len);
 int cortexm_mem_write_sized(target_s *t, target_addr_t dest, const void *src, size_t len, align_e align);
 
 /* This is only for the ADIv5 implementation's use, do not call. */
@@ -0,0 +1,69 @@
+/*
+ * This file is part of the Black Magic Debug project.
+ *
+ * Copyright (C) 2023 1BitSquared <info@1bitsquared.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * CRC32 of a block of target memory, computed the same way as generic_crc32()
+ * (polynomial 0x04c11db7, MSB first, no final inversion) a nibble at a time.
+ *
+ * r0 = start address, r1 = length in bytes, r2 = CRC to continue from
+ * Returns the resulting CRC in r0.
+ */
+	.syntax unified
+	.cpu cortex-m0
+	.thumb
+
+	.text
+	.global crc32_stub
+	.type crc32_stub, %function
+crc32_stub:
+	adds r1, r0, r1
+	adr r3, crc32_nibble_table
+crc32_loop:
+	cmp r0, r1
+	beq crc32_done
+	ldrb r4, [r0]
+	adds r0, #1
+	/* High nibble of the byte */
+	lsrs r5, r2, #28
+	lsrs r6, r4, #4
+	eors r5, r6
+	lsls r5, r5, #2
+	ldr r5, [r3, r5]
+	lsls r2, r2, #4
+	eors r2, r5
+	/* Low nibble of the byte */
+	lsrs r5, r2, #28
+	lsls r4, r4, #28
+	lsrs r4, r4, #28
+	eors r5, r4
+	lsls r5, r5, #2
+	ldr r5, [r3, r5]
+	lsls r2, r2, #4
+	eors r2, r5
+	b crc32_loop
+crc32_done:
+	movs r0, r2
+	bkpt #0
+
+	.align 2
+crc32_nibble_table:
+	.word 0x00000000, 0x04c11db7, 0x09823b6e, 0x0d4326d9
+	.word 0x130476dc, 0x17c56b6b, 0x1a864db2, 0x1e475005
+	.word 0x2608edb8, 0x22c9f00f, 0x2f8ad6d6, 0x2b4bcb61
+	.word 0x350c9b64, 0x31cd86d3, 0x3c8ea00a, 0x384fbdbd
@@ -0,0 +1,94 @@
+/*
+ * This file is part of the Black Magic Debug project.
+ *
+ * Copyright (C) 2023 1BitSquared <info@1bitsquared.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Ring buffered Flash programming for controllers that program a word at a time on a
+ * plain store to Flash, and report progress through a busy (or ready) flag in a status register.
+ * The debugger fills buffers in the ring while this programs the ones already filled.
+ *
+ * r0 = mailbox address. The mailbox (see stub_ring.h) is laid out as:
+ *   +0  number of buffers the debugger has submitted
+ *   +4  number of buffers this stub has completed
+ *   +8  status register value on error
+ *   +12 status register address
+ *   +16 status register busy mask
+ *   +20 status register error mask
+ *   +24 ring mask (buffer count - 1, which must be a power of 2)
+ *   +28 value of the busy mask bits when idle (0 for a busy flag, the mask itself for a ready flag)
+ *   +32 one 16 byte descriptor per buffer: destination, source, length (a multiple of 4), reserved
+ *
+ * A zero length descriptor stops the stub with bkpt #0, an error stops it with bkpt #1.
+ */
+	.syntax unified
+	.cpu cortex-m0
+	.thumb
+
+	.text
+	.global ring_stub
+	.type ring_stub, %function
+ring_stub:
+	ldr r1, [r0, #12]
+	ldr r2, [r0, #16]
+	ldr r3, [r0, #20]
+ring_wait:
+	/* Wait for the debugger to submit a buffer */
+	ldr r4, [r0, #0]
+	ldr r5, [r0, #4]
+	cmp r4, r5
+	beq ring_wait
+	/* Find its descriptor */
+	ldr r4, [r0, #24]
+	ands r4, r5
+	lsls r4, r4, #4
+	adds r4, r0, r4
+	adds r4, #32
+	ldr r5, [r4, #8]
+	cmp r5, #0
+	beq ring_done
+	ldr r6, [r4, #0]
+	ldr r7, [r4, #4]
+	adds r5, r6, r5
+	/* Keep the end address in r8 to free up r5 for the busy check */
+	mov r8, r5
+ring_program:
+	ldr r4, [r7]
+	str r4, [r6]
+	dsb
+	adds r6, #4
+	adds r7, #4
+ring_busy:
+	ldr r4, [r1]
+	ldr r5, [r0, #28]
+	eors r5, r4
+	tst r5, r2
+	bne ring_busy
+	tst r4, r3
+	bne ring_error
+	cmp r6, r8
+	bne ring_program
+	/* Tell the debugger this buffer is free again */
+	ldr r5, [r0, #4]
+	adds r5, #1
+	str r5, [r0, #4]
+	b ring_wait
+ring_error:
+	str r4, [r0, #8]
+	bkpt #1
+ring_done:
+	bkpt #0
@@ -39,6 +39,17 @@ uint32_t jtag_dev_count = 0;
 /* bucket of ones for don't care TDI */
 const uint8_t ones[8] = {0xffU, 0xffU, 0xffU, 0xffU, 0xffU, 0xffU, 0xffU, 0xffU};
 
+/*
+ * Where the last scan left the TAPs on the chain. Select-DR-Scan is a TMS=1 away from both
+ * Run-Test/Idle and Update-DR/IR, so scans can start from either, but anything else cannot.
+ */
+typedef enum jtag_tap_state {
+	JTAG_TAP_STATE_IDLE,
+	JTAG_TAP_STATE_UPDATE,
+} jtag_tap_state_e;
+
+static jtag_tap_state_e jtag_tap_state = JTAG_TAP_STATE_IDLE;
+
 static bool jtag_read_idcodes(void);
 static void jtag_display_idcodes(void);
 static bool jtag_read_irs(void);
@@ -167,6 +178,7 @@ static bool jtag_read_idcodes(void)
 {
 	/* Reset the chain ready and transition to Shift-DR */
 	jtag_proc.jtagtap_reset();
+	jtag_tap_state_reset();
 	DEBUG_INFO("Change state to Shift-DR\n");
 	jtagtap_shift_dr();
 
@@ -379,24 +391,63 @@ void jtag_dev_write_ir(const uint8_t dev_index, const uint32_t ir)
 		jtag_devs[device].current_ir = UINT32_MAX;
 	device->current_ir = ir;
 
-	/* Do the work to make the scanchain match the jtag_devs state */
+	/*
+	 * Do the work to make the scanchain match the jtag_devs state. IR writes are always followed by
+	 * a DR scan, so stop in Update-IR and let that go straight on to Select-DR-Scan.
+	 */
 	jtagtap_shift_ir();
-	jtag_proc.jtagtap_tdi_seq(false, ones, device->ir_prescan);
+	if (device->ir_prescan)
+		jtag_proc.jtagtap_tdi_seq(false, ones, device->ir_prescan);
 	jtag_proc.jtagtap_tdi_seq(!device->ir_postscan, (const uint8_t *)&ir, device->ir_len);
-	jtag_proc.jtagtap_tdi_seq(true, ones, device->ir_postscan);
-	jtagtap_return_idle(1);
+	if (device->ir_postscan)
+		jtag_proc.jtagtap_tdi_seq(true, ones, device->ir_postscan);
+	jtagtap_return_update();
+	jtag_tap_state = JTAG_TAP_STATE_UPDATE;
 }
 
-void jtag_dev_shift_dr(const uint8_t dev_index, uint8_t *data_out, const uint8_t *data_in, const size_t clock_cycles)
+/*
+ * Shift data through the DR of a device, leaving the TAPs in Update-DR so a following scan can go
+ * straight to Select-DR-Scan. Only for callers whose devices don't need time in Run-Test/Idle after
+ * an update, and who will either do another scan or call jtag_tap_idle() when done.
+ */
+void jtag_dev_shift_dr_chained(
+	const uint8_t dev_index, uint8_t *const data_out, const uint8_t *const data_in, const size_t clock_cycles)
 {
-	jtag_dev_s *device = &jtag_devs[dev_index];
+	const jtag_dev_s *const device = &jtag_devs[dev_index];
 	jtagtap_shift_dr();
-	jtag_proc.jtagtap_tdi_seq(false, ones, device->dr_prescan);
+	if (device->dr_prescan)
+		jtag_proc.jtagtap_tdi_seq(false, ones, device->dr_prescan);
 	if (data_out)
 		jtag_proc.jtagtap_tdi_tdo_seq(
 			(uint8_t *)data_out, !device->dr_postscan, (const uint8_t *)data_in, clock_cycles);
 	else
 		jtag_proc.jtagtap_tdi_seq(!device->dr_postscan, (const uint8_t *)data_in, clock_cycles);
-	jtag_proc.jtagtap_tdi_seq(true, ones, device->dr_postscan);
-	jtagtap_return_idle(1);
+	if (device->dr_postscan)
+		jtag_proc.jtagtap_tdi_seq(true, ones, device->dr_postscan);
+	jtagtap_return_update();
+	jtag_tap_state = JTAG_TAP_STATE_UPDATE;
+}
+
+void jtag_dev_shift_dr(const uint8_t dev_index, uint8_t *data_out, const uint8_t *data_in, const size_t clock_cycles)
+{
+	jtag_dev_shift_dr_chained(dev_index, data_out, data_in, clock_cycles);
+	jtag_tap_idle();
+}
+
+/* Move the TAPs on to Run-Test/Idle if a scan left them in Update-DR/IR */
+void jtag_tap_idle(void)
+{
+	if (jtag_tap_state == JTAG_TAP_STATE_IDLE)
+		return;
+	jtag_proc.jtagtap_tms_seq(0U, 1U);
+	jtag_tap_state = JTAG_TAP_STATE_IDLE;
+}
+
+/*
+ * Forget any scan left unfinished, for when the TAPs have been put through Test-Logic-Reset.
+ * Whoever reset them is expected to take them on to Run-Test/Idle from there.
+ */
+void jtag_tap_state_reset(void)
+{
+	jtag_tap_state = JTAG_TAP_STATE_IDLE;
 }
@@ -1070,6 +1070,7 @@ static bool lpc43xx_cmd_reset(target_s *t, int argc, const char **argv)
 	(void)argv;
 	/* System reset on target */
 	target_mem_write32(t, LPC43xx_AIRCR, LPC43xx_AIRCR_RESET);
+	cortexm_regs_invalidate(t);
 	return true;
 }
 
@@ -243,6 +243,7 @@ static bool lpc546xx_cmd_reset(target_s *t, int argc, const char **argv)
 
 	/* System reset on target */
 	target_mem_write(t, AIRCR, &reset_val, sizeof(reset_val));
+	cortexm_regs_invalidate(t);
 	return true;
 }
 
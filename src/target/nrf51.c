@@ -68,6 +68,8 @@ const command_s nrf51_read_cmd_list[] = {
 #define NRF51_NVMC_ERASEALL  (NRF51_NVMC + 0x50cU)
 #define NRF51_NVMC_ERASEUICR (NRF51_NVMC + 0x514U)
 
+#define NRF51_NVMC_READY_READY 0x1U
+
 #define NRF51_NVMC_CONFIG_REN 0x0U // Read only access
 #define NRF51_NVMC_CONFIG_WEN 0x1U // Write enable
 #define NRF51_NVMC_CONFIG_EEN 0x2U // Erase enable
@@ -167,13 +169,7 @@ bool nrf51_probe(target_s *t)
 static bool nrf51_wait_ready(target_s *const t, platform_timeout_s *const timeout)
 {
 	/* Poll for NVMC_READY */
-	while (target_mem_read32(t, NRF51_NVMC_READY) == 0) {
-		if (target_check_error(t))
-			return false;
-		if (timeout)
-			target_print_progress(timeout);
-	}
-	return true;
+	return target_mem32_wait(t, NRF51_NVMC_READY, NRF51_NVMC_READY_READY, NRF51_NVMC_READY_READY, 0U, timeout, NULL);
 }
 
 static bool nrf51_flash_prepare(target_flash_s *f)
@@ -47,6 +47,8 @@
 #include "target.h"
 #include "target_internal.h"
 #include "cortexm.h"
+#include "command.h"
+#include "gdb_packet.h"
 #include "sfdp.h"
 
 #define RP_MAX_TABLE_SIZE     0x80U
@@ -96,6 +98,7 @@
 #define RP_SSI_ICR                             (RP_SSI_BASE_ADDR + 0x48U)
 #define RP_SSI_DR0                             (RP_SSI_BASE_ADDR + 0x60U)
 #define RP_SSI_XIP_SPI_CTRL0                   (RP_SSI_BASE_ADDR + 0xf4U)
+#define RP_SSI_FIFO_DEPTH                      16U
 #define RP_SSI_CTRL0_FRF_MASK                  0x00600000U
 #define RP_SSI_CTRL0_FRF_SERIAL                (0U << 21U)
 #define RP_SSI_CTRL0_FRF_DUAL                  (1U << 21U)
@@ -151,6 +154,13 @@
 #define BOOTROM_FUNC_TABLE_ADDR      0x00000014U
 #define BOOTROM_FUNC_TABLE_TAG(x, y) ((uint8_t)(x) | ((uint8_t)(y) << 8U))
 
+/* Parameters for flash_range_erase() and flash_range_program() in the boot ROM */
+#define RP_ROM_FLASH_BLOCK_SIZE   FLASHSIZE_64K_BLOCK
+#define RP_ROM_FLASH_BLOCK_ERASE  0xd8U
+#define RP_ROM_FLASH_PAGE_SIZE    256U
+#define RP_ROM_ERASE_TIMEOUT_MS   10000U
+#define RP_ROM_PROGRAM_TIMEOUT_MS 1000U
+
 #define FLASHSIZE_4K_SECTOR      (4U * 1024U)
 #define FLASHSIZE_32K_BLOCK      (32U * 1024U)
 #define FLASHSIZE_64K_BLOCK      (64U * 1024U)
@@ -191,6 +201,15 @@
 
 typedef struct rp_priv {
 	uint16_t rom_reset_usb_boot;
+	uint16_t rom_flash_range_erase;
+	uint16_t rom_flash_range_program;
+	uint16_t rom_debug_trampoline;
+	uint16_t rom_debug_trampoline_end;
+	/* Whether to program Flash by calling the boot ROM rather than driving the SSI over SWD */
+	bool rom_flash;
+	/* Our copy of the QSPI CS control register, valid until the target or boot ROM may have changed it */
+	bool qspi_cs_ctrl_valid;
+	uint32_t qspi_cs_ctrl;
 	uint32_t ssi_enabled;
 	uint32_t ctrl0;
 	uint32_t ctrl1;
@@ -205,10 +224,12 @@ typedef struct rp_flash {
 
 static bool rp_cmd_erase_sector(target_s *t, int argc, const char **argv);
 static bool rp_cmd_reset_usb_boot(target_s *t, int argc, const char **argv);
+static bool rp_cmd_rom_flash(target_s *t, int argc, const char **argv);
 
 const command_s rp_cmd_list[] = {
 	{"erase_sector", rp_cmd_erase_sector, "Erase a sector: [start address] length"},
 	{"reset_usb_boot", rp_cmd_reset_usb_boot, "Reboot the device into BOOTSEL mode"},
+	{"rom_flash", rp_cmd_rom_flash, "Program Flash using the boot ROM routines: (enable|disable)"},
 	{NULL, NULL, NULL},
 };
 
@@ -221,8 +242,8 @@ static void rp_spi_config(target_s *target);
 static void rp_spi_restore(target_s *target);
 static bool rp_flash_prepare(target_s *target);
 static bool rp_flash_resume(target_s *target);
-static void rp_spi_read(target_s *target, uint16_t command, target_addr_t address, void *buffer, size_t length);
-static void rp_spi_write(target_s *target, uint16_t command, target_addr_t address, const void *buffer, size_t length);
+static bool rp_spi_read(target_s *target, uint16_t command, target_addr_t address, void *buffer, size_t length);
+static bool rp_spi_write(target_s *target, uint16_t command, target_addr_t address, const void *buffer, size_t length);
 static inline uint8_t rp_spi_read_status(target_s *target);
 static inline void rp_spi_run_command(target_s *target, uint32_t command, target_addr_t address);
 static uint32_t rp_get_flash_length(target_s *target);
@@ -341,18 +362,108 @@ static bool rp_read_rom_func_table(target_s *const target)
 	/* We have to do a 32-bit read here but the pointer contained is only 16-bit. */
 	const uint16_t table_offset = target_mem_read32(target, BOOTROM_FUNC_TABLE_ADDR) & 0x0000ffffU;
 	uint16_t table[RP_MAX_TABLE_SIZE];
-	if (target_mem_read(target, table, table_offset, RP_MAX_TABLE_SIZE))
+	if (target_mem_read(target, table, table_offset, sizeof(table)))
 		return false;
 
-	for (size_t i = 0; i < RP_MAX_TABLE_SIZE; i += 2U) {
+	/* The table ends with a zero tag */
+	for (size_t i = 0; i < RP_MAX_TABLE_SIZE && table[i]; i += 2U) {
 		const uint16_t tag = table[i];
 		const uint16_t addr = table[i + 1U];
-		if (tag == BOOTROM_FUNC_TABLE_TAG('U', 'B')) {
+		switch (tag) {
+		case BOOTROM_FUNC_TABLE_TAG('U', 'B'):
 			priv->rom_reset_usb_boot = addr;
-			return true;
+			break;
+		case BOOTROM_FUNC_TABLE_TAG('R', 'E'):
+			priv->rom_flash_range_erase = addr;
+			break;
+		case BOOTROM_FUNC_TABLE_TAG('R', 'P'):
+			priv->rom_flash_range_program = addr;
+			break;
+		case BOOTROM_FUNC_TABLE_TAG('D', 'T'):
+			priv->rom_debug_trampoline = addr;
+			break;
+		case BOOTROM_FUNC_TABLE_TAG('D', 'E'):
+			priv->rom_debug_trampoline_end = addr;
+			break;
+		default:
+			break;
 		}
 	}
-	return false;
+	return priv->rom_reset_usb_boot != 0U;
+}
+
+/*
+ * Call a boot ROM routine with up to 4 arguments through the ROM's debug trampoline, which calls
+ * the function in r7 then hits a breakpoint when it returns. The stack goes at the top of SRAM.
+ */
+static bool rp_rom_call(target_s *const target, const uint16_t func, const uint32_t r0, const uint32_t r1,
+	const uint32_t r2, const uint32_t r3, const uint32_t timeout_ms)
+{
+	rp_priv_s *const priv = (rp_priv_s *)target->target_storage;
+	uint32_t regs[target->regs_size / 4U];
+	memset(regs, 0, sizeof(regs));
+	regs[0] = r0;
+	regs[1] = r1;
+	regs[2] = r2;
+	regs[3] = r3;
+	regs[7] = func;
+	regs[REG_SP] = RP_SRAM_BASE + RP_SRAM_SIZE;
+	regs[REG_LR] = priv->rom_debug_trampoline_end;
+	/* The table holds Thumb function pointers, but the PC must be written without the Thumb bit set */
+	regs[REG_PC] = priv->rom_debug_trampoline & ~1U;
+	regs[REG_MSP] = RP_SRAM_BASE + RP_SRAM_SIZE;
+	regs[REG_XPSR] = CORTEXM_XPSR_THUMB;
+	target_regs_write(target, regs);
+	/* The ROM drives the QSPI chip select itself, so our copy of its control register goes stale */
+	priv->qspi_cs_ctrl_valid = false;
+	if (target_check_error(target))
+		return false;
+
+	target_halt_resume(target, false);
+	const int result = cortexm_wait_stub(target, timeout_ms);
+	if (result)
+		DEBUG_ERROR("RP2040 boot ROM call to 0x%04x failed (%d)\n", func, result);
+	return result == 0;
+}
+
+/* Check if the boot ROM's Flash routines are enabled, present, and agree with the Flash's geometry */
+static bool rp_rom_flash_usable(const target_flash_s *const flash)
+{
+	const rp_priv_s *const priv = (rp_priv_s *)flash->t->target_storage;
+	const rp_flash_s *const spi_flash = (const rp_flash_s *)flash;
+	if (!priv->rom_flash || !priv->rom_flash_range_erase || !priv->rom_flash_range_program ||
+		!priv->rom_debug_trampoline || !priv->rom_debug_trampoline_end)
+		return false;
+	/* The ROM only knows how to use 4KiB sector erases and 256 byte page programs */
+	return flash->blocksize == FLASHSIZE_4K_SECTOR && spi_flash->page_size == RP_ROM_FLASH_PAGE_SIZE &&
+		spi_flash->sector_erase_opcode == SPI_FLASH_OPCODE_SECTOR_ERASE;
+}
+
+static bool rp_rom_flash_erase(target_s *const target, const target_addr_t begin, const size_t length)
+{
+	const rp_priv_s *const priv = (rp_priv_s *)target->target_storage;
+	/* Erase a block at a time so each call comfortably fits in the timeout */
+	for (size_t offset = 0; offset < length; offset += RP_ROM_FLASH_BLOCK_SIZE) {
+		const size_t amount = MIN(length - offset, RP_ROM_FLASH_BLOCK_SIZE);
+		if (!rp_rom_call(target, priv->rom_flash_range_erase, begin + offset, amount, RP_ROM_FLASH_BLOCK_SIZE,
+				RP_ROM_FLASH_BLOCK_ERASE, RP_ROM_ERASE_TIMEOUT_MS))
+			return false;
+	}
+	return true;
+}
+
+static bool rp_rom_flash_write(
+	target_s *const target, const target_addr_t begin, const void *const src, const size_t length)
+{
+	const rp_priv_s *const priv = (rp_priv_s *)target->target_storage;
+	if (length % RP_ROM_FLASH_PAGE_SIZE)
+		return false;
+	/* The data goes at the bottom of SRAM, well clear of the ROM's stack at the top */
+	target_mem_write(target, RP_SRAM_BASE, src, length);
+	if (target_check_error(target))
+		return false;
+	return rp_rom_call(
+		target, priv->rom_flash_range_program, begin, RP_SRAM_BASE, length, 0U, RP_ROM_PROGRAM_TIMEOUT_MS);
 }
 
 static void rp_spi_config(target_s *const target)
@@ -419,6 +530,8 @@ static bool rp_flash_erase(target_flash_s *const flash, const target_addr_t addr
 	const rp_flash_s *const spi_flash = (rp_flash_s *)flash;
 	const target_addr_t begin = addr - flash->start;
 	DEBUG_TARGET("%s: %zu bytes starting at %08" PRIx32 " (%08" PRIx32 ")\n", __func__, length, addr, begin);
+	if (rp_rom_flash_usable(flash))
+		return rp_rom_flash_erase(target, begin, length);
 	for (size_t offset = 0; offset < length; offset += flash->blocksize) {
 		rp_spi_run_command(target, SPI_FLASH_CMD_WRITE_ENABLE, 0U);
 		if (!(rp_spi_read_status(target) & SPI_FLASH_STATUS_WRITE_ENABLED))
@@ -439,13 +552,16 @@ static bool rp_flash_write(target_flash_s *const flash, target_addr_t dest, cons
 	const target_addr_t begin = dest - flash->start;
 	const char *const buffer = (const char *)src;
 	DEBUG_TARGET("%s: %zu bytes starting at %08" PRIx32 " (%08" PRIx32 ")\n", __func__, length, dest, begin);
+	if (rp_rom_flash_usable(flash))
+		return rp_rom_flash_write(target, begin, src, length);
 	for (size_t offset = 0; offset < length; offset += spi_flash->page_size) {
 		rp_spi_run_command(target, SPI_FLASH_CMD_WRITE_ENABLE, 0U);
 		if (!(rp_spi_read_status(target) & SPI_FLASH_STATUS_WRITE_ENABLED))
 			return false;
 
 		const size_t amount = MIN(length - offset, spi_flash->page_size);
-		rp_spi_write(target, SPI_FLASH_CMD_PAGE_PROGRAM, begin + offset, buffer + offset, amount);
+		if (!rp_spi_write(target, SPI_FLASH_CMD_PAGE_PROGRAM, begin + offset, buffer + offset, amount))
+			return false;
 		while (rp_spi_read_status(target) & SPI_FLASH_STATUS_BUSY)
 			continue;
 	}
@@ -472,82 +588,87 @@ static bool rp_mass_erase(target_s *const target)
 
 static void rp_spi_chip_select(target_s *const target, const uint32_t state)
 {
-	const uint32_t value = target_mem_read32(target, RP_GPIO_QSPI_CS_CTRL);
-	target_mem_write32(target, RP_GPIO_QSPI_CS_CTRL, (value & ~RP_GPIO_QSPI_CS_DRIVE_MASK) | state);
+	rp_priv_s *const priv = (rp_priv_s *)target->target_storage;
+	/* Only read the control register back when our copy of it might be stale */
+	if (!priv->qspi_cs_ctrl_valid) {
+		priv->qspi_cs_ctrl = target_mem_read32(target, RP_GPIO_QSPI_CS_CTRL);
+		priv->qspi_cs_ctrl_valid = true;
+	}
+	priv->qspi_cs_ctrl = (priv->qspi_cs_ctrl & ~RP_GPIO_QSPI_CS_DRIVE_MASK) | state;
+	target_mem_write32(target, RP_GPIO_QSPI_CS_CTRL, priv->qspi_cs_ctrl);
 }
 
-static uint8_t rp_spi_xfer_data(target_s *const target, const uint8_t data)
+/*
+ * Run a SPI Flash command, sending the opcode, any address and dummy bytes, then length bytes from tx
+ * (or zeros if tx is NULL), and storing the bytes received for those in rx if it's not NULL.
+ * The SSI data register is aliased across DR0..DR35, so the bytes go through the FIFOs a FIFO's worth
+ * at a time, each chunk being a single block write and block read rather than a write and read per byte.
+ */
+static bool rp_spi_xfer(target_s *const target, const uint16_t command, const target_addr_t address,
+	const uint8_t *const tx, uint8_t *const rx, const size_t length)
 {
-	target_mem_write32(target, RP_SSI_DR0, data);
-	return target_mem_read32(target, RP_SSI_DR0) & 0xffU;
-}
+	uint8_t header[4U + (RP_SPI_FLASH_DUMMY_MASK >> RP_SPI_FLASH_DUMMY_SHIFT)];
+	size_t header_length = 0U;
+	header[header_length++] = command & RP_SPI_FLASH_OPCODE_MASK;
+	if ((command & RP_SPI_FLASH_MASK) == RP_SPI_FLASH_OPCODE_3B_ADDR) {
+		header[header_length++] = (address >> 16U) & 0xffU;
+		header[header_length++] = (address >> 8U) & 0xffU;
+		header[header_length++] = address & 0xffU;
+	}
+	const size_t dummy_length = (command & RP_SPI_FLASH_DUMMY_MASK) >> RP_SPI_FLASH_DUMMY_SHIFT;
+	memset(header + header_length, 0, dummy_length);
+	header_length += dummy_length;
 
-static void rp_spi_read(target_s *const target, const uint16_t command, const target_addr_t address, void *const buffer,
-	const size_t length)
-{
-	/* Configure the controller, and select the Flash */
-	target_mem_write32(target, RP_SSI_CTRL1, length);
 	rp_spi_chip_select(target, RP_GPIO_QSPI_CS_DRIVE_LOW);
-
-	/* Set up the instruction */
-	const uint8_t opcode = command & RP_SPI_FLASH_OPCODE_MASK;
-	rp_spi_xfer_data(target, opcode);
-
-	const uint16_t addr_mode = command & RP_SPI_FLASH_MASK;
-	if (addr_mode == RP_SPI_FLASH_OPCODE_3B_ADDR) {
-		/* For each byte sent here, we have to manually clean up from the controller with a read */
-		rp_spi_xfer_data(target, (address >> 16U) & 0xffU);
-		rp_spi_xfer_data(target, (address >> 8U) & 0xffU);
-		rp_spi_xfer_data(target, address & 0xffU);
+	const size_t total_length = header_length + length;
+	uint32_t fifo[RP_SSI_FIFO_DEPTH];
+	for (size_t offset = 0; offset < total_length; offset += RP_SSI_FIFO_DEPTH) {
+		const size_t amount = MIN(total_length - offset, RP_SSI_FIFO_DEPTH);
+		for (size_t i = 0; i < amount; ++i) {
+			const size_t index = offset + i;
+			if (index < header_length)
+				fifo[i] = header[index];
+			else
+				fifo[i] = tx ? tx[index - header_length] : 0U;
+		}
+		target_mem_write(target, RP_SSI_DR0, fifo, amount * sizeof(*fifo));
+		/* Wait for the whole chunk to be clocked through so the block read can't underflow the RX FIFO */
+		platform_timeout_s timeout;
+		platform_timeout_set(&timeout, 100U);
+		while (target_mem_read32(target, RP_SSI_RXFLR) < amount) {
+			if (target_check_error(target) || platform_timeout_is_expired(&timeout)) {
+				DEBUG_ERROR("%s: SSI stalled with %zu of %zu bytes left\n", __func__, total_length - offset,
+					total_length);
+				/* Cycling the SSI's enable empties its FIFOs so what's left of this transfer can't upset the next */
+				target_mem_write32(target, RP_SSI_ENABLE, 0U);
+				target_mem_write32(target, RP_SSI_ENABLE, RP_SSI_ENABLE_SSI);
+				rp_spi_chip_select(target, RP_GPIO_QSPI_CS_DRIVE_HIGH);
+				return false;
+			}
+		}
+		target_mem_read(target, fifo, RP_SSI_DR0, amount * sizeof(*fifo));
+		if (!rx)
+			continue;
+		for (size_t i = 0; i < amount; ++i) {
+			const size_t index = offset + i;
+			if (index >= header_length)
+				rx[index - header_length] = fifo[i] & 0xffU;
+		}
 	}
-
-	const size_t inter_length = (command & RP_SPI_FLASH_DUMMY_MASK) >> RP_SPI_FLASH_DUMMY_SHIFT;
-	for (size_t i = 0; i < inter_length; ++i)
-		/* For each byte sent here, we have to manually clean up from the controller with a read */
-		rp_spi_xfer_data(target, 0);
-
-	/* Now read back the data that elicited */
-	uint8_t *const data = (uint8_t *const)buffer;
-	for (size_t i = 0; i < length; ++i)
-		/* Do a write to read */
-		data[i] = rp_spi_xfer_data(target, 0);
-
-	/* Deselect the Flash */
 	rp_spi_chip_select(target, RP_GPIO_QSPI_CS_DRIVE_HIGH);
+	return true;
 }
 
-static void rp_spi_write(target_s *const target, const uint16_t command, const target_addr_t address,
-	const void *const buffer, const size_t length)
+static bool rp_spi_read(target_s *const target, const uint16_t command, const target_addr_t address, void *const buffer,
+	const size_t length)
 {
-	/* Configure the controller, and select the Flash */
-	target_mem_write32(target, RP_SSI_CTRL1, length);
-	rp_spi_chip_select(target, RP_GPIO_QSPI_CS_DRIVE_LOW);
-
-	/* Set up the instruction */
-	const uint8_t opcode = command & RP_SPI_FLASH_OPCODE_MASK;
-	rp_spi_xfer_data(target, opcode);
-
-	const uint16_t addr_mode = command & RP_SPI_FLASH_MASK;
-	if (addr_mode == RP_SPI_FLASH_OPCODE_3B_ADDR) {
-		/* For each byte sent here, we have to manually clean up from the controller with a read */
-		rp_spi_xfer_data(target, (address >> 16U) & 0xffU);
-		rp_spi_xfer_data(target, (address >> 8U) & 0xffU);
-		rp_spi_xfer_data(target, address & 0xffU);
-	}
-
-	const size_t inter_length = (command & RP_SPI_FLASH_DUMMY_MASK) >> RP_SPI_FLASH_DUMMY_SHIFT;
-	for (size_t i = 0; i < inter_length; ++i)
-		/* For each byte sent here, we have to manually clean up from the controller with a read */
-		rp_spi_xfer_data(target, 0);
-
-	/* Now write out back the data requested */
-	uint8_t *const data = (uint8_t *const)buffer;
-	for (size_t i = 0; i < length; ++i)
-		/* Do a write to read */
-		rp_spi_xfer_data(target, data[i]);
+	return rp_spi_xfer(target, command, address, NULL, (uint8_t *)buffer, length);
+}
 
-	/* Deselect the Flash */
-	rp_spi_chip_select(target, RP_GPIO_QSPI_CS_DRIVE_HIGH);
+static bool rp_spi_write(target_s *const target, const uint16_t command, const target_addr_t address,
+	const void *const buffer, const size_t length)
+{
+	return rp_spi_xfer(target, command, address, (const uint8_t *)buffer, NULL, length);
 }
 
 static inline uint8_t rp_spi_read_status(target_s *const target)
@@ -695,6 +816,9 @@ static void rp_flash_exit_xip(target_s *const target)
 	uint8_t buf[2];
 	memset(buf, 0xffU, sizeof(buf));
 
+	/* The target's been running since we last touched the chip select, so don't trust our copy */
+	rp_priv_s *const priv = (rp_priv_s *)target->target_storage;
+	priv->qspi_cs_ctrl_valid = false;
 	rp_flash_init_spi(target);
 
 	uint32_t padctrl_save = target_mem_read32(target, RP_PADS_QSPI_GPIO_SD0);
@@ -737,7 +861,8 @@ static void rp_flash_exit_xip(target_s *const target)
 	rp_spi_chip_select(target, RP_GPIO_QSPI_CS_DRIVE_LOW);
 	rp_flash_put_get(target, buf, NULL, 2, 0);
 
-	target_mem_write32(target, RP_GPIO_QSPI_CS_CTRL, 0);
+	priv->qspi_cs_ctrl = 0U;
+	target_mem_write32(target, RP_GPIO_QSPI_CS_CTRL, priv->qspi_cs_ctrl);
 }
 
 // This is a hook for steps to be taken in between programming the flash and
@@ -778,7 +903,8 @@ static uint32_t rp_get_flash_length(target_s *const target)
 {
 	// Read the JEDEC ID and try to decode it
 	spi_flash_id_s flash_id;
-	rp_spi_read(target, SPI_FLASH_CMD_READ_JEDEC_ID, 0, &flash_id, sizeof(flash_id));
+	if (!rp_spi_read(target, SPI_FLASH_CMD_READ_JEDEC_ID, 0, &flash_id, sizeof(flash_id)))
+		return MAX_FLASH;
 
 	DEBUG_INFO("Flash device ID: %02x %02x %02x\n", flash_id.manufacturer, flash_id.type, flash_id.capacity);
 	if (flash_id.capacity >= 8U && flash_id.capacity <= 34U)
@@ -831,6 +957,17 @@ static bool rp_cmd_reset_usb_boot(target_s *t, int argc, const char **argv)
 	return true;
 }
 
+static bool rp_cmd_rom_flash(target_s *t, int argc, const char **argv)
+{
+	rp_priv_s *const priv = (rp_priv_s *)t->target_storage;
+	if (argc == 2 && !parse_enable_or_disable(argv[1], &priv->rom_flash))
+		return false;
+	gdb_outf("Flash programming through the boot ROM: %s\n", priv->rom_flash ? "enabled" : "disabled");
+	if (priv->rom_flash && t->flash && !rp_rom_flash_usable(t->flash))
+		gdb_out("The boot ROM routines can't be used with this Flash, so it will be programmed directly\n");
+	return true;
+}
+
 static bool rp_rescue_do_reset(target_s *t)
 {
 	adiv5_access_port_s *ap = (adiv5_access_port_s *)t->priv;
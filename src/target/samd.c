@@ -40,9 +40,12 @@
 #include "target.h"
 #include "target_internal.h"
 #include "cortexm.h"
+#include "stub_ring.h"
 
+static bool samd_flash_prepare(target_flash_s *f);
 static bool samd_flash_erase(target_flash_s *f, target_addr_t addr, size_t len);
 static bool samd_flash_write(target_flash_s *f, target_addr_t dest, const void *src, size_t len);
+static bool samd_flash_done(target_flash_s *f);
 /* NB: This is not marked static on purpose as it's used by samx5x.c. */
 bool samd_mass_erase(target_s *t);
 
@@ -68,8 +71,9 @@ const command_s samd_cmd_list[] = {
 };
 
 /* Non-Volatile Memory Controller (NVMC) Parameters */
-#define SAMD_ROW_SIZE  256U
-#define SAMD_PAGE_SIZE 64U
+#define SAMD_ROW_SIZE     256U
+#define SAMD_PAGE_SIZE    64U
+#define SAMD_LOCK_REGIONS 16U
 
 /* -------------------------------------------------------------------------- */
 /* Non-Volatile Memory Controller (NVMC) Registers */
@@ -82,6 +86,7 @@ const command_s samd_cmd_list[] = {
 #define SAMD_NVMC_INTFLAG (SAMD_NVMC + 0x14U)
 #define SAMD_NVMC_STATUS  (SAMD_NVMC + 0x18U)
 #define SAMD_NVMC_ADDRESS (SAMD_NVMC + 0x1cU)
+#define SAMD_NVMC_LOCK    (SAMD_NVMC + 0x20U)
 
 /* Control A Register (CTRLA) */
 #define SAMD_CTRLA_CMD_KEY             0xa500U
@@ -95,8 +100,18 @@ const command_s samd_cmd_list[] = {
 #define SAMD_CTRLA_CMD_SSB             0x0045U
 #define SAMD_CTRLA_CMD_INVALL          0x0046U
 
+/* Control B Register (CTRLB) */
+#define SAMD_CTRLB_MANW (1U << 7U)
+
 /* Interrupt Flag Register (INTFLAG) */
 #define SAMD_NVMC_READY (1U << 0U)
+#define SAMD_NVMC_ERROR (1U << 1U)
+
+/* Status Register (STATUS) */
+#define SAMD_STATUS_PROGE      (1U << 2U)
+#define SAMD_STATUS_LOCKE      (1U << 3U)
+#define SAMD_STATUS_NVME       (1U << 4U)
+#define SAMD_STATUS_ERROR_MASK (SAMD_STATUS_PROGE | SAMD_STATUS_LOCKE | SAMD_STATUS_NVME)
 
 /* Non-Volatile Memory Calibration and Auxiliary Registers */
 #define SAMD_NVM_USER_ROW_LOW  0x00804000U
@@ -245,6 +260,7 @@ void samd_reset(target_s *t)
 
 	/* Read DHCSR here to clear S_RESET_ST bit before reset */
 	target_mem_read32(t, CORTEXM_DHCSR);
+	cortexm_regs_invalidate(t);
 
 	/*
 	 * Request System Reset from NVIC: nRST doesn't work correctly
@@ -470,20 +486,35 @@ samd_descr_s samd_parse_device_id(uint32_t did)
 	return samd;
 }
 
+typedef struct samd_flash {
+	target_flash_s f;
+	stub_ring_s ring;
+	/* CTRLB and LOCK as found by samd_flash_prepare(), put back by samd_flash_done() */
+	uint32_t ctrlb;
+	uint16_t lock;
+	/* True if the page buffer is written out automatically once its last word is filled (MANW = 0) */
+	bool auto_write;
+} samd_flash_s;
+
 static void samd_add_flash(target_s *t, uint32_t addr, size_t length)
 {
-	target_flash_s *f = calloc(1, sizeof(*f));
-	if (!f) { /* calloc failed: heap exhaustion */
+	samd_flash_s *sf = calloc(1, sizeof(*sf));
+	if (!sf) { /* calloc failed: heap exhaustion */
 		DEBUG_ERROR("calloc: failed in %s\n", __func__);
 		return;
 	}
 
+	target_flash_s *f = &sf->f;
 	f->start = addr;
 	f->length = length;
 	f->blocksize = SAMD_ROW_SIZE;
+	f->prepare = samd_flash_prepare;
 	f->erase = samd_flash_erase;
 	f->write = samd_flash_write;
-	f->writesize = SAMD_PAGE_SIZE;
+	f->done = samd_flash_done;
+	/* Write a row at a time, which is 4 pages, to cut down on the per-write overhead */
+	f->writesize = SAMD_ROW_SIZE;
+	f->erased = 0xffU;
 	target_add_flash(t, f);
 }
 
@@ -570,28 +601,10 @@ bool samd_probe(target_s *t)
 	return true;
 }
 
-/* Temporary (until next reset) flash memory locking */
-static void samd_lock_current_address(target_s *t)
-{
-	/* Issue the lock command */
-	target_mem_write32(t, SAMD_NVMC_CTRLA, SAMD_CTRLA_CMD_KEY | SAMD_CTRLA_CMD_LOCK);
-}
-
-/* Temporary (until next reset) flash memory unlocking */
-static void samd_unlock_current_address(target_s *t)
-{
-	/* Issue the unlock command */
-	target_mem_write32(t, SAMD_NVMC_CTRLA, SAMD_CTRLA_CMD_KEY | SAMD_CTRLA_CMD_UNLOCK);
-}
-
 static bool samd_wait_nvm_ready(target_s *t)
 {
 	/* Poll for NVM Ready */
-	while ((target_mem_read32(t, SAMD_NVMC_INTFLAG) & SAMD_NVMC_READY) == 0) {
-		if (target_check_error(t))
-			return false;
-	}
-	return true;
+	return target_mem32_wait(t, SAMD_NVMC_INTFLAG, SAMD_NVMC_READY, SAMD_NVMC_READY, 0U, NULL, NULL);
 }
 
 static bool samd_wait_dsu_ready(target_s *const t, uint32_t *const result, platform_timeout_s *const timeout)
@@ -608,10 +621,56 @@ static bool samd_wait_dsu_ready(target_s *const t, uint32_t *const result, platf
 	return true;
 }
 
+/*
+ * Temporarily (until next reset) lock or unlock each of the lock regions whose bit is clear in regions,
+ * leaving the rest as they are
+ */
+static bool samd_flash_lock_regions(target_flash_s *const f, const uint16_t regions, const uint16_t command)
+{
+	target_s *t = f->t;
+	const size_t region_size = f->length / SAMD_LOCK_REGIONS;
+	for (uint32_t region = 0; region < SAMD_LOCK_REGIONS; ++region) {
+		if (regions & (1U << region))
+			continue;
+		/* Must be shifted right for 16-bit address, see Datasheet §20.8.8 Address */
+		target_mem_write32(t, SAMD_NVMC_ADDRESS, (f->start + (region * region_size)) >> 1U);
+		target_mem_write32(t, SAMD_NVMC_CTRLA, SAMD_CTRLA_CMD_KEY | command);
+		if (!samd_wait_nvm_ready(t))
+			return false;
+	}
+	return true;
+}
+
+/*
+ * Unlock the whole of Flash once up front, rather than around every row and page, and switch the
+ * controller over to writing each page out automatically as the last word of its buffer is filled
+ */
+static bool samd_flash_prepare(target_flash_s *const f)
+{
+	target_s *t = f->t;
+	samd_flash_s *const sf = (samd_flash_s *)f;
+
+	/* LOCK has a bit per region, set if the region is unlocked */
+	sf->lock = target_mem_read16(t, SAMD_NVMC_LOCK);
+	sf->ctrlb = target_mem_read32(t, SAMD_NVMC_CTRLB);
+	if (!samd_flash_lock_regions(f, sf->lock, SAMD_CTRLA_CMD_UNLOCK))
+		return false;
+
+	/* Not every part is guaranteed to let MANW be cleared, so read it back to see what we got */
+	target_mem_write32(t, SAMD_NVMC_CTRLB, sf->ctrlb & ~SAMD_CTRLB_MANW);
+	sf->auto_write = !(target_mem_read32(t, SAMD_NVMC_CTRLB) & SAMD_CTRLB_MANW);
+	return !target_check_error(t);
+}
+
 /* Erase flash row by row */
 static bool samd_flash_erase(target_flash_s *const f, const target_addr_t addr, const size_t len)
 {
 	target_s *t = f->t;
+	samd_flash_s *const sf = (samd_flash_s *)f;
+	/* The ring stub must finish any writes in flight before the controller can be given another command */
+	if (!stub_ring_stop(&sf->ring))
+		return false;
+
 	for (size_t offset = 0; offset < len; offset += f->blocksize) {
 		/*
 		 * Write address of first word in row to erase it
@@ -619,45 +678,63 @@ static bool samd_flash_erase(target_flash_s *const f, const target_addr_t addr,
 		 */
 		target_mem_write32(t, SAMD_NVMC_ADDRESS, (addr + offset) >> 1U);
 
-		/* Unlock */
-		samd_unlock_current_address(t);
-
-		/* Issue the erase command */
+		/* Issue the erase command, samd_flash_prepare() has already unlocked the row */
 		target_mem_write32(t, SAMD_NVMC_CTRLA, SAMD_CTRLA_CMD_KEY | SAMD_CTRLA_CMD_ERASEROW);
 		if (!samd_wait_nvm_ready(t))
 			return false;
-
-		/* Lock */
-		samd_lock_current_address(t);
 	}
 
 	return true;
 }
 
 /*
- * Write flash page by page
+ * Write flash a row at a time
  */
 static bool samd_flash_write(target_flash_s *f, target_addr_t dest, const void *src, size_t len)
 {
 	target_s *t = f->t;
+	samd_flash_s *const sf = (samd_flash_s *)f;
 
-	/* Write within a single page. This may be part or all of the page */
-	target_mem_write(t, dest, src, len);
-
-	/* Unlock */
-	samd_unlock_current_address(t);
-
-	/* Issue the write page command */
-	target_mem_write32(t, SAMD_NVMC_CTRLA, SAMD_CTRLA_CMD_KEY | SAMD_CTRLA_CMD_WRITEPAGE);
-	if (!samd_wait_nvm_ready(t))
-		return false;
+	/*
+	 * With automatic page writes, programming is nothing more than filling the page buffer, so do that
+	 * through the ring stub to have the next row go over the wire while the target's busy writing the last.
+	 */
+	if (sf->auto_write) {
+		if (!stub_ring_running(&sf->ring)) {
+			/* Clear any old errors so they're not taken for ones from this write */
+			target_mem_write16(t, SAMD_NVMC_STATUS, SAMD_STATUS_ERROR_MASK);
+			target_mem_write8(t, SAMD_NVMC_INTFLAG, SAMD_NVMC_ERROR);
+			stub_ring_start(
+				&sf->ring, t, SAMD_NVMC_INTFLAG, SAMD_NVMC_READY, SAMD_NVMC_READY, SAMD_NVMC_ERROR, f->writesize);
+		}
+		if (stub_ring_running(&sf->ring))
+			return stub_ring_write(&sf->ring, dest, src, len);
+	}
 
-	/* Lock */
-	samd_lock_current_address(t);
+	const uint8_t *const data = (const uint8_t *)src;
+	for (size_t offset = 0; offset < len; offset += SAMD_PAGE_SIZE) {
+		/* Fill the page buffer, which gets written out as soon as it's full in automatic mode */
+		target_mem_write(t, dest + offset, data + offset, MIN(len - offset, SAMD_PAGE_SIZE));
+		/* Otherwise issue the write page command */
+		if (!sf->auto_write)
+			target_mem_write32(t, SAMD_NVMC_CTRLA, SAMD_CTRLA_CMD_KEY | SAMD_CTRLA_CMD_WRITEPAGE);
+		if (!samd_wait_nvm_ready(t))
+			return false;
+	}
 
 	return true;
 }
 
+/* Finish off any writes still in flight, then put CTRLB and the region locks back how they were found */
+static bool samd_flash_done(target_flash_s *const f)
+{
+	target_s *t = f->t;
+	samd_flash_s *const sf = (samd_flash_s *)f;
+	const bool result = stub_ring_stop(&sf->ring);
+	target_mem_write32(t, SAMD_NVMC_CTRLB, sf->ctrlb);
+	return samd_flash_lock_regions(f, sf->lock, SAMD_CTRLA_CMD_LOCK) && result;
+}
+
 /* Uses the Device Service Unit to erase the entire flash */
 bool samd_mass_erase(target_s *t)
 {
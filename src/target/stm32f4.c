@@ -38,6 +38,7 @@
 #include "target_internal.h"
 #include "cortexm.h"
 #include "stm32_common.h"
+#include "stub_ring.h"
 
 static bool stm32f4_cmd_option(target_s *t, int argc, const char **argv);
 static bool stm32f4_cmd_psize(target_s *t, int argc, const char **argv);
@@ -52,6 +53,7 @@ static bool stm32f4_attach(target_s *t);
 static void stm32f4_detach(target_s *t);
 static bool stm32f4_flash_erase(target_flash_s *f, target_addr_t addr, size_t len);
 static bool stm32f4_flash_write(target_flash_s *f, target_addr_t dest, const void *src, size_t len);
+static bool stm32f4_flash_done(target_flash_s *f);
 static bool stm32f4_mass_erase(target_s *t);
 
 /* Flash Program and Erase Controller Register Map */
@@ -117,6 +119,7 @@ typedef struct stm32f4_flash {
 	align_e psize;
 	uint8_t base_sector;
 	uint8_t bank_split;
+	stub_ring_s ring;
 } stm32f4_flash_s;
 
 typedef struct stm32f4_priv {
@@ -158,6 +161,7 @@ static void stm32f4_add_flash(target_s *const t, const uint32_t addr, const size
 	f->blocksize = blocksize;
 	f->erase = stm32f4_flash_erase;
 	f->write = stm32f4_flash_write;
+	f->done = stm32f4_flash_done;
 	f->writesize = 1024;
 	f->erased = 0xffU;
 	sf->base_sector = base_sector;
@@ -464,16 +468,11 @@ static void stm32f4_flash_unlock(target_s *t)
 
 static bool stm32f4_flash_busy_wait(target_s *const t, platform_timeout_s *const timeout)
 {
-	/* Read FLASH_SR to poll for BSY bit */
-	uint32_t status = FLASH_SR_BSY;
-	while (status & FLASH_SR_BSY) {
-		status = target_mem_read32(t, FLASH_SR);
-		if ((status & SR_ERROR_MASK) || target_check_error(t)) {
-			DEBUG_ERROR("stm32f4 flash error 0x%" PRIx32 "\n", status);
-			return false;
-		}
-		if (timeout)
-			target_print_progress(timeout);
+	/* Poll FLASH_SR for the BSY bit to clear, then check the operation didn't end in an error */
+	uint32_t status = 0U;
+	if (!target_mem32_wait(t, FLASH_SR, FLASH_SR_BSY, 0U, 0U, timeout, &status) || (status & SR_ERROR_MASK)) {
+		DEBUG_ERROR("stm32f4 flash error 0x%" PRIx32 "\n", status);
+		return false;
 	}
 	return true;
 }
@@ -482,6 +481,9 @@ static bool stm32f4_flash_erase(target_flash_s *f, target_addr_t addr, size_t le
 {
 	target_s *t = f->t;
 	stm32f4_flash_s *sf = (stm32f4_flash_s *)f;
+	/* The ring stub must finish any writes in flight before the controller can be reconfigured */
+	if (!stub_ring_stop(&sf->ring))
+		return false;
 	stm32f4_flash_unlock(t);
 
 	align_e psize = ALIGN_WORD;
@@ -523,8 +525,23 @@ static bool stm32f4_flash_write(target_flash_s *f, target_addr_t dest, const voi
 	if (dest >= ITCM_BASE && dest < AXIM_BASE)
 		dest += AXIM_BASE - ITCM_BASE;
 	target_s *t = f->t;
+	stm32f4_flash_s *sf = (stm32f4_flash_s *)f;
+
+	align_e psize = sf->psize;
+	/*
+	 * For word parallelism, program through the ring stub so the next block goes over the wire while
+	 * the target's busy programming the last. This is skipped on the Cortex-M7 based parts as the
+	 * D-cache would get in the way of the debugger and stub seeing each other's updates to the ring.
+	 */
+	if (psize == ALIGN_WORD && (t->cpuid & CPUID_PARTNO_MASK) != CORTEX_M7 && !(len & 3U)) {
+		if (!stub_ring_running(&sf->ring)) {
+			target_mem_write32(t, FLASH_CR, (psize * FLASH_CR_PSIZE16) | FLASH_CR_PG);
+			stub_ring_start(&sf->ring, t, FLASH_SR, FLASH_SR_BSY, 0U, SR_ERROR_MASK, f->writesize);
+		}
+		if (stub_ring_running(&sf->ring))
+			return stub_ring_write(&sf->ring, dest, src, len);
+	}
 
-	align_e psize = ((stm32f4_flash_s *)f)->psize;
 	target_mem_write32(t, FLASH_CR, (psize * FLASH_CR_PSIZE16) | FLASH_CR_PG);
 	cortexm_mem_write_sized(t, dest, src, len, psize);
 
@@ -532,6 +549,13 @@ static bool stm32f4_flash_write(target_flash_s *f, target_addr_t dest, const voi
 	return stm32f4_flash_busy_wait(t, NULL);
 }
 
+static bool stm32f4_flash_done(target_flash_s *const f)
+{
+	stm32f4_flash_s *const sf = (stm32f4_flash_s *)f;
+	/* Wait for the ring stub to finish programming everything handed to it, picking up any errors along the way */
+	return stub_ring_stop(&sf->ring);
+}
+
 static bool stm32f4_mass_erase(target_s *t)
 {
 	/* XXX: Is it correct to grab the most recently added Flash region here? What is this really trying to do? */
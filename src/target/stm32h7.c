@@ -237,14 +237,13 @@ bool stm32h7_probe(target_s *t)
 
 static bool stm32h7_flash_busy_wait(target_s *const t, const uint32_t regbase)
 {
-	uint32_t status = FLASH_SR_BSY | FLASH_SR_QW;
-	while (status & (FLASH_SR_BSY | FLASH_SR_QW)) {
-		status = target_mem_read32(t, regbase + FLASH_SR);
-		if ((status & FLASH_SR_ERROR_MASK) || target_check_error(t)) {
-			DEBUG_ERROR("stm32h7_flash_write: error status %08" PRIx32 "\n", status);
-			target_mem_write32(t, regbase + FLASH_CCR, status & FLASH_SR_ERROR_MASK);
-			return false;
-		}
+	/* An error aborts the operation and clears BSY and QW, so wait for those then check for one */
+	uint32_t status = 0U;
+	if (!target_mem32_wait(t, regbase + FLASH_SR, FLASH_SR_BSY | FLASH_SR_QW, 0U, 0U, NULL, &status) ||
+		(status & FLASH_SR_ERROR_MASK)) {
+		DEBUG_ERROR("stm32h7_flash_write: error status %08" PRIx32 "\n", status);
+		target_mem_write32(t, regbase + FLASH_CCR, status & FLASH_SR_ERROR_MASK);
+		return false;
 	}
 	return true;
 }
@@ -0,0 +1,185 @@
+/*
+ * This file is part of the Black Magic Debug project.
+ *
+ * Copyright (C) 2023 1BitSquared <info@1bitsquared.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * This file implements the debugger side of ring buffered Flash programming. The stub in
+ * flashstub/ring.s is loaded into target RAM along with a mailbox and a ring of buffers.
+ * Each block to program is copied into the next free buffer, its descriptor filled in, and
+ * then the mailbox's submitted count is bumped to hand it to the stub. The stub bumps the
+ * completed count each time it's done with a buffer, which is what frees it up for reuse.
+ */
+
+#include "general.h"
+#include "target.h"
+#include "target_internal.h"
+#include "cortexm.h"
+#include "stub_ring.h"
+
+static const uint16_t stub_ring_stub[] = {
+#include "flashstub/ring.stub"
+};
+
+/* Mailbox layout, which must match flashstub/ring.s */
+#define STUB_RING_SUBMITTED       0x00U
+#define STUB_RING_COMPLETED       0x04U
+#define STUB_RING_STATUS          0x08U
+#define STUB_RING_CONFIG          0x0cU
+#define STUB_RING_DESCRIPTORS     0x20U
+#define STUB_RING_DESCRIPTOR_SIZE 16U
+
+/* The bkpt immediates the stub exits with */
+#define STUB_RING_EXIT_DONE  0
+#define STUB_RING_EXIT_ERROR 1
+
+#define STUB_RING_CODE_SIZE   ALIGN(sizeof(stub_ring_stub), 4U)
+#define STUB_RING_MAX_BUFFERS 4U
+/* How long the stub may go without freeing up a buffer before it's considered hung */
+#define STUB_RING_TIMEOUT_MS 5000U
+
+static size_t stub_ring_ram_size(const size_t buffer_size, const uint32_t buffer_count)
+{
+	return STUB_RING_CODE_SIZE + STUB_RING_DESCRIPTORS + (buffer_count * (STUB_RING_DESCRIPTOR_SIZE + buffer_size));
+}
+
+/*
+ * Load the stub and start it running, ready to program Flash. The stub writes each word then waits
+ * for (status_reg & busy_mask) == idle_value, stopping with an error if (status_reg & error_mask) != 0.
+ * idle_value is 0 for controllers with a busy flag, and busy_mask for those with a ready flag.
+ * Returns false if there's not enough target RAM for at least 2 buffers or the stub could not be started.
+ */
+bool stub_ring_start(stub_ring_s *const ring, target_s *const t, const uint32_t status_reg, const uint32_t busy_mask,
+	const uint32_t idle_value, const uint32_t error_mask, const size_t buffer_size)
+{
+	ring->t = t;
+	ring->mailbox = 0U;
+	if (buffer_size & 3U)
+		return false;
+
+	/* Use as many buffers as will fit in the RAM available, it's only worth doing with at least 2 */
+	target_ram_s *ram = NULL;
+	uint32_t buffer_count = STUB_RING_MAX_BUFFERS;
+	for (; !ram && buffer_count >= 2U; buffer_count >>= 1U)
+		ram = cortexm_stub_ram(t, stub_ring_ram_size(buffer_size, buffer_count));
+	if (!ram)
+		return false;
+	/* Undo the last step of the loop */
+	buffer_count <<= 1U;
+
+	const target_addr_t mailbox = ram->start + STUB_RING_CODE_SIZE;
+	const uint32_t config[5] = {status_reg, busy_mask, error_mask, buffer_count - 1U, idle_value & busy_mask};
+	const uint32_t counts[3] = {0U, 0U, 0U};
+	target_mem_write(t, ram->start, stub_ring_stub, sizeof(stub_ring_stub));
+	target_mem_write(t, mailbox + STUB_RING_CONFIG, config, sizeof(config));
+	target_mem_write(t, mailbox + STUB_RING_SUBMITTED, counts, sizeof(counts));
+	if (target_check_error(t) || !cortexm_start_stub(t, ram->start, mailbox, 0, 0, 0))
+		return false;
+
+	DEBUG_TARGET("Flash ring stub running at 0x%08" PRIx32 " with %" PRIu32 " buffers of %zu bytes\n", ram->start,
+		buffer_count, buffer_size);
+	ring->mailbox = mailbox;
+	ring->buffer_base = mailbox + STUB_RING_DESCRIPTORS + (buffer_count * STUB_RING_DESCRIPTOR_SIZE);
+	ring->buffer_size = buffer_size;
+	ring->buffer_count = buffer_count;
+	ring->submitted = 0U;
+	return true;
+}
+
+/* Wait for a buffer in the ring to be free, failing if the stub stops or stops making progress */
+static bool stub_ring_wait_free(stub_ring_s *const ring)
+{
+	target_s *const t = ring->t;
+	platform_timeout_s timeout;
+	platform_timeout_set(&timeout, STUB_RING_TIMEOUT_MS);
+	while (true) {
+		const uint32_t completed = target_mem_read32(t, ring->mailbox + STUB_RING_COMPLETED);
+		if (target_check_error(t))
+			return false;
+		if (ring->submitted - completed < ring->buffer_count)
+			return true;
+		if (cortexm_poll_stub(t) != CORTEXM_STUB_RUNNING || platform_timeout_is_expired(&timeout))
+			return false;
+	}
+}
+
+/* Hand a buffer's worth of data to the stub by filling in its descriptor and bumping the submitted count */
+static bool stub_ring_submit(stub_ring_s *const ring, const target_addr_t dest, const void *const src, const size_t len)
+{
+	target_s *const t = ring->t;
+	const uint32_t slot = ring->submitted & (ring->buffer_count - 1U);
+	const target_addr_t buffer = ring->buffer_base + (slot * ring->buffer_size);
+	const uint32_t descriptor[4] = {dest, buffer, len, 0U};
+	if (len)
+		target_mem_write(t, buffer, src, len);
+	target_mem_write(t, ring->mailbox + STUB_RING_DESCRIPTORS + (slot * STUB_RING_DESCRIPTOR_SIZE), descriptor,
+		sizeof(descriptor));
+	/* The stub only looks at the buffer once this changes, so it must go last */
+	target_mem_write32(t, ring->mailbox + STUB_RING_SUBMITTED, ++ring->submitted);
+	return !target_check_error(t);
+}
+
+/*
+ * Queue data to be programmed into Flash at dest, a buffer at a time. len must be a multiple of 4.
+ * This only waits for buffers to become free, not for the data to be programmed - that's confirmed
+ * by stub_ring_stop(), which also reports any errors that happen after this returns.
+ */
+bool stub_ring_write(stub_ring_s *const ring, const target_addr_t dest, const void *const src, const size_t len)
+{
+	if (!stub_ring_running(ring) || (len & 3U))
+		return false;
+	const uint8_t *const data = (const uint8_t *)src;
+	for (size_t offset = 0; offset < len; offset += ring->buffer_size) {
+		const size_t amount = MIN(len - offset, ring->buffer_size);
+		if (!stub_ring_wait_free(ring) || !stub_ring_submit(ring, dest + offset, data + offset, amount))
+			return false;
+	}
+	return true;
+}
+
+/*
+ * Wait for everything queued to be programmed and stop the stub, leaving the target halted.
+ * Returns false if the stub reported a Flash error or failed in some other way.
+ */
+bool stub_ring_stop(stub_ring_s *const ring)
+{
+	if (!stub_ring_running(ring))
+		return true;
+	target_s *const t = ring->t;
+	const target_addr_t mailbox = ring->mailbox;
+
+	/* An empty descriptor tells the stub to exit once it's programmed everything before it */
+	int result;
+	if (stub_ring_wait_free(ring) && stub_ring_submit(ring, 0U, NULL, 0U))
+		result = cortexm_wait_stub(t, STUB_RING_TIMEOUT_MS);
+	else {
+		/* Otherwise find out why the stub stopped, halting it if it's still going */
+		result = cortexm_poll_stub(t);
+		if (result == CORTEXM_STUB_RUNNING)
+			result = cortexm_wait_stub(t, 0U);
+	}
+	ring->mailbox = 0U;
+
+	if (result == STUB_RING_EXIT_DONE)
+		return true;
+	if (result == STUB_RING_EXIT_ERROR) {
+		const uint32_t status = target_mem_read32(t, mailbox + STUB_RING_STATUS);
+		DEBUG_ERROR("Flash ring stub error, status 0x%08" PRIx32 "\n", status);
+	} else
+		DEBUG_ERROR("Flash ring stub failed\n");
+	return false;
+}
@@ -0,0 +1,57 @@
+/*
+ * This file is part of the Black Magic Debug project.
+ *
+ * Copyright (C) 2023 1BitSquared <info@1bitsquared.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TARGET_STUB_RING_H
+#define TARGET_STUB_RING_H
+
+#include "target.h"
+#include "target_internal.h"
+
+/*
+ * Double (or more) buffered Flash programming using the ring stub in flashstub/ring.s.
+ * The stub runs on the target, programming each buffer in a ring in target RAM as the debugger
+ * fills it, so the next block goes over the wire while the last is being programmed.
+ *
+ * A driver starts the ring once its Flash controller is set up to program on plain word stores,
+ * hands it blocks with stub_ring_write(), and must stop it with stub_ring_stop() before doing
+ * anything else to the Flash controller, and when done.
+ */
+
+typedef struct stub_ring {
+	target_s *t;
+	/* Address of the mailbox in target RAM, or 0 if the ring is not running */
+	target_addr_t mailbox;
+	target_addr_t buffer_base;
+	size_t buffer_size;
+	uint32_t buffer_count;
+	/* How many buffers have been handed to the stub so far */
+	uint32_t submitted;
+} stub_ring_s;
+
+bool stub_ring_start(stub_ring_s *ring, target_s *t, uint32_t status_reg, uint32_t busy_mask, uint32_t idle_value,
+	uint32_t error_mask, size_t buffer_size);
+bool stub_ring_write(stub_ring_s *ring, target_addr_t dest, const void *src, size_t len);
+bool stub_ring_stop(stub_ring_s *ring);
+
+static inline bool stub_ring_running(const stub_ring_s *const ring)
+{
+	return ring->mailbox != 0U;
+}
+
+#endif /* TARGET_STUB_RING_H */
@@ -29,6 +29,30 @@ target_s *target_list = NULL;
 
 #define STDOUT_READ_BUF_SIZE       64U
 #define FLASH_WRITE_BUFFER_CEILING 1024U
+/* Longest single accelerated poll target_mem32_wait() asks for, so progress keeps getting printed */
+#define TARGET_MEM32_WAIT_SLICE_MS 100U
+
+/*
+ * Debugger reads are cached in aligned blocks of this size, and reads larger than a couple of
+ * blocks skip the cache as they're already efficient. The cache is small in firmware as RAM is tight.
+ */
+#define TARGET_MEM_CACHE_BLOCK_SIZE 64U
+#define TARGET_MEM_CACHE_MAX_READ   (TARGET_MEM_CACHE_BLOCK_SIZE * 2U)
+#if PC_HOSTED == 1
+#define TARGET_MEM_CACHE_BLOCKS 64U
+#else
+#define TARGET_MEM_CACHE_BLOCKS 8U
+#endif
+
+typedef struct target_mem_cache {
+	/* Blocks are replaced round robin, this is the next one to go */
+	size_t next;
+	bool valid[TARGET_MEM_CACHE_BLOCKS];
+	target_addr_t addr[TARGET_MEM_CACHE_BLOCKS];
+	uint8_t data[TARGET_MEM_CACHE_BLOCKS][TARGET_MEM_CACHE_BLOCK_SIZE];
+} target_mem_cache_s;
+
+bool target_mem_cache = false;
 
 static bool target_cmd_mass_erase(target_s *t, int argc, const char **argv);
 static bool target_cmd_range_erase(target_s *t, int argc, const char **argv);
@@ -84,6 +108,7 @@ void target_flash_map_free(target_s *t)
 		void *next = t->flash->next;
 		if (t->flash->buf)
 			free(t->flash->buf);
+		free(t->flash->diff_pending);
 		free(t->flash);
 		t->flash = next;
 	}
@@ -112,6 +137,7 @@ void target_list_free(void)
 			target->commands = tc;
 		}
 		free(target->target_storage);
+		free(target->mem_cache);
 		target_mem_map_free(target);
 		while (target->bw_list) {
 			void *next = target->bw_list->next;
@@ -161,6 +187,7 @@ target_s *target_attach(target_s *t, target_controller_s *tc)
 		t->tc->destroy_callback(t->tc, t);
 
 	t->tc = tc;
+	target_mem_cache_invalidate(t);
 	platform_target_clk_output_enable(true);
 
 	if (t->attach && !t->attach(t)) {
@@ -246,6 +273,7 @@ void target_print_progress(platform_timeout_s *const timeout)
 /* Wrapper functions */
 void target_detach(target_s *t)
 {
+	target_mem_cache_invalidate(t);
 	if (t->detach)
 		t->detach(t);
 	platform_target_clk_output_enable(false);
@@ -277,11 +305,90 @@ int target_mem_read(target_s *t, void *dest, target_addr_t src, size_t len)
 
 int target_mem_write(target_s *t, target_addr_t dest, const void *src, size_t len)
 {
+	target_mem_cache_invalidate(t);
 	if (t->mem_write)
 		t->mem_write(t, dest, src, len);
 	return target_check_error(t);
 }
 
+/* Drop everything in the read cache, for when the target's memory may have changed */
+void target_mem_cache_invalidate(target_s *t)
+{
+	if (t && t->mem_cache)
+		memset(t->mem_cache->valid, 0, sizeof(t->mem_cache->valid));
+}
+
+/* Only RAM and Flash are cached, as reads from anything else (peripherals especially) may have side effects */
+static bool target_mem_cacheable(const target_s *const t, const target_addr_t addr)
+{
+	for (const target_ram_s *r = t->ram; r; r = r->next) {
+		if (addr >= r->start && addr - r->start + TARGET_MEM_CACHE_BLOCK_SIZE <= r->length)
+			return true;
+	}
+	for (const target_flash_s *f = t->flash; f; f = f->next) {
+		if (addr >= f->start && addr - f->start + TARGET_MEM_CACHE_BLOCK_SIZE <= f->length)
+			return true;
+	}
+	return false;
+}
+
+/* Find the block at block_addr in the cache, reading it in if it's not there. Returns NULL if it can't be cached */
+static const uint8_t *target_mem_cache_block(target_s *const t, const target_addr_t block_addr)
+{
+	if (!target_mem_cacheable(t, block_addr))
+		return NULL;
+	if (!t->mem_cache) {
+		t->mem_cache = calloc(1, sizeof(*t->mem_cache));
+		if (!t->mem_cache) { /* calloc failed: heap exhaustion */
+			DEBUG_ERROR("calloc: failed in %s\n", __func__);
+			return NULL;
+		}
+	}
+	target_mem_cache_s *const cache = t->mem_cache;
+	for (size_t i = 0; i < TARGET_MEM_CACHE_BLOCKS; ++i) {
+		if (cache->valid[i] && cache->addr[i] == block_addr) {
+			++t->mem_cache_hits;
+			return cache->data[i];
+		}
+	}
+
+	++t->mem_cache_misses;
+	const size_t slot = cache->next;
+	cache->next = (slot + 1U) % TARGET_MEM_CACHE_BLOCKS;
+	cache->valid[slot] = false;
+	/* If the whole block can't be read, leave it to an uncached read to report the error for just what was asked */
+	if (target_mem_read(t, cache->data[slot], block_addr, TARGET_MEM_CACHE_BLOCK_SIZE))
+		return NULL;
+	cache->addr[slot] = block_addr;
+	cache->valid[slot] = true;
+	return cache->data[slot];
+}
+
+/*
+ * Read memory for the debugger, going through the read cache when it's enabled. GDB re-reads
+ * the same stack, code and variables in many small reads after each stop, which this turns into
+ * a read per block. Target drivers must use target_mem_read() as they may run the target themselves.
+ */
+int target_mem_read_cached(target_s *t, void *dest, target_addr_t src, size_t len)
+{
+	if (!target_mem_cache || len > TARGET_MEM_CACHE_MAX_READ)
+		return target_mem_read(t, dest, src, len);
+
+	uint8_t *const data = (uint8_t *)dest;
+	for (size_t offset = 0; offset < len;) {
+		const target_addr_t addr = src + offset;
+		const target_addr_t block_addr = addr & ~(TARGET_MEM_CACHE_BLOCK_SIZE - 1U);
+		const size_t amount = MIN(len - offset, block_addr + TARGET_MEM_CACHE_BLOCK_SIZE - addr);
+		const uint8_t *const block = target_mem_cache_block(t, block_addr);
+		if (block)
+			memcpy(data + offset, block + (addr - block_addr), amount);
+		else if (target_mem_read(t, data + offset, addr, amount))
+			return 1;
+		offset += amount;
+	}
+	return 0;
+}
+
 /* target_mem_access_needs_halt() is true if the target needs to be halted during jtag memory access */
 
 bool target_mem_access_needs_halt(target_s *t)
@@ -329,6 +436,7 @@ void target_regs_write(target_s *t, const void *data)
 /* Halt/resume functions */
 void target_reset(target_s *t)
 {
+	target_mem_cache_invalidate(t);
 	if (t->reset)
 		t->reset(t);
 }
@@ -341,14 +449,20 @@ void target_halt_request(target_s *t)
 
 target_halt_reason_e target_halt_poll(target_s *t, target_addr_t *watch)
 {
-	if (t->halt_poll)
-		return t->halt_poll(t, watch);
+	if (t->halt_poll) {
+		const target_halt_reason_e reason = t->halt_poll(t, watch);
+		/* Whatever was cached before the target last ran is stale now it's stopped again */
+		if (reason != TARGET_HALT_RUNNING && reason != TARGET_HALT_ERROR)
+			target_mem_cache_invalidate(t);
+		return reason;
+	}
 	/* XXX: Is this actually the desired fallback behaviour? */
 	return TARGET_HALT_RUNNING;
 }
 
 void target_halt_resume(target_s *t, bool step)
 {
+	target_mem_cache_invalidate(t);
 	if (t->halt_resume)
 		t->halt_resume(t, step);
 }
@@ -384,6 +498,8 @@ int target_breakwatch_set(target_s *t, target_breakwatch_e type, target_addr_t a
 		.size = len,
 	};
 	int ret = 1;
+	/* Software breakpoints are written into memory */
+	target_mem_cache_invalidate(t);
 
 	if (t->breakwatch_set)
 		ret = t->breakwatch_set(t, &bw);
@@ -417,6 +533,7 @@ int target_breakwatch_clear(target_s *t, target_breakwatch_e type, target_addr_t
 		return -1;
 
 	int ret = 1;
+	target_mem_cache_invalidate(t);
 	if (t->breakwatch_clear)
 		ret = t->breakwatch_clear(t, bw);
 
@@ -507,6 +624,7 @@ uint32_t target_mem_read32(target_s *t, uint32_t addr)
 
 void target_mem_write32(target_s *t, uint32_t addr, uint32_t value)
 {
+	target_mem_cache_invalidate(t);
 	if (t->mem_write)
 		t->mem_write(t, addr, &value, sizeof(value));
 }
@@ -521,6 +639,7 @@ uint16_t target_mem_read16(target_s *t, uint32_t addr)
 
 void target_mem_write16(target_s *t, uint32_t addr, uint16_t value)
 {
+	target_mem_cache_invalidate(t);
 	if (t->mem_write)
 		t->mem_write(t, addr, &value, sizeof(value));
 }
@@ -535,10 +654,52 @@ uint8_t target_mem_read8(target_s *t, uint32_t addr)
 
 void target_mem_write8(target_s *t, uint32_t addr, uint8_t value)
 {
+	target_mem_cache_invalidate(t);
 	if (t->mem_write)
 		t->mem_write(t, addr, &value, sizeof(value));
 }
 
+/*
+ * Wait for the 32-bit value at addr to satisfy (value & mask) == match, such as for a Flash
+ * controller's busy flag to clear. A timeout_ms of 0 waits indefinitely. If print_progress is
+ * given, progress is printed while waiting. The last value read is stored into value if that's
+ * not NULL, so callers can check any error flags alongside the busy flag.
+ *
+ * Returns true if the value matched, and false on timeout or if a target access failed.
+ */
+bool target_mem32_wait(target_s *const t, const uint32_t addr, const uint32_t mask, const uint32_t match,
+	const uint32_t timeout_ms, platform_timeout_s *const print_progress, uint32_t *const value)
+{
+	platform_timeout_s timeout;
+	platform_timeout_set(&timeout, timeout_ms);
+	uint32_t result = 0U;
+	bool matched = false;
+	while (true) {
+		/*
+		 * If the target can, let it do the polling in slices so progress still gets printed,
+		 * otherwise poll with one read at a time
+		 */
+		if (t->mem32_wait)
+			matched = t->mem32_wait(t, addr, mask, match, TARGET_MEM32_WAIT_SLICE_MS, &result);
+		else {
+			result = target_mem_read32(t, addr);
+			matched = (result & mask) == match;
+		}
+		/* A failed access can read back as a match, so check for that first */
+		if (target_check_error(t)) {
+			matched = false;
+			break;
+		}
+		if (matched || (timeout_ms && platform_timeout_is_expired(&timeout)))
+			break;
+		if (print_progress)
+			target_print_progress(print_progress);
+	}
+	if (value)
+		*value = result;
+	return matched;
+}
+
 void target_command_help(target_s *t)
 {
 	for (const target_command_s *tc = t->commands; tc; tc = tc->next) {
@@ -38,6 +38,8 @@
 #include "general.h"
 #include "target_internal.h"
 
+bool target_flash_diff = false;
+
 target_flash_s *target_flash_for_addr(target_s *t, uint32_t addr)
 {
 	for (target_flash_s *f = t->flash; f; f = f->next) {
@@ -49,6 +51,8 @@ target_flash_s *target_flash_for_addr(target_s *t, uint32_t addr)
 
 static bool target_enter_flash_mode(target_s *t)
 {
+	/* Every Flash operation comes through here, and any of them could change what a cached read would return */
+	target_mem_cache_invalidate(t);
 	if (t->flash_mode)
 		return true;
 
@@ -60,8 +64,11 @@ static bool target_enter_flash_mode(target_s *t)
 		/* This saves us if we're interrupted in IRQ context */
 		target_reset(t);
 
-	if (ret == true)
+	if (ret == true) {
 		t->flash_mode = true;
+		t->flash_blocks_skipped = 0;
+		t->flash_blocks_written = 0;
+	}
 
 	return ret;
 }
@@ -117,6 +124,139 @@ static bool flash_done(target_flash_s *f)
 	return ret;
 }
 
+/* When diff flashing, the buffer holds at least a whole erase block so blocks can be compared in one go */
+static size_t flash_buffer_size(const target_flash_s *const f)
+{
+	if (f->diff_pending)
+		return MAX(f->blocksize, f->writebufsize);
+	return f->writebufsize;
+}
+
+bool flash_buffer_alloc(target_flash_s *flash)
+{
+	/* Allocate buffer */
+	flash->buf = malloc(flash_buffer_size(flash));
+	if (!flash->buf) { /* malloc failed: heap exhaustion */
+		DEBUG_ERROR("malloc: failed in %s\n", __func__);
+		return false;
+	}
+	flash->buf_addr_base = UINT32_MAX;
+	flash->buf_addr_low = UINT32_MAX;
+	flash->buf_addr_high = 0;
+	return true;
+}
+
+static bool flash_buffered_flush(target_flash_s *f);
+
+static size_t flash_diff_block_index(const target_flash_s *const f, const target_addr_t addr)
+{
+	return (addr - f->start) / f->blocksize;
+}
+
+static bool flash_diff_is_pending(const target_flash_s *const f, const size_t block)
+{
+	return f->diff_pending[block / 8U] & (1U << (block % 8U));
+}
+
+/*
+ * Set up the Flash for diff flashing, allocating the pending erase map and a block-sized buffer.
+ * If this fails the caller should fall back to erasing immediately.
+ */
+static bool flash_diff_begin(target_flash_s *const f)
+{
+	if (f->diff_pending)
+		return true;
+
+	/* Write out anything buffered so far, as the buffer has to be reallocated at the new size */
+	if (f->buf) {
+		if (!flash_buffered_flush(f))
+			return false;
+		free(f->buf);
+		f->buf = NULL;
+	}
+
+	const size_t blocks = (f->length + f->blocksize - 1U) / f->blocksize;
+	f->diff_pending = calloc(1, (blocks + 7U) / 8U);
+	if (!f->diff_pending) { /* calloc failed: heap exhaustion */
+		DEBUG_ERROR("calloc: failed in %s\n", __func__);
+		return false;
+	}
+	if (!flash_buffer_alloc(f)) {
+		free(f->diff_pending);
+		f->diff_pending = NULL;
+		return false;
+	}
+	return true;
+}
+
+/* Check whether the block at addr already contains data, or is already erased if data is NULL */
+static bool flash_diff_block_matches(target_flash_s *const f, const target_addr_t addr, const uint8_t *const data)
+{
+#if PC_HOSTED == 1
+	uint8_t chunk[4096];
+#else
+	uint8_t chunk[128];
+#endif
+	for (size_t offset = 0; offset < f->blocksize; offset += sizeof(chunk)) {
+		const size_t amount = MIN(sizeof(chunk), f->blocksize - offset);
+		if (target_mem_read(f->t, chunk, addr + offset, amount))
+			return false;
+		if (data) {
+			if (memcmp(chunk, data + offset, amount) != 0)
+				return false;
+		} else {
+			for (size_t idx = 0; idx < amount; ++idx) {
+				if (chunk[idx] != f->erased)
+					return false;
+			}
+		}
+	}
+	return true;
+}
+
+/*
+ * Resolve the deferred erase of a block - returns true and sets skip if the block
+ * already holds the wanted contents, otherwise erases it ready to be written.
+ */
+static bool flash_diff_resolve_block(
+	target_flash_s *const f, const target_addr_t addr, const uint8_t *const data, bool *const skip)
+{
+	const size_t block = flash_diff_block_index(f, addr);
+	*skip = false;
+	if (!flash_diff_is_pending(f, block))
+		return true;
+	f->diff_pending[block / 8U] &= ~(1U << (block % 8U));
+
+	if (flash_diff_block_matches(f, addr, data)) {
+		++f->t->flash_blocks_skipped;
+		*skip = true;
+		return true;
+	}
+	++f->t->flash_blocks_written;
+	if (!flash_prepare(f))
+		return false;
+	const bool ret = f->erase(f, addr, f->blocksize);
+	if (!ret)
+		DEBUG_ERROR("Erase failed at %" PRIx32 "\n", addr);
+	return ret;
+}
+
+/* Deal with any blocks erased but never written, making sure they really are erased */
+static bool flash_diff_finish(target_flash_s *const f)
+{
+	if (!f->diff_pending)
+		return true;
+
+	bool ret = true; /* Catch false returns with &= */
+	for (target_addr_t addr = f->start; ret && addr < f->start + f->length; addr += f->blocksize) {
+		bool skip;
+		ret &= flash_diff_resolve_block(f, addr, NULL, &skip);
+	}
+	free(f->diff_pending);
+	f->diff_pending = NULL;
+	return ret;
+}
+
 bool target_flash_erase(target_s *t, target_addr_t addr, size_t len)
 {
 	if (!target_enter_flash_mode(t))
@@ -136,6 +276,7 @@ bool target_flash_erase(target_s *t, target_addr_t addr, size_t len)
 
 		/* Terminate flash operations if we're not in the same target flash */
 		if (f != active_flash) {
+			ret &= flash_buffered_flush(active_flash);
 			ret &= flash_done(active_flash);
 			active_flash = f;
 		}
@@ -143,6 +284,15 @@ bool target_flash_erase(target_s *t, target_addr_t addr, size_t len)
 		const target_addr_t local_start_addr = addr & ~(f->blocksize - 1U);
 		const target_addr_t local_end_addr = local_start_addr + f->blocksize;
 
+		/* When diff flashing, just note the block needs erasing and decide once we know what goes in it */
+		if (target_flash_diff && flash_diff_begin(f)) {
+			const size_t block = flash_diff_block_index(f, local_start_addr);
+			f->diff_pending[block / 8U] |= 1U << (block % 8U);
+			len -= MIN(local_end_addr - addr, len);
+			addr = local_end_addr;
+			continue;
+		}
+
 		if (!flash_prepare(f))
 			return false;
 
@@ -155,25 +305,12 @@ bool target_flash_erase(target_s *t, target_addr_t addr, size_t len)
 		len -= MIN(local_end_addr - addr, len);
 		addr = local_end_addr;
 	}
-	/* Issue flash done on last operation */
+	/* Issue flash done on last operation, making sure nothing still buffered from a previous write is lost */
+	ret &= flash_buffered_flush(active_flash);
 	ret &= flash_done(active_flash);
 	return ret;
 }
 
-bool flash_buffer_alloc(target_flash_s *flash)
-{
-	/* Allocate buffer */
-	flash->buf = malloc(flash->writebufsize);
-	if (!flash->buf) { /* malloc failed: heap exhaustion */
-		DEBUG_ERROR("malloc: failed in %s\n", __func__);
-		return false;
-	}
-	flash->buf_addr_base = UINT32_MAX;
-	flash->buf_addr_low = UINT32_MAX;
-	flash->buf_addr_high = 0;
-	return true;
-}
-
 static bool flash_buffered_flush(target_flash_s *f)
 {
 	bool ret = true; /* Catch false returns with &= */
@@ -189,8 +326,17 @@ static bool flash_buffered_flush(target_flash_s *f)
 		const uint8_t *src = f->buf + (aligned_addr - f->buf_addr_base);
 		uint32_t len = f->buf_addr_high - aligned_addr;
 
-		for (size_t offset = 0; offset < len; offset += f->writesize)
-			ret &= f->write(f, aligned_addr + offset, src + offset, f->writesize);
+		bool skip = false;
+		for (size_t offset = 0; ret && offset < len; offset += f->writesize) {
+			const target_addr_t addr = aligned_addr + offset;
+			/* On reaching each new erase block when diff flashing, check if it needs writing at all */
+			if (f->diff_pending && (offset == 0 || !(addr & (f->blocksize - 1U)))) {
+				const target_addr_t block_addr = addr & ~(f->blocksize - 1U);
+				ret &= flash_diff_resolve_block(f, block_addr, f->buf + (block_addr - f->buf_addr_base), &skip);
+			}
+			if (!skip)
+				ret &= f->write(f, addr, src + offset, f->writesize);
+		}
 
 		f->buf_addr_base = UINT32_MAX;
 		f->buf_addr_low = UINT32_MAX;
@@ -204,7 +350,8 @@ static bool flash_buffered_write(target_flash_s *f, target_addr_t dest, const vo
 {
 	bool ret = true; /* Catch false returns with &= */
 	while (len) {
-		const target_addr_t base_addr = dest & ~(f->writebufsize - 1U);
+		const size_t buf_size = flash_buffer_size(f);
+		const target_addr_t base_addr = dest & ~(buf_size - 1U);
 
 		/* Check for base address change */
 		if (base_addr != f->buf_addr_base) {
@@ -212,11 +359,11 @@ static bool flash_buffered_write(target_flash_s *f, target_addr_t dest, const vo
 
 			/* Setup buffer */
 			f->buf_addr_base = base_addr;
-			memset(f->buf, f->erased, f->writebufsize);
+			memset(f->buf, f->erased, buf_size);
 		}
 
-		const size_t offset = dest % f->writebufsize;
-		const size_t local_len = MIN(f->writebufsize - offset, len);
+		const size_t offset = dest % buf_size;
+		const size_t local_len = MIN(buf_size - offset, len);
 
 		/* Copy chunk into sector buffer */
 		memcpy(f->buf + offset, src, local_len);
@@ -289,12 +436,17 @@ bool target_flash_complete(target_s *t)
 {
 	if (!t->flash_mode)
 		return false;
+	target_mem_cache_invalidate(t);
 
 	bool ret = true; /* Catch false returns with &= */
 	for (target_flash_s *f = t->flash; f; f = f->next) {
 		ret &= flash_buffered_flush(f);
+		ret &= flash_diff_finish(f);
 		ret &= flash_done(f);
 	}
+	if (t->flash_blocks_skipped || t->flash_blocks_written)
+		DEBUG_INFO("Flash diff: %zu blocks skipped, %zu blocks written\n", t->flash_blocks_skipped,
+			t->flash_blocks_written);
 
 	target_exit_flash_mode(t);
 	return ret;
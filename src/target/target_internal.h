@@ -61,6 +61,7 @@ struct target_flash {
 	target_addr_t buf_addr_base; /* Address of block this buffer is for */
 	target_addr_t buf_addr_low;  /* Address of lowest byte written */
 	target_addr_t buf_addr_high; /* Address of highest byte written */
+	uint8_t *diff_pending;       /* Bitmap of erase blocks with a deferred erase when diff flashing */
 	target_flash_s *next;        /* Next flash in list */
 };
 
@@ -104,6 +105,11 @@ struct target {
 	/* Memory access functions */
 	void (*mem_read)(target_s *t, void *dest, target_addr_t src, size_t len);
 	void (*mem_write)(target_s *t, target_addr_t dest, const void *src, size_t len);
+	/* Optional on-target CRC32 calculation, returns false if it could not be performed */
+	bool (*crc32)(target_s *t, uint32_t *crc, target_addr_t base, size_t len);
+	/* Optional accelerated poll of a 32-bit location, see target_mem32_wait() */
+	bool (*mem32_wait)(
+		target_s *t, target_addr_t addr, uint32_t mask, uint32_t match, uint32_t timeout_ms, uint32_t *value);
 
 	/* Register access functions */
 	size_t regs_size;
@@ -132,6 +138,14 @@ struct target {
 	bool (*enter_flash_mode)(target_s *t);
 	bool (*exit_flash_mode)(target_s *t);
 	bool flash_mode;
+	/* Diff flashing statistics for the current/last flash session */
+	size_t flash_blocks_skipped;
+	size_t flash_blocks_written;
+
+	/* Read cache for the current halt, allocated on first use when target_mem_cache is set */
+	struct target_mem_cache *mem_cache;
+	size_t mem_cache_hits;
+	size_t mem_cache_misses;
 
 	/* Target-defined options */
 	unsigned target_options;
@@ -189,6 +203,8 @@ void target_mem_write32(target_s *t, uint32_t addr, uint32_t value);
 void target_mem_write16(target_s *t, uint32_t addr, uint16_t value);
 void target_mem_write8(target_s *t, uint32_t addr, uint8_t value);
 bool target_check_error(target_s *t);
+bool target_mem32_wait(target_s *t, uint32_t addr, uint32_t mask, uint32_t match, uint32_t timeout_ms,
+	platform_timeout_s *print_progress, uint32_t *value);
 
 /* Access to host controller interface */
 void tc_printf(target_s *t, const char *fmt, ...);
@@ -0,0 +1,51 @@
+/*
+ * This file is part of the Black Magic Debug project.
+ *
+ * Copyright (C) 2023 1BitSquared <info@1bitsquared.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * The minimal harness shared by the host unit tests: CHECK() records a failure and carries on, so
+ * a run reports everything that's wrong, and check_summary() gives the test's exit status.
+ */
+
+#ifndef TESTS_CHECK_H
+#define TESTS_CHECK_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+static size_t check_failures = 0;
+
+#define CHECK(cond, ...)                                             \
+	do {                                                             \
+		if (!(cond)) {                                               \
+			printf("%s:%d: %s failed: ", __FILE__, __LINE__, #cond); \
+			printf(__VA_ARGS__);                                     \
+			printf("\n");                                            \
+			++check_failures;                                        \
+		}                                                            \
+	} while (0)
+
+static inline int check_summary(void)
+{
+	if (!check_failures)
+		return 0;
+	printf("%zu checks failed\n", check_failures);
+	return 1;
+}
+
+#endif /* TESTS_CHECK_H */
@@ -0,0 +1,177 @@
+/*
+ * This file is part of the Black Magic Debug project.
+ *
+ * Copyright (C) 2023 1BitSquared <info@1bitsquared.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Host unit test for the bit packing in the firmware's bit-banged JTAG implementation,
+ * src/platforms/common/jtagtap.c. It's built against a mock GPIO layer that records TMS and TDI
+ * at every rising edge of TCK and plays back a TDO pattern, and then each TDI/TDO sequence
+ * length from 1 to 199 bits is checked with and without the clock delay loops.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "check.h"
+#include "general.h"
+#include "jtagtap.h"
+
+#define MAX_CYCLES 199U
+#define MAX_BYTES  ((MAX_CYCLES + 7U) / 8U)
+/* Bytes past the end of data_out that must be left alone */
+#define GUARD_BYTES 4U
+#define GUARD_VALUE 0xa5U
+
+uint32_t swd_delay_cnt = 0;
+
+/* The simulated port */
+static uint16_t pins_state = 0;
+static size_t edges = 0;
+static bool edge_tms[MAX_CYCLES + 1U];
+static bool edge_tdi[MAX_CYCLES + 1U];
+static bool tdo_pattern[MAX_CYCLES + 1U];
+
+static void pins_update(const uint16_t state)
+{
+	/* Record TMS and TDI as the target would see them, on the rising edge of TCK */
+	if ((state & TCK_PIN) && !(pins_state & TCK_PIN)) {
+		if (edges <= MAX_CYCLES) {
+			edge_tms[edges] = state & TMS_PIN;
+			edge_tdi[edges] = state & TDI_PIN;
+		}
+		++edges;
+	}
+	pins_state = state;
+}
+
+void gpio_set(const uint32_t port, const uint16_t pins)
+{
+	(void)port;
+	pins_update(pins_state | pins);
+}
+
+void gpio_clear(const uint32_t port, const uint16_t pins)
+{
+	(void)port;
+	pins_update(pins_state & ~pins);
+}
+
+void gpio_set_val(const uint32_t port, const uint16_t pins, const bool value)
+{
+	if (value)
+		gpio_set(port, pins);
+	else
+		gpio_clear(port, pins);
+}
+
+uint16_t gpio_get(const uint32_t port, const uint16_t pins)
+{
+	(void)port;
+	/* The target changes TDO on the falling edge, so while TCK is high it's showing the current cycle's bit */
+	const size_t cycle = edges ? edges - 1U : 0U;
+	uint16_t state = pins_state & ~TDO_PIN;
+	if (cycle <= MAX_CYCLES && tdo_pattern[cycle])
+		state |= TDO_PIN;
+	return state & pins;
+}
+
+void platform_target_clk_output_enable(const bool enable)
+{
+	(void)enable;
+}
+
+static bool bit_get(const uint8_t *const data, const size_t bit)
+{
+	return (data[bit >> 3U] >> (bit & 7U)) & 1U;
+}
+
+static void sequence_start(void)
+{
+	/* Leave TMS high as a TMS sequence would, the sequence functions must bring it low themselves */
+	jtag_proc.jtagtap_tms_seq(1U, 1U);
+	edges = 0;
+	for (size_t cycle = 0; cycle <= MAX_CYCLES; ++cycle)
+		tdo_pattern[cycle] = rand() & 1;
+}
+
+static void sequence_check(const char *const name, const uint8_t *const data_in, const bool final_tms,
+	const size_t clock_cycles)
+{
+	CHECK(edges == clock_cycles, "%s of %zu cycles clocked %zu times", name, clock_cycles, edges);
+	CHECK(!(pins_state & TCK_PIN), "%s of %zu cycles left TCK high", name, clock_cycles);
+	for (size_t cycle = 0; cycle < MIN(edges, clock_cycles); ++cycle) {
+		const bool tms = cycle + 1U == clock_cycles ? final_tms : false;
+		CHECK(edge_tms[cycle] == tms, "%s of %zu cycles had TMS %u on cycle %zu", name, clock_cycles,
+			edge_tms[cycle], cycle);
+		CHECK(edge_tdi[cycle] == bit_get(data_in, cycle), "%s of %zu cycles had TDI %u on cycle %zu", name,
+			clock_cycles, edge_tdi[cycle], cycle);
+	}
+}
+
+static void test_tdi_tdo_seq(const size_t clock_cycles, const bool final_tms)
+{
+	uint8_t data_in[MAX_BYTES];
+	uint8_t data_out[MAX_BYTES + GUARD_BYTES];
+	for (size_t idx = 0; idx < MAX_BYTES; ++idx)
+		data_in[idx] = (uint8_t)rand();
+	memset(data_out, GUARD_VALUE, sizeof(data_out));
+
+	sequence_start();
+	jtag_proc.jtagtap_tdi_tdo_seq(data_out, final_tms, data_in, clock_cycles);
+	sequence_check("tdi_tdo_seq", data_in, final_tms, clock_cycles);
+
+	for (size_t cycle = 0; cycle < clock_cycles; ++cycle)
+		CHECK(bit_get(data_out, cycle) == tdo_pattern[cycle], "tdi_tdo_seq of %zu cycles got TDO %u on cycle %zu",
+			clock_cycles, bit_get(data_out, cycle), cycle);
+	for (size_t idx = (clock_cycles + 7U) / 8U; idx < sizeof(data_out); ++idx)
+		CHECK(data_out[idx] == GUARD_VALUE, "tdi_tdo_seq of %zu cycles wrote %02x to byte %zu", clock_cycles,
+			data_out[idx], idx);
+
+	/* Without data_out, only the pins change */
+	sequence_start();
+	jtag_proc.jtagtap_tdi_tdo_seq(NULL, final_tms, data_in, clock_cycles);
+	sequence_check("tdi_tdo_seq to NULL", data_in, final_tms, clock_cycles);
+}
+
+static void test_tdi_seq(const size_t clock_cycles, const bool final_tms)
+{
+	uint8_t data_in[MAX_BYTES];
+	for (size_t idx = 0; idx < MAX_BYTES; ++idx)
+		data_in[idx] = (uint8_t)rand();
+
+	sequence_start();
+	jtag_proc.jtagtap_tdi_seq(final_tms, data_in, clock_cycles);
+	sequence_check("tdi_seq", data_in, final_tms, clock_cycles);
+}
+
+int main(void)
+{
+	srand(1U);
+	jtagtap_init();
+	/* Once without the delay loops and once with a short one */
+	for (uint32_t delay = 0; delay < 2U; ++delay) {
+		swd_delay_cnt = delay ? 3U : 0U;
+		for (size_t clock_cycles = 1; clock_cycles <= MAX_CYCLES; ++clock_cycles) {
+			test_tdi_tdo_seq(clock_cycles, false);
+			test_tdi_tdo_seq(clock_cycles, true);
+			test_tdi_seq(clock_cycles, false);
+			test_tdi_seq(clock_cycles, true);
+		}
+	}
+	return check_summary();
+}
@@ -0,0 +1,55 @@
+/*
+ * This file is part of the Black Magic Debug project.
+ *
+ * Copyright (C) 2023 1BitSquared <info@1bitsquared.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * A stand-in platform.h for building the firmware's bit-banged JTAG implementation on the host.
+ * The GPIO calls go to a simulated port in jtagtap_test.c, which records what is on the pins at
+ * each rising edge of TCK and plays back TDO.
+ */
+
+#ifndef TESTS_MOCK_PLATFORM_H
+#define TESTS_MOCK_PLATFORM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define PLATFORM_IDENT "Host test "
+
+#define JTAG_PORT 0U
+#define TCK_PORT  JTAG_PORT
+#define TMS_PORT  JTAG_PORT
+#define TDI_PORT  JTAG_PORT
+#define TDO_PORT  JTAG_PORT
+#define TCK_PIN   (1U << 0U)
+#define TMS_PIN   (1U << 1U)
+#define TDI_PIN   (1U << 2U)
+#define TDO_PIN   (1U << 3U)
+
+#define TMS_SET_MODE() \
+	do {               \
+	} while (false)
+
+extern uint32_t swd_delay_cnt;
+
+void gpio_set(uint32_t port, uint16_t pins);
+void gpio_clear(uint32_t port, uint16_t pins);
+uint16_t gpio_get(uint32_t port, uint16_t pins);
+void gpio_set_val(uint32_t port, uint16_t pins, bool value);
+
+#endif /* TESTS_MOCK_PLATFORM_H */
@@ -0,0 +1,219 @@
+/*
+ * This file is part of the Black Magic Debug project.
+ *
+ * Copyright (C) 2023 1BitSquared <info@1bitsquared.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Throughput benchmark for the BMDA serial transport's response reader, run against a fake probe
+ * on the other end of a pty so it needs no hardware. The fake probe answers every request with a
+ * fixed size response, and the time and CPU taken to collect those responses is reported both for
+ * platform_buffer_read() from serial_unix.c and for the select() + one byte read() loop it replaced.
+ *
+ * Usage: serial_bench [responses] [response payload length]
+ */
+
+#define _XOPEN_SOURCE 600
+#define _DEFAULT_SOURCE
+
+#include <sys/select.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "general.h"
+#include "remote.h"
+#include "bmp_hosted.h"
+#include "bmp_remote.h"
+
+/* The bits of the rest of BMDA serial_unix.c and utils.c depend on */
+unsigned cortexm_wait_timeout = 2000U;
+
+void platform_buffer_flush(void)
+{
+}
+
+#define BENCH_REQUEST          "!GA#"
+#define BENCH_DEFAULT_COUNT    2000U
+#define BENCH_DEFAULT_PAYLOAD  1024U
+#define BENCH_MAX_PAYLOAD      4000U
+#define BENCH_RESPONSE_MAX_LEN (BENCH_MAX_PAYLOAD + 3U)
+
+/* The fake probe: reply to each request read from the pty master with "&K<payload>#" */
+static void fake_probe(const int master, const size_t payload_length)
+{
+	char response[BENCH_RESPONSE_MAX_LEN];
+	response[0] = REMOTE_RESP;
+	response[1] = REMOTE_RESP_OK;
+	for (size_t idx = 0; idx < payload_length; ++idx)
+		response[idx + 2U] = "0123456789abcdef"[idx & 0xfU];
+	response[payload_length + 2U] = REMOTE_EOM;
+	const size_t response_length = payload_length + 3U;
+
+	char request[256];
+	while (true) {
+		const ssize_t received = read(master, request, sizeof(request));
+		if (received <= 0)
+			_exit(0);
+		/* Answer once per end-of-message byte, so requests split or merged by the pty are handled */
+		for (ssize_t idx = 0; idx < received; ++idx) {
+			if (request[idx] != REMOTE_EOM)
+				continue;
+			for (size_t offset = 0; offset < response_length;) {
+				const ssize_t written = write(master, response + offset, response_length - offset);
+				if (written <= 0)
+					_exit(1);
+				offset += (size_t)written;
+			}
+		}
+	}
+}
+
+/* The reader platform_buffer_read() used to be: a select() and one byte read() per character */
+static int bytewise_xfer(const int fd, char *const data, const size_t length)
+{
+	if (write(fd, BENCH_REQUEST, sizeof(BENCH_REQUEST) - 1U) != sizeof(BENCH_REQUEST) - 1U)
+		return -2;
+	char response = 0;
+	while (response != REMOTE_RESP) {
+		fd_set select_set;
+		FD_ZERO(&select_set);
+		FD_SET(fd, &select_set);
+		timeval_s timeout = {.tv_sec = 2, .tv_usec = 0};
+		if (select(FD_SETSIZE, &select_set, NULL, NULL, &timeout) <= 0 || read(fd, &response, 1) != 1)
+			return -4;
+	}
+	for (size_t offset = 0; offset < length; ++offset) {
+		fd_set select_set;
+		FD_ZERO(&select_set);
+		FD_SET(fd, &select_set);
+		timeval_s timeout = {.tv_sec = 2, .tv_usec = 0};
+		if (select(FD_SETSIZE, &select_set, NULL, NULL, &timeout) <= 0 || read(fd, data + offset, 1) != 1)
+			return -5;
+		if (data[offset] == REMOTE_EOM) {
+			data[offset] = '\0';
+			return (int)offset;
+		}
+	}
+	return -6;
+}
+
+static double timespec_seconds(const struct timespec *const begin, const struct timespec *const end)
+{
+	return (double)(end->tv_sec - begin->tv_sec) + ((double)(end->tv_nsec - begin->tv_nsec) / 1e9);
+}
+
+/* Send a request and read back its response, returning the response length or a negative value on error */
+typedef int (*bench_xfer_fn)(int fd, char *data, size_t length);
+
+static int buffered_xfer(const int fd, char *const data, const size_t length)
+{
+	(void)fd;
+	if (!platform_buffer_write(BENCH_REQUEST, sizeof(BENCH_REQUEST) - 1U))
+		return -2;
+	return platform_buffer_read(data, length);
+}
+
+static bool bench_run(const char *const name, const int fd, const bench_xfer_fn xfer, const uint32_t count,
+	const size_t payload_length)
+{
+	char response[BENCH_RESPONSE_MAX_LEN];
+	struct timespec wall_begin;
+	struct timespec wall_end;
+	struct timespec cpu_begin;
+	struct timespec cpu_end;
+	clock_gettime(CLOCK_MONOTONIC, &wall_begin);
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu_begin);
+	for (uint32_t idx = 0; idx < count; ++idx) {
+		const int result = xfer(fd, response, sizeof(response));
+		/* The response is the status byte followed by the payload */
+		if (result != (int)payload_length + 1) {
+			fprintf(stderr, "%s: bad response %" PRIu32 " (%d)\n", name, idx, result);
+			return false;
+		}
+	}
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu_end);
+	clock_gettime(CLOCK_MONOTONIC, &wall_end);
+
+	const double wall = timespec_seconds(&wall_begin, &wall_end);
+	const double cpu = timespec_seconds(&cpu_begin, &cpu_end);
+	const double bytes = (double)count * (double)(payload_length + 3U);
+	printf("%-9s %8.3fs wall %8.3fs CPU %10.0f responses/s %8.2f MiB/s\n", name, wall, cpu, count / wall,
+		bytes / wall / (1024.0 * 1024.0));
+	return true;
+}
+
+int main(const int argc, const char *const *const argv)
+{
+	const uint32_t count = argc > 1 ? strtoul(argv[1], NULL, 0) : BENCH_DEFAULT_COUNT;
+	const size_t payload_length = argc > 2 ? strtoul(argv[2], NULL, 0) : BENCH_DEFAULT_PAYLOAD;
+	if (!count || payload_length > BENCH_MAX_PAYLOAD) {
+		fprintf(stderr, "Usage: %s [responses] [response payload length <= %u]\n", argv[0], BENCH_MAX_PAYLOAD);
+		return 2;
+	}
+
+	const int master = posix_openpt(O_RDWR | O_NOCTTY);
+	if (master < 0 || grantpt(master) || unlockpt(master)) {
+		perror("posix_openpt");
+		return 1;
+	}
+	struct termios tty;
+	tcgetattr(master, &tty);
+	cfmakeraw(&tty);
+	tcsetattr(master, TCSANOW, &tty);
+
+	char slave_name[256];
+	strncpy(slave_name, ptsname(master), sizeof(slave_name) - 1U);
+	slave_name[sizeof(slave_name) - 1U] = '\0';
+
+	/* serial_open() sets the slave up exactly as it would a real probe's serial port */
+	bmda_cli_options_s cl_opts = {.opt_device = slave_name};
+	if (serial_open(&cl_opts, NULL)) {
+		fprintf(stderr, "Failed to open %s\n", slave_name);
+		return 1;
+	}
+	/* The old reader gets its own descriptor on the same slave, set up the same way */
+	const int bytewise_fd = open(slave_name, O_RDWR | O_NOCTTY);
+	if (bytewise_fd < 0) {
+		perror("open");
+		return 1;
+	}
+	tcgetattr(bytewise_fd, &tty);
+	cfmakeraw(&tty);
+	tcsetattr(bytewise_fd, TCSANOW, &tty);
+
+	const pid_t probe = fork();
+	if (probe < 0) {
+		perror("fork");
+		return 1;
+	}
+	if (probe == 0)
+		fake_probe(master, payload_length);
+
+	printf("%" PRIu32 " responses of %zu payload bytes through %s\n", count, payload_length, slave_name);
+	/* Each reader sends its requests on its own descriptor, they all end up at the fake probe */
+	const bool result = bench_run("bytewise", bytewise_fd, bytewise_xfer, count, payload_length) &&
+		bench_run("buffered", -1, buffered_xfer, count, payload_length);
+
+	kill(probe, SIGTERM);
+	waitpid(probe, NULL, 0);
+	close(bytewise_fd);
+	serial_close();
+	return result ? 0 : 1;
+}
@@ -0,0 +1,160 @@
+/*
+ * This file is part of the Black Magic Debug project.
+ *
+ * Copyright (C) 2023 1BitSquared <info@1bitsquared.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Host unit test for the SWD waveform packing and sample unpacking used by the STM32 timer + DMA
+ * SW-DP implementation. Pins are put on different bits for SWDIO out and in to catch mixups.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "check.h"
+#include "swdptap_dma_pack.h"
+
+static const swd_dma_pins_s pins = {
+	.swclk = 1U << 5U,
+	.swdio = 1U << 4U,
+	.swdio_in = 1U << 9U,
+};
+
+static const uint32_t test_values[] = {
+	0x00000000U, 0xffffffffU, 0x00000001U, 0x80000000U, 0xa5a5a5a5U, 0x5a5a5a5aU, 0x12345678U, 0xdeadbeefU,
+};
+#define TEST_VALUE_COUNT (sizeof(test_values) / sizeof(*test_values))
+
+static uint32_t mask(const size_t clock_cycles)
+{
+	return clock_cycles >= 32U ? 0xffffffffU : (1U << clock_cycles) - 1U;
+}
+
+static void test_encode(void)
+{
+	for (size_t value_idx = 0; value_idx < TEST_VALUE_COUNT; ++value_idx) {
+		for (size_t cycles = 1; cycles <= 32U; ++cycles) {
+			uint32_t waveform[SWD_DMA_MAX_WORDS];
+			/* Start part way in to check the index is carried through */
+			size_t words = swd_dma_encode(&pins, waveform, 2U, 0U, 1U, false);
+			CHECK(words == 4U, "turnaround gave %zu words", words);
+			words = swd_dma_encode(&pins, waveform, words, test_values[value_idx], cycles, true);
+			CHECK(words == 4U + cycles * 2U, "%zu cycles gave %zu words", cycles, words);
+			words = swd_dma_encode_end(&pins, waveform, words);
+			CHECK(words == 5U + cycles * 2U, "end gave %zu words", words);
+
+			/* The turnaround cycle toggles SWCLK and leaves SWDIO alone */
+			CHECK(waveform[2] == pins.swclk << 16U, "turnaround low is %08x", waveform[2]);
+			CHECK(waveform[3] == pins.swclk, "turnaround high is %08x", waveform[3]);
+			for (size_t cycle = 0; cycle < cycles; ++cycle) {
+				const bool bit = (test_values[value_idx] >> cycle) & 1U;
+				const uint32_t low = waveform[4U + cycle * 2U];
+				const uint32_t high = waveform[5U + cycle * 2U];
+				const uint32_t expected = (pins.swclk << 16U) | (bit ? pins.swdio : pins.swdio << 16U);
+				CHECK(low == expected, "value %08x cycle %zu low is %08x", test_values[value_idx], cycle, low);
+				CHECK(high == pins.swclk, "value %08x cycle %zu high is %08x", test_values[value_idx], cycle, high);
+			}
+			CHECK(waveform[words - 1U] == pins.swclk << 16U, "end is %08x", waveform[words - 1U]);
+		}
+	}
+}
+
+/* Fill in the samples a target driving value onto SWDIO would give, with noise everywhere else */
+static void make_samples(uint16_t *const samples, const uint32_t value, const size_t clock_cycles, const bool parity)
+{
+	for (size_t cycle = 0; cycle <= clock_cycles; ++cycle) {
+		const bool bit = cycle < clock_cycles ? (value >> cycle) & 1U : parity;
+		const uint16_t noise = (uint16_t)rand() & ~pins.swdio_in;
+		samples[cycle * 2U] = noise | (bit ? pins.swdio_in : 0U);
+		/* The samples taken while SWCLK is high must be ignored, so make them the opposite */
+		samples[cycle * 2U + 1U] = ((uint16_t)rand() & ~pins.swdio_in) | (bit ? 0U : pins.swdio_in);
+	}
+}
+
+static void test_decode(void)
+{
+	for (size_t value_idx = 0; value_idx < TEST_VALUE_COUNT; ++value_idx) {
+		const uint32_t value = test_values[value_idx];
+		for (size_t cycles = 1; cycles <= 32U; ++cycles) {
+			uint16_t samples[SWD_DMA_MAX_WORDS];
+			const uint32_t expected = value & mask(cycles);
+			const bool parity = __builtin_popcount(expected) & 1U;
+
+			make_samples(samples, value, cycles, parity);
+			uint32_t result = swd_dma_decode(&pins, samples, cycles);
+			CHECK(result == expected, "%zu cycles decoded %08x, expected %08x", cycles, result, expected);
+
+			result = ~expected;
+			CHECK(!swd_dma_decode_parity(&pins, samples, cycles, &result), "%zu cycles of %08x flagged bad parity",
+				cycles, expected);
+			CHECK(result == expected, "%zu cycles decoded %08x with parity, expected %08x", cycles, result, expected);
+
+			make_samples(samples, value, cycles, !parity);
+			CHECK(swd_dma_decode_parity(&pins, samples, cycles, &result), "%zu cycles of %08x missed bad parity",
+				cycles, expected);
+			CHECK(result == expected, "%zu cycles decoded %08x with bad parity, expected %08x", cycles, result,
+				expected);
+		}
+	}
+}
+
+static void test_parity(void)
+{
+	for (size_t value_idx = 0; value_idx < TEST_VALUE_COUNT; ++value_idx) {
+		const uint32_t value = test_values[value_idx];
+		uint32_t expected = 0U;
+		for (size_t bit = 0; bit < 32U; ++bit)
+			expected ^= (value >> bit) & 1U;
+		CHECK(swd_dma_parity(value) == expected, "parity of %08x is %u", value, swd_dma_parity(value));
+	}
+}
+
+/* Loop the waveform back as though SWDIO out were wired to SWDIO in, and check the value survives */
+static void test_loopback(void)
+{
+	for (size_t value_idx = 0; value_idx < TEST_VALUE_COUNT; ++value_idx) {
+		const uint32_t value = test_values[value_idx];
+		uint32_t waveform[SWD_DMA_MAX_WORDS];
+		uint16_t samples[SWD_DMA_MAX_WORDS];
+		size_t words = swd_dma_encode(&pins, waveform, 0U, value, 32U, true);
+		words = swd_dma_encode(&pins, waveform, words, swd_dma_parity(value), 1U, true);
+		words = swd_dma_encode_end(&pins, waveform, words);
+
+		bool swdio = false;
+		for (size_t idx = 0; idx < words; ++idx) {
+			if (waveform[idx] & pins.swdio)
+				swdio = true;
+			else if (waveform[idx] & (pins.swdio << 16U))
+				swdio = false;
+			samples[idx] = swdio ? pins.swdio_in : 0U;
+		}
+
+		uint32_t result = 0U;
+		CHECK(!swd_dma_decode_parity(&pins, samples, 32U, &result), "loopback of %08x has bad parity", value);
+		CHECK(result == value, "loopback of %08x gave %08x", value, result);
+	}
+}
+
+int main(void)
+{
+	srand(1U);
+	test_encode();
+	test_decode();
+	test_parity();
+	test_loopback();
+	return check_summary();
+}